@@ -4,7 +4,10 @@ import matplotlib.pyplot as plt
 import matplotlib as mpl
 import matplotlib.dates as mdates
 from datetime import datetime
+from concurrent.futures import ProcessPoolExecutor
+import numpy as np
 import itertools
+import hashlib
 import glob
 import os 
 import sys
@@ -25,9 +28,82 @@ pattern_timestamp = re.compile("[0-9]{10}")
 pattern_id = re.compile("[a-f0-9]{2}:[a-f0-9]{2}:[a-f0-9]{2}:[a-f0-9]{2}:[a-f0-9]{2}:[a-f0-9]{2}")
 pattern_distance = re.compile("[0-9]{6}")
 
+#parsed logs are cached by content hash so that re-plotting an unchanged folder skips parsing
+CACHE_FOLDER = '.quickplot_cache'
+CACHE_VERSION = 1
+#plotted points are decimated to at most a minimum and a maximum per pixel column of the saved figures
+SAVE_DPI = 300
+
 def check_ranging_line_pattern(tokens):
     return bool(pattern_timestamp.match(tokens[0])) and bool(pattern_id.match(tokens[1])) and bool(pattern_distance.match(tokens[2]))
 
+def parse_log(log):
+    #returns the ranges to every peer as (timestamps, distances) arrays, along with all lines that could not be parsed
+    ranges, bad_lines = {}, []
+    # Open the log file, escaping the messed up characters
+    with open(log,encoding="ascii",errors="surrogateescape") as f:
+        # Read data from the log file
+        for line in f:
+            # For now, just ignore these events
+            if '#' in line:
+                continue
+            # Parse out the fields
+            tokens = [x.strip() for x in line.split()]
+        
+            # To deal with incomplete lines
+            if len(tokens)!=3 or check_ranging_line_pattern(tokens)==False:
+                bad_lines.append(line)
+                continue
+            
+            timestamp,tag_id,distance = tokens[0],tokens[1],tokens[2]
+            # Convert to meaningful data types
+            timestamp = int(timestamp)
+            tag_id = tag_id.split(':')[-1]
+            distance = int(distance)
+            # Filter out bad readings
+            if distance == 0 or distance == 999999:
+                continue
+            # Save this measurement
+            ranges.setdefault(tag_id, []).append((timestamp, distance))
+    ranges = {tag_id: np.array(data, dtype=np.int64).reshape(-1, 2).T for tag_id, data in ranges.items()}
+    return ranges, bad_lines
+
+def cached_parse_log(log):
+    #looks the log up in the cache folder next to it by the hash of its contents, parsing and caching it when missing
+    with open(log,'rb') as f:
+        digest = hashlib.sha1(f.read()).hexdigest()
+    cache_file = os.path.join(os.path.dirname(os.path.abspath(log)), CACHE_FOLDER, f'{digest}-v{CACHE_VERSION}.npz')
+    if os.path.exists(cache_file):
+        with np.load(cache_file) as cached:
+            ranges = {key[2:]: cached[key] for key in cached.files if key.startswith('r_')}
+            return ranges, list(cached['bad_lines'])
+    ranges, bad_lines = parse_log(log)
+    try:
+        os.makedirs(os.path.dirname(cache_file), exist_ok=True)
+        np.savez(cache_file + '.partial.npz', bad_lines=np.array(bad_lines, dtype=str), **{'r_'+tag_id: data for tag_id, data in ranges.items()})
+        os.replace(cache_file + '.partial.npz', cache_file)
+    except OSError:
+        #a read-only folder can still be plotted, just without caching
+        pass
+    return ranges, bad_lines
+
+def decimate(x, y, x_min, x_max, bins):
+    #keeps only the lowest and highest point within each of the given number of equal time bins,
+    #which looks identical to plotting every point once the bins are no wider than a pixel
+    x, y = np.asarray(x), np.asarray(y)
+    if len(x) <= 2 * bins:
+        return x, y
+    bin_index = np.minimum(((x - x_min) * bins / max(x_max - x_min, 1)).astype(np.int64), bins - 1)
+    order = np.lexsort((y, bin_index))
+    sorted_bins = bin_index[order]
+    first = np.flatnonzero(np.diff(sorted_bins, prepend=-1) != 0)
+    last = np.append(first[1:], len(order)) - 1
+    keep = order[np.unique(np.concatenate((first, last)))]
+    return x[keep], y[keep]
+
+def to_datetimes(timestamps):
+    return [datetime.fromtimestamp(t) for t in np.asarray(timestamps).tolist()]
+
 def plot_all(foldername):
     #display the full path
     print('plotting for:',os.path.abspath(foldername),'\n')
@@ -58,38 +134,25 @@ def plot_all(foldername):
 
     print('READING FILES......')
 
-    for index, log in enumerate(filelists):
-    
+    #parse all logs at once across a process pool, then report bad lines in file order
+    with ProcessPoolExecutor() as executor:
+        parsed_logs = list(executor.map(cached_parse_log, filelists))
+    for index, (log, (ranges, bad_lines)) in enumerate(zip(filelists, parsed_logs)):
         current_tag = log.split('@')[0].split(os.path.sep)[-1]
-    
-        # Open the log file, escaping the messed up characters
-        with open(log,encoding="ascii",errors="surrogateescape") as f:
-            # Read data from the log file
-            for line in f:
-                # For now, just ignore these events
-                if '#' in line:
-                    continue
-                # Parse out the fields
-                tokens = [x.strip() for x in line.split()]
-            
-                # To deal with incomplete lines
-                if len(tokens)!=3 or check_ranging_line_pattern(tokens)==False:
-                    print('IN FILE:',log,'BAD LINE:',f'{index}', line)
-                    continue
-                
-                timestamp,tag_id,distance = tokens[0],tokens[1],tokens[2]
-                # Convert to meaningful data types
-                timestamp = int(timestamp)
-                tag_id = tag_id.split(':')[-1]
-                distance = int(distance)
-                # Filter out bad readings
-                if distance == 0 or distance == 999999:
-                    continue
-                # Save this measurement
-                if tag_id not in tagdata[current_tag]:
-                    tagdata[current_tag][tag_id] = []
-                tagdata[current_tag][tag_id].append((timestamp, distance))
-        
+        for line in bad_lines:
+            print('IN FILE:',log,'BAD LINE:',f'{index}', line)
+        #a tag may have several logs, so append each peer's ranges to those from its earlier files
+        for tag_id, data in ranges.items():
+            earlier = tagdata[current_tag].get(tag_id, [])
+            tagdata[current_tag][tag_id] = np.concatenate((earlier, data), axis=1) if len(earlier) else data
+
+    #bin points by the pixel columns of one panel in the saved figures
+    all_timestamps = [data[0] for ranges in tagdata.values() for data in ranges.values() if len(data) and len(data[0])]
+    x_min = min((t.min() for t in all_timestamps), default=0)
+    x_max = max((t.max() for t in all_timestamps), default=0)
+    bins = int(fig.get_figwidth() * SAVE_DPI / 2)
+    empty = np.empty((2, 0), dtype=np.int64)
+
     # Done parsing, plot!
     # Considers tag combination with empty ranging data
     for i, tagpair in enumerate(tagpairs):
@@ -102,46 +165,31 @@ def plot_all(foldername):
             axsAB = axs[i,0]
             axsBA = axs[i,1]
     
-        dataAB = tagdata[tagpair[0]][tagpair[1]]
-        dataBA = tagdata[tagpair[1]][tagpair[0]]
-        
-        print(f'{tagpair[1]} -> {tagpair[0]}: {len(dataAB):< 6} data points, {tagpair[0]} -> {tagpair[1]}: {len(dataBA):> 6} data points')
-        
-        xAB, yAB, xBA, yBA = [],[],[],[]
-        
-        #test equality
-        dictAB = {x[0]:x[1] for x in dataAB}
-        dictBA = {x[0]:x[1] for x in dataBA}
-        
-        timestampAB = set(dictAB.keys())
-        timestampBA = set(dictBA.keys())
-        shared_timestamp = timestampAB.intersection(timestampBA)
-        AmB_timestamp = timestampAB.difference(timestampBA)
-        BmA_timestamp = timestampBA.difference(timestampAB)
-        
-        inconsistent_shared = []
+        dataAB = tagdata[tagpair[0]][tagpair[1]] if len(tagdata[tagpair[0]][tagpair[1]]) else empty
+        dataBA = tagdata[tagpair[1]][tagpair[0]] if len(tagdata[tagpair[1]][tagpair[0]]) else empty
         
-        if shared_timestamp:
-            for k in shared_timestamp:
-                if dictAB[k]!=dictBA[k]:
-                    inconsistent_shared.append(k)
-                    print(f'At: {k}, {tagpair[1]} -> {tagpair[0]}: {dictAB[k]},{tagpair[0]} -> {tagpair[1]}: {dictBA[k]}')   
-            print('percent:',len(inconsistent_shared)/len(shared_timestamp), 'of shared timestamps have different ranges')
-        inconsistent_shared_timestamp = set(inconsistent_shared)
-        consistent_shared_timestamp = shared_timestamp.difference(inconsistent_shared)
+        print(f'{tagpair[1]} -> {tagpair[0]}: {dataAB.shape[1]:< 6} data points, {tagpair[0]} -> {tagpair[1]}: {dataBA.shape[1]:> 6} data points')
         
+        #test equality, where the last range logged at a timestamp is the one that counts
+        timestampAB, indexAB = np.unique(dataAB[0][::-1], return_index=True)
+        timestampBA, indexBA = np.unique(dataBA[0][::-1], return_index=True)
+        distanceAB, distanceBA = dataAB[1][::-1][indexAB], dataBA[1][::-1][indexBA]
+        shared_timestamp, sharedAB, sharedBA = np.intersect1d(timestampAB, timestampBA, assume_unique=True, return_indices=True)
+        onlyAB = np.ones(len(timestampAB), dtype=bool)
+        onlyAB[sharedAB] = False
+        onlyBA = np.ones(len(timestampBA), dtype=bool)
+        onlyBA[sharedBA] = False
         
-        if len(dataAB)!=0:
-            xAB, yAB = zip(*dataAB)
-            xAB_h = [datetime.fromtimestamp(s) for s in xAB]
+        inconsistent = distanceAB[sharedAB] != distanceBA[sharedBA]
+        if len(shared_timestamp):
+            for k, distAB, distBA in zip(shared_timestamp[inconsistent], distanceAB[sharedAB][inconsistent], distanceBA[sharedBA][inconsistent]):
+                print(f'At: {k}, {tagpair[1]} -> {tagpair[0]}: {distAB},{tagpair[0]} -> {tagpair[1]}: {distBA}')   
+            print('percent:',np.count_nonzero(inconsistent)/len(shared_timestamp), 'of shared timestamps have different ranges')
         
-        if len(dataBA)!=0:
-            xBA, yBA = zip(*dataBA)
-            xBA_h = [datetime.fromtimestamp(s) for s in xBA]
-                   
         #plot left panel
-        if len(xAB)!=0:
-            axsAB.scatter(xAB_h,yAB,s=1)
+        if dataAB.shape[1]!=0:
+            xAB, yAB = decimate(dataAB[0], dataAB[1], x_min, x_max, bins)
+            axsAB.scatter(to_datetimes(xAB),yAB,s=1)
             axsAB.set_ylabel('dist (mm)')
             axsAB.xaxis.set_major_formatter(mdates.DateFormatter('%H:%M'))
             axsAB.grid()
@@ -151,8 +199,9 @@ def plot_all(foldername):
         axsAB.set_title(tagpair[1]+" seen from "+tagpair[0])
         
         #plot right panel
-        if len(xBA)!=0:
-            axsBA.scatter(xBA_h,yBA,s=1)
+        if dataBA.shape[1]!=0:
+            xBA, yBA = decimate(dataBA[0], dataBA[1], x_min, x_max, bins)
+            axsBA.scatter(to_datetimes(xBA),yBA,s=1)
             axsBA.set_ylabel('dist (mm)')
             axsBA.xaxis.set_major_formatter(mdates.DateFormatter('%H:%M'))
             axsBA.grid()
@@ -162,22 +211,22 @@ def plot_all(foldername):
         axsBA.set_title(tagpair[0]+" seen from "+tagpair[1])
         
         #plot shared figure where the two sets of data are plotted on the same graph             
-        if len(consistent_shared_timestamp):
-            consistent_shared_timestamp = sorted(consistent_shared_timestamp)
-            consistent_shared_xh, consistent_shared_y = zip( *[(datetime.fromtimestamp(t),dictAB[t]) for t in consistent_shared_timestamp])
-            axs_together[i].scatter(consistent_shared_xh,consistent_shared_y,color='orange',s=1,label='consistent_shared')
-        if len(inconsistent_shared_timestamp):
-            inconsistent_shared_xh, inconsistent_shared_yAB,inconsistent_shared_yBA = zip(*[(datetime.fromtimestamp(t),dictAB[t], dictBA[t]) for t in inconsistent_shared_timestamp])
-            axs_together[i].scatter(inconsistent_shared_xh,inconsistent_shared_yAB,color='green',label='inconsistent_shared',s=8, marker="x")
-            axs_together[i].scatter(inconsistent_shared_xh,inconsistent_shared_yBA,color='green',s=8, marker="x")
-        if len(AmB_timestamp):
-            AmB_xh, AmB_y = zip( *[(datetime.fromtimestamp(t),dictAB[t]) for t in AmB_timestamp])
-            axs_together[i].scatter(AmB_xh,AmB_y,color='r',s=1,label=f'only {tagpair[1]} -> {tagpair[0]}')
-        if len(BmA_timestamp):
-            BmA_xh, BmA_y = zip( *[(datetime.fromtimestamp(t),dictBA[t]) for t in BmA_timestamp])
-            axs_together[i].scatter(BmA_xh,BmA_y,color='b',s=1,label=f'only {tagpair[0]} -> {tagpair[1]}')
+        if np.count_nonzero(~inconsistent):
+            consistent_x, consistent_y = decimate(shared_timestamp[~inconsistent], distanceAB[sharedAB][~inconsistent], x_min, x_max, bins * 2)
+            axs_together[i].scatter(to_datetimes(consistent_x),consistent_y,color='orange',s=1,label='consistent_shared')
+        if np.count_nonzero(inconsistent):
+            #every inconsistency is kept since these are what the check is looking for
+            inconsistent_xh = to_datetimes(shared_timestamp[inconsistent])
+            axs_together[i].scatter(inconsistent_xh,distanceAB[sharedAB][inconsistent],color='green',label='inconsistent_shared',s=8, marker="x")
+            axs_together[i].scatter(inconsistent_xh,distanceBA[sharedBA][inconsistent],color='green',s=8, marker="x")
+        if np.count_nonzero(onlyAB):
+            AmB_x, AmB_y = decimate(timestampAB[onlyAB], distanceAB[onlyAB], x_min, x_max, bins * 2)
+            axs_together[i].scatter(to_datetimes(AmB_x),AmB_y,color='r',s=1,label=f'only {tagpair[1]} -> {tagpair[0]}')
+        if np.count_nonzero(onlyBA):
+            BmA_x, BmA_y = decimate(timestampBA[onlyBA], distanceBA[onlyBA], x_min, x_max, bins * 2)
+            axs_together[i].scatter(to_datetimes(BmA_x),BmA_y,color='b',s=1,label=f'only {tagpair[0]} -> {tagpair[1]}')
             
-        if len(consistent_shared_timestamp) or len(inconsistent_shared_timestamp) or len(AmB_timestamp) or len(BmA_timestamp):
+        if len(timestampAB) or len(timestampBA):
             axs_together[i].xaxis.set_major_formatter(mdates.DateFormatter('%H:%M'))
             #plottting outside
             axs_together[i].legend(loc='upper left', bbox_to_anchor=(1, 1))
@@ -197,8 +246,8 @@ def plot_all(foldername):
     
     plt.show()
     
-    fig.savefig(os.path.join(os.path.abspath(foldername),'_'.join(taglist)+'_saved_separated_plot.png'),dpi=300)
-    fig_together.savefig(os.path.join(os.path.abspath(foldername),'_'.join(taglist)+'_saved_together_plot.png'),dpi=300)
+    fig.savefig(os.path.join(os.path.abspath(foldername),'_'.join(taglist)+'_saved_separated_plot.png'),dpi=SAVE_DPI)
+    fig_together.savefig(os.path.join(os.path.abspath(foldername),'_'.join(taglist)+'_saved_together_plot.png'),dpi=SAVE_DPI)
 
 if __name__ == '__main__':
     print('Usage: python3 quickplot_folder.py for plot in current folder with the log files form a single day')
@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+
+# Python imports
+import numpy as np
+from numpy.lib.stride_tricks import sliding_window_view
+
+
+# Algorithm-defined constants
+SAMPLE_PERIOD_S = 0.5
+DEFAULT_MEASUREMENT_NOISE_MM = 100.0
+DEFAULT_PROCESS_NOISE_MM_S2 = 500.0
+KALMAN_RESPONSE_TOLERANCE = 1e-12
+MAX_KALMAN_RESPONSE_LENGTH = 1 << 16
+MAX_DIRECT_CONVOLUTION_RESPONSE = 256
+MAX_SORTING_NETWORK_WINDOW = 15
+
+
+# Regularization onto the sampling grid
+
+def regularize(timestamps, values, sample_period=SAMPLE_PERIOD_S, max_gap=None, previous_timestamp=None):
+    # Places one peer's samples on a regular grid the same way tottagSmoother always has: skipped samples take the
+    # value that ends the skip, while a longer skip, a repeated timestamp or a step back in time starts a new segment.
+    # Returns the grid timestamps, grid values, the index of each grid sample's segment and the source sample of each.
+    timestamps, values = np.asarray(timestamps, dtype=np.float64), np.asarray(values, dtype=np.float64)
+    steps = np.rint(np.diff(timestamps, prepend=timestamps[:1] if previous_timestamp is None else previous_timestamp) / sample_period).astype(np.int64)
+    continues = (steps >= 1) & (steps <= (np.inf if max_gap is None else max_gap / sample_period))
+    if previous_timestamp is None and len(continues):
+        continues[0] = False
+    segments = np.cumsum(~continues)
+    repeats = np.where(continues, steps, 1)
+    if (repeats == 1).all():
+        return timestamps, values, segments, np.arange(len(timestamps))
+    sources = np.repeat(np.arange(len(timestamps)), repeats)
+    offsets = np.repeat(np.cumsum(repeats), repeats) - 1 - np.arange(len(sources))
+    return timestamps[sources] - (offsets * sample_period), values[sources], segments[sources], sources
+
+def complete_windows(segments, window):
+    # Whether each window of consecutive samples, indexed by its first sample, lies entirely within one segment
+    return segments[:max(len(segments) - window + 1, 0)] == segments[window - 1:]
+
+def row_medians(rows):
+    # For the short windows used in practice, the min/max passes of an odd-even transposition sorting network over whole
+    # columns are far cheaper than sorting every row on its own
+    width = rows.shape[1]
+    if width > MAX_SORTING_NETWORK_WINDOW:
+        return np.median(rows, axis=1)
+    columns = [rows[:, i] for i in range(width)]
+    for step in range(width):
+        for i in range(step % 2, width - 1, 2):
+            columns[i], columns[i + 1] = np.minimum(columns[i], columns[i + 1]), np.maximum(columns[i], columns[i + 1])
+    return 0.5 * (columns[(width - 1) // 2] + columns[width // 2])
+
+
+# Window filters, each reported at the center sample of every complete window
+
+def centered(values, window, segments, results):
+    # Every window is filtered, whether complete or not, since that is much cheaper than gathering only the complete ones
+    complete = complete_windows(np.zeros(len(values), dtype=np.int64) if segments is None else segments, window)
+    output = np.full(len(values), np.nan)
+    output[(window - 1) // 2:((window - 1) // 2) + len(complete)] = np.where(complete, results, np.nan)
+    return output
+
+def moving_average(values, window, segments=None):
+    values = np.asarray(values, dtype=np.float64)
+    sums = np.concatenate(([0.0], np.cumsum(values)))
+    return centered(values, window, segments, (sums[window:] - sums[:max(len(sums) - window, 0)]) / window)
+
+def moving_median(values, window, segments=None):
+    values = np.asarray(values, dtype=np.float64)
+    return centered(values, window, segments, row_medians(sliding_window_view(values, window)) if len(values) >= window else np.empty(0))
+
+def hampel_filter(values, window, num_sigmas=3.0, segments=None):
+    # Replaces each center sample lying more than num_sigmas robust deviations from its window median with that median
+    values = np.asarray(values, dtype=np.float64)
+    if len(values) < window:
+        return np.full(len(values), np.nan)
+    windows = sliding_window_view(values, window)
+    medians = row_medians(windows)
+    deviations = windows - medians[:, None]
+    deviations = 1.4826 * row_medians(np.abs(deviations, out=deviations))
+    samples = values[(window - 1) // 2:((window - 1) // 2) + len(medians)]
+    return centered(values, window, segments, np.where(np.abs(samples - medians) > (num_sigmas * deviations), medians, samples))
+
+
+# Constant-velocity Kalman filter
+
+def kalman_gains(sample_period=SAMPLE_PERIOD_S, process_noise=DEFAULT_PROCESS_NOISE_MM_S2, measurement_noise=DEFAULT_MEASUREMENT_NOISE_MM):
+    # Steady-state position and velocity gains for white-noise acceleration, from the tracking index of the model
+    tracking_index = process_noise * (sample_period ** 2) / measurement_noise
+    r = (4.0 + tracking_index - np.sqrt((8.0 * tracking_index) + (tracking_index ** 2))) / 4.0
+    alpha = 1.0 - (r ** 2)
+    beta = (2.0 * (2.0 - alpha)) - (4.0 * np.sqrt(1.0 - alpha))
+    return alpha, beta / sample_period
+
+def kalman_responses(sample_period, process_noise, measurement_noise):
+    # The steady-state filter is linear and time-invariant, so its output is the measurements convolved with its impulse
+    # response plus the decaying response to the state it started from; both are tabulated until they become negligible
+    alpha, beta = kalman_gains(sample_period, process_noise, measurement_noise)
+    transition = np.array([[1.0 - alpha, (1.0 - alpha) * sample_period], [-beta, 1.0 - (beta * sample_period)]])
+    powers = [np.eye(2)]
+    while np.abs(powers[-1]).max() > KALMAN_RESPONSE_TOLERANCE and len(powers) < MAX_KALMAN_RESPONSE_LENGTH:
+        powers.append(transition @ powers[-1])
+    powers = np.array(powers)
+    return powers @ np.array([alpha, beta]), powers
+
+def causal_convolve(values, response):
+    response = response[:len(values)]
+    if len(response) <= MAX_DIRECT_CONVOLUTION_RESPONSE:
+        return np.convolve(values, response)[:len(values)]
+    size = 1 << int(np.ceil(np.log2(len(values) + len(response) - 1)))
+    return np.fft.irfft(np.fft.rfft(values, size) * np.fft.rfft(response, size), size)[:len(values)]
+
+def kalman_filter(values, segments=None, sample_period=SAMPLE_PERIOD_S, process_noise=DEFAULT_PROCESS_NOISE_MM_S2,
+                  measurement_noise=DEFAULT_MEASUREMENT_NOISE_MM, initial_state=None, responses=None, all_velocities=True):
+    # Filtered positions and velocities for every sample, restarting from rest at the first sample of every segment
+    # Without all_velocities, only the final velocity of every segment is computed and the rest are left undefined
+    values = np.asarray(values, dtype=np.float64)
+    segments = np.zeros(len(values), dtype=np.int64) if segments is None else segments
+    impulse_response, state_response = responses if responses is not None else kalman_responses(sample_period, process_noise, measurement_noise)
+    positions, velocities = np.empty(len(values)), np.empty(len(values))
+    starts = np.flatnonzero(np.diff(segments, prepend=segments[:1] - 1) != 0) if len(values) else np.empty(0, dtype=np.int64)
+    for segment, (start, end) in enumerate(zip(starts, np.append(starts[1:], len(values)))):
+        if segment == 0 and initial_state is not None:
+            state, measured = np.asarray(initial_state, dtype=np.float64), values[start:end]
+        else:
+            state, measured = np.array([values[start], 0.0]), values[start + 1:end]
+            positions[start], velocities[start] = state
+        count = len(measured)
+        if count == 0:
+            continue
+        decay = state_response[1:count + 1] @ state
+        positions[end - count:end] = causal_convolve(measured, impulse_response[:, 0])
+        positions[end - count:end][:len(decay)] += decay[:, 0]
+        if all_velocities:
+            velocities[end - count:end] = causal_convolve(measured, impulse_response[:, 1])
+            velocities[end - count:end][:len(decay)] += decay[:, 1]
+        else:
+            recent = measured[::-1][:len(impulse_response)]
+            velocities[end - 1] = (recent @ impulse_response[:len(recent), 1]) + (decay[-1, 1] if count < len(state_response) else 0.0)
+    return positions, velocities
+
+
+# Streaming use over consecutive chunks of one peer's samples
+
+class StreamingFilter:
+    # Applies one of the filters above to successive chunks of a single peer's samples, carrying just enough state
+    # across chunk boundaries (the last window of samples, or the Kalman state) to match filtering all samples at once
+
+    def __init__(self, method='average', window=5, sample_period=SAMPLE_PERIOD_S, max_gap=None, **parameters):
+        self.method = method
+        self.window = 1 if method == 'kalman' else window
+        self.sample_period = sample_period
+        self.max_gap = max_gap
+        self.parameters = parameters
+        self.responses = kalman_responses(sample_period, parameters.get('process_noise', DEFAULT_PROCESS_NOISE_MM_S2),
+                                          parameters.get('measurement_noise', DEFAULT_MEASUREMENT_NOISE_MM)) if method == 'kalman' else None
+        self.last_timestamp = None
+        self.state = None
+        self.tail_timestamps, self.tail_values = np.empty(0), np.empty(0)
+
+    def process(self, timestamps, values):
+        # Returns the timestamps and filtered values of every sample whose output became available with this chunk
+        if len(timestamps) == 0:
+            return np.empty(0), np.empty(0)
+        grid_timestamps, grid_values, segments, _ = regularize(timestamps, values, self.sample_period, self.max_gap, self.last_timestamp)
+        continues = (self.last_timestamp is not None) and (segments[0] == 0)
+        self.last_timestamp = float(timestamps[-1])
+        if self.method == 'kalman':
+            positions, velocities = kalman_filter(grid_values, segments, initial_state=self.state if continues else None,
+                                                  responses=self.responses, all_velocities=False)
+            self.state = np.array([positions[-1], velocities[-1]])
+            return grid_timestamps, positions
+        if continues:
+            grid_timestamps, grid_values = np.concatenate((self.tail_timestamps, grid_timestamps)), np.concatenate((self.tail_values, grid_values))
+            segments = np.concatenate((np.zeros(len(self.tail_values), dtype=segments.dtype), segments))
+        last_segment = segments == segments[-1]
+        self.tail_timestamps, self.tail_values = grid_timestamps[last_segment][1 - self.window:], grid_values[last_segment][1 - self.window:]
+        if self.window == 1:
+            self.tail_timestamps, self.tail_values = np.empty(0), np.empty(0)
+        if self.method == 'average':
+            filtered = moving_average(grid_values, self.window, segments)
+        elif self.method == 'median':
+            filtered = moving_median(grid_values, self.window, segments)
+        else:
+            filtered = hampel_filter(grid_values, self.window, self.parameters.get('num_sigmas', 3.0), segments)
+        available = ~np.isnan(filtered)
+        return grid_timestamps[available], filtered[available]
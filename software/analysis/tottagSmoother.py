@@ -1,82 +1,45 @@
 #!/usr/bin/env python
 
-import os
 import sys
+import numpy as np
+from tottagFilters import regularize, moving_average
 
-#class to handle the moving average.
-#works kind of like a queue, keeping smoothVal values stored
-class SmoothedGroup:
-    def __init__(self, time, mote, val, size, s):
-        self.stamps = []
-        self.data = []
-
-        self.size = size
-        self.stamps.append(time)
-        self.data.append(val)
-        self.mote = mote
-        self.lastTime = time
-        self.outfile = s
-
-    def addVal(self, time, val):
-        self.stamps.insert(0, time)
-        self.data.insert(0, val)
-        self.lastTime = time
-        if (len(self.data) >= self.size):
-            self.average()
-
-    def clear(self):
-        self.stamps = []
-        self.data = []
-
-#helper methof to average and write out the line. Pops oldest value off
-    def average(self):
-        averageVal = 0
-        index = int(self.size/2)
-        for i in range(0, self.size):
-            averageVal += self.data[i]
-        self.data.pop()
-        self.stamps.pop()
-        averageVal /= self.size
-        self.outfile.write(str(self.stamps[index])+"\t"+self.mote+"\t"+str(round((int(averageVal)/25.4/12), 2))+"\n")
-
+OUT_OF_RANGE_CODE = 999999
 
+#smooths every mote's readings with a moving average of smoothVal seconds, writing each
+#average at the middle of its window in the same order the original line-by-line smoother did
+def smoothLog(inFile, outFile, smoothVal):
+    with open(inFile) as f:
+        header = f.readline()
+        lines = [line.split('\t') for line in f if line[0] != '#']
+    stamps = np.array([int(tokens[0]) for tokens in lines], dtype=np.int64)
+    motes = np.array([tokens[1] for tokens in lines])
+    values = np.array([int(tokens[2]) for tokens in lines], dtype=np.int64)
+    inRange = np.flatnonzero(values != OUT_OF_RANGE_CODE)
+
+    #gaps of up to smoothVal seconds are filled with the reading that ends them, longer ones restart the average
+    outputs = []
+    for mote in np.unique(motes[inRange]):
+        rows = inRange[motes[inRange] == mote]
+        gridStamps, gridValues, segments, sources = regularize(stamps[rows], values[rows], 1, smoothVal)
+        averages = moving_average(gridValues, smoothVal, segments)
+        centers = np.flatnonzero(~np.isnan(averages))
+        ends = centers + smoothVal // 2
+        outputs.append((rows[sources[ends]], ends, gridStamps[centers].astype(np.int64), np.full(len(centers), mote), averages[centers]))
+
+    with open(outFile, "w+") as s:
+        s.write(header)
+        if outputs:
+            lineOrder, gridOrder, outStamps, outMotes, averages = (np.concatenate(column) for column in zip(*outputs))
+            for i in np.lexsort((gridOrder, lineOrder)):
+                s.write(str(outStamps[i])+"\t"+outMotes[i]+"\t"+str(round((int(averages[i])/25.4/12), 2))+"\n")
 
-OUT_OF_RANGE_CODE = 999999
 
 if len(sys.argv) < 2:
    print('USAGE: python tottag.py SMOOTHING VALUE LOG_FILE_PATH LOG_FILE_PATH LOG_FILE_PATH LOG_FILE_PATH')
    sys.exit(1)
 logs = sys.argv[2:]
 smoothVal = int(sys.argv[1])
-logfile_date = None
 
 for i in logs:
-    outFile = i[:-4] + "-smoothed.log"
-    s = open(outFile, "w+")
-    first = {}
-    classDict = {}
-    with open(i) as f:
-        s.write(f.readline())
-        for line in f:
-            if line[0] != '#':
-                tokens = line.split('\t')
-                #this if only operates on the first recording from each mote.
-                #serves to initialize the class
-                if (first.setdefault(tokens[1], True) and int(tokens[2]) != OUT_OF_RANGE_CODE):
-                    classDict[tokens[1]] = classDict.setdefault(tokens[1], SmoothedGroup(int(tokens[0]), tokens[1], int(tokens[2]), smoothVal, s))
-                    first[tokens[1]] = False
-                elif (int(tokens[2]) != OUT_OF_RANGE_CODE):
-                    #checks here for time skips
-                    timeDiff = int(tokens[0]) - classDict[tokens[1]].lastTime
-                    if (timeDiff == 1):
-                        classDict[tokens[1]].addVal(int(tokens[0]), int(tokens[2]))
-                    #If the skip is small, fills in time with current value
-                    elif (timeDiff > 1 and timeDiff <= smoothVal):
-                        for i in range(classDict[tokens[1]].lastTime + 1, int(tokens[0]) + 1):
-                            classDict[tokens[1]].addVal(i, int(tokens[2]))
-                    #If the skip is larger than the smoothVal, it starts the buffer over
-                    else:
-                        classDict[tokens[1]].clear()
-                        classDict[tokens[1]].addVal(int(tokens[0]), int(tokens[2]))
-        f.close()
-    s.close()
+    smoothLog(i, i[:-4] + "-smoothed.log", smoothVal)
@@ -1,5 +1,10 @@
+import os
 import sys
+import functools
+import numpy as np
 import matplotlib.pyplot as plt
+from concurrent.futures import ProcessPoolExecutor
+from numpy.lib.stride_tricks import sliding_window_view
 # from scipy.signal import savgol_filter
 # from sklearn.ensemble import VotingClassifier
 from sklearn.metrics import accuracy_score
@@ -17,6 +22,7 @@ TotTagData = list[tuple[Timestamp,Distance]]
 Device = str
 EventLabel = int
 DiaryEvent = tuple[EventLabel,Timestamp,Timestamp]
+Windows = np.ndarray    # windows x samples x (timestamp, distance)
 
 
 ### 
@@ -66,6 +72,12 @@ def load_log(log_filepath: str) -> dict[Device,TotTagData]:
             tags[tag_id].append((timestamp,distance))
 
     return tags
+
+
+@functools.lru_cache(maxsize=None)
+def load_log_arrays(log_filepath: str) -> dict[Device,np.ndarray]:
+    """Loads TotTag data like load_log, but as one (timestamp, distance) array per device, caching the result for repeated window sweeps."""
+    return {tag_id: np.array(data, dtype=np.int64).reshape(-1, 2) for tag_id, data in load_log(log_filepath).items()}
     
 
 def load_diary(diary_filepath: str) -> tuple[list[DiaryEvent],dict[str,int]]:
@@ -140,87 +152,86 @@ def interleave(tags: dict[Device, TotTagData]):
 ###
 ###     Window Generation
 ###
+def valid_window_starts(timestamps: np.ndarray, window_length: int) -> np.ndarray:
+    """Returns the index of every sample that starts a window of window_length samples with consecutive timestamps."""
+    if len(timestamps) < window_length:
+        return np.empty(0, dtype=np.int64)
+    breaks = np.concatenate(([0], np.cumsum(np.diff(timestamps) != 1)))
+    return np.flatnonzero(breaks[window_length-1:] == breaks[:len(breaks)-window_length+1])
+
+
 def fill_buf(data: TotTagData, buf_size: int, start: int) -> tuple[TotTagData,int]:
     """Fills buffer with first valid window starting at index 'start', and returns a tuple containing the filled buffer and actual start index."""
-    buf = []
-    while len(buf) < buf_size:
-        for i in range(0, buf_size):
-            curr_index = start+i
-            if curr_index < len(data):
-                buf.append(data[curr_index])
-                # print(len(buf), curr_index, buf[-1], i)   # uncomment for fill_buf debug
-                prev_time = buf[i-1][0]
-                curr_time = buf[i][0]
-                if prev_time > curr_time:
-                    raise ReverseTimeError('Invalid log file.', data[curr_index-3:curr_index+3], data[curr_index-1], data[curr_index])
-                if len(buf) > 1 and prev_time + 1 != curr_time:
-                    start += i
-                    buf.clear()
-                    break
-            else:
-                raise EOFError("Failed to fill sliding window buffer")
-    return (buf, start)
-
-
-def generate_sliding_windows(data: dict[Device, TotTagData], tag: str, window_length: int, window_shift: int) -> list[TotTagData]:
-    """Generates and returns a list of windows of specified length and shift size."""
-    if tag in data:
-        index = 0
-        windows = []
+    data = np.asarray(data).reshape(-1, 2)
+    starts = valid_window_starts(data[:, 0], buf_size)
+    starts = starts[starts >= start]
+    if len(starts) == 0:
+        raise EOFError("Failed to fill sliding window buffer")
+    return ([tuple(sample) for sample in data[starts[0]:starts[0]+buf_size].tolist()], int(starts[0]))
 
-        while index + window_length - 1 < len(data[tag]):
-            try:
-                curr_window, index = fill_buf(data[tag], window_length, index)
-            except EOFError:
-                break
-            index += window_shift
-            windows.append(curr_window)
 
-        return windows
+def generate_sliding_windows(data: dict[Device, TotTagData], tag: str, window_length: int, window_shift: int) -> Windows:
+    """Generates and returns an array of windows of specified length and shift size."""
+    if tag in data:
+        samples = np.asarray(data[tag], dtype=np.int64).reshape(-1, 2)
+
+        # A reverse time skip anywhere in the log means it cannot be windowed
+        if len(samples) >= window_length:
+            reversals = np.flatnonzero(np.diff(samples[:, 0]) < 0)
+            if len(reversals):
+                skip = reversals[0] + 1
+                as_tuples = lambda rows: [tuple(row) for row in rows.tolist()]
+                raise ReverseTimeError('Invalid log file.', as_tuples(samples[max(skip-3, 0):skip+3]), tuple(samples[skip-1].tolist()), tuple(samples[skip].tolist()))
+
+        # Each window starts at the first valid start at least window_shift samples after the previous one
+        starts = valid_window_starts(samples[:, 0], window_length)
+        if window_shift != 1 and len(starts):
+            chosen, next_start = [], 0
+            while next_start < len(starts):
+                chosen.append(starts[next_start])
+                next_start = np.searchsorted(starts, starts[next_start] + window_shift)
+            starts = np.array(chosen, dtype=np.int64)
+
+        if len(starts) == 0:
+            return np.empty((0, window_length, 2), dtype=np.int64)
+        return sliding_window_view(samples, window_length, axis=0).transpose(0, 2, 1)[starts]
 
 
 ###
 ###     Window Processing
 ###
-def label_events(windows: list[TotTagData], diary: list[DiaryEvent], event_labels: list[EventLabel]) -> list[int]:
-    """Given windows of timeseries data, labels each one by the most common event during that period, and returns the list of labels."""
-    labels = []
-
-    for window in windows:
-        voting = []
-        for _ in event_labels:
-            voting.append(0)
-        
-        for event in diary:
-            start_event = max(event[1], window[0][0])
-            end_event = min(event[2], window[-1][0])
-            event_length = end_event - start_event
-
-            if event_length < 0:
-                continue
-            
-            window_length = window[-1][0] - window[0][0]
-
-            voting[event[0]] += event_length / window_length
-        
-        label = voting.index(max(voting))
+def label_events(windows: Windows, diary: list[DiaryEvent], event_labels: list[EventLabel]) -> np.ndarray:
+    """Given windows of timeseries data, labels each one by the most common event during that period, and returns the array of labels."""
+    window_starts, window_ends = windows[:, 0, 0], windows[:, -1, 0]
+    votes = np.zeros((len(windows), len(event_labels)))
+    if len(diary) and len(windows):
+        # Window starts and ends are both sorted, so the windows overlapping each event form one contiguous run
+        event_labels_array, event_starts, event_ends = (np.array(column, dtype=np.int64) for column in zip(*diary))
+        first = np.searchsorted(window_ends, event_starts, 'left')
+        last = np.searchsorted(window_starts, event_ends, 'right')
+        counts = np.maximum(last - first, 0)
+        pair_events = np.repeat(np.arange(len(diary)), counts)
+        pair_windows = np.arange(counts.sum()) - np.repeat(np.cumsum(counts) - counts, counts) + np.repeat(first, counts)
 
-        labels.append(label)
+        # Votes are added in diary order, just as summing over the diary one event at a time would
+        overlap = np.minimum(event_ends[pair_events], window_ends[pair_windows]) - np.maximum(event_starts[pair_events], window_starts[pair_windows])
+        overlapping = overlap >= 0
+        pair_events, pair_windows, overlap = pair_events[overlapping], pair_windows[overlapping], overlap[overlapping]
+        np.add.at(votes, (pair_windows, event_labels_array[pair_events]), overlap / (window_ends[pair_windows] - window_starts[pair_windows]))
 
-    return labels
+    return np.argmax(votes, axis=1)
 
 
-def strip_timestamps(windows: list[TotTagData]) -> list[list[Distance]]:
-    """Removes timestamps from a list of windows, priming it for the model, and returns the list of stripped windows."""
-    stripped_windows = []
+def strip_timestamps(windows: Windows) -> np.ndarray:
+    """Removes timestamps from an array of windows, priming it for the model, and returns the matrix of window distances."""
+    return windows[:, :, 1]
 
-    for window in windows:
-        strip_win = []
-        for tup in window:
-            strip_win.append(tup[1])
-        stripped_windows.append(strip_win)
 
-    return stripped_windows
+@functools.lru_cache(maxsize=None)
+def window_features(log_filepath: str, diary: tuple[DiaryEvent], num_labels: int, tag: str, window_length: int, window_shift: int) -> tuple[Windows,np.ndarray]:
+    """Returns the labeled sliding windows of one tag in a log, caching them so that every classifier and repeated setting reuses them."""
+    windows = generate_sliding_windows(load_log_arrays(log_filepath), tag, window_length, window_shift)
+    return windows, label_events(windows, diary, range(num_labels))
 
 
 ###
@@ -305,12 +316,12 @@ def graph_labeling(windows, window_labels, reverse_event_map, window_setting=-1)
     bins = {} 
     for i in range(len(windows)):
         if window_labels[i] not in bins: 
-            bins[window_labels[i]] = windows[i]
+            bins[window_labels[i]] = [tuple(x) for x in windows[i]]
         else:
             last_time = bins[window_labels[i]][-1][0]
             next_time = windows[i][0][0]
             bins[window_labels[i]].extend([(i, np.nan) for i in range(last_time + 1, next_time)])
-            bins[window_labels[i]].extend(windows[i])
+            bins[window_labels[i]].extend([tuple(x) for x in windows[i]])
 
     if window_setting != -1:
         plt.title(f'TotTag data labeling (window size {window_setting})')
@@ -331,37 +342,33 @@ def graph_labeling(windows, window_labels, reverse_event_map, window_setting=-1)
     plt.show()
 
 
-def do_model_stuff(window_setting, train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath):
-    # Load log and diary files
-    tags = load_log(train_log_filepath)
-    
-    # interleave(tags)
+def labeled_windows(window_setting, log_filepath, diary_filepath, target_tag, event_map=None):
+    """Loads a diary and returns the labeled windows of the target tag in its log, along with the event map used for labeling."""
+    if event_map is None:
+        diary, event_map = load_diary(diary_filepath)
+    else:
+        diary = load_testdiary(diary_filepath, event_map)
+    windows, labels = window_features(log_filepath, tuple(diary), len(event_map), target_tag, window_setting, 1)
+    return windows, labels, event_map
 
-    # exit()
-    diary, event_map = load_diary(train_diary_filepath)
-    test_tags = load_log(test_log_filepath)
-    test_diary = load_testdiary(test_diary_filepath, event_map)
 
-    # Create sliding windows
-    window_length = window_setting
-    window_shift = 1
-    windows      = generate_sliding_windows(tags, target_tag, window_length, window_shift)
-    test_windows = generate_sliding_windows(test_tags, target_tag, window_length, window_shift)
+def do_model_stuff(window_setting, train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath, target_tag, show_plot=True):
+    # Load log and diary files, then create and label sliding windows (cached across calls with the same files and window setting)
+    windows,      labels,      event_map = labeled_windows(window_setting, train_log_filepath, train_diary_filepath, target_tag)
+    test_windows, test_labels, _         = labeled_windows(window_setting, test_log_filepath,  test_diary_filepath,  target_tag, event_map)
 
     # demo_sliding_window(windows)
 
-    # Label the windows
-    labels      = label_events(windows,      diary,      event_map.values())
-    test_labels = label_events(test_windows, test_diary, event_map.values())
-
     # Print a summary for each window we've labeled (debug step; unnecessary)
     reverse_event_map = {v: k for k, v in event_map.items()}
     print("="*70)
     # print_window_times_and_labels(windows, labels, reverse_event_map)
     # print_window_times_and_labels(testwindows, testlabels, reverse_event_map, "test")
     
-    filtered_windows,      filtered_labels      = zip(*tuple(filter(lambda x: reverse_event_map[x[1]] != 'Undefined', tuple(zip(windows,      labels)))))
-    filtered_test_windows, filtered_test_labels = zip(*tuple(filter(lambda x: reverse_event_map[x[1]] != 'Undefined', tuple(zip(test_windows, test_labels)))))
+    defined      = labels      != event_map["Undefined"]
+    test_defined = test_labels != event_map["Undefined"]
+    filtered_windows,      filtered_labels      = windows[defined],           labels[defined]
+    filtered_test_windows, filtered_test_labels = test_windows[test_defined], test_labels[test_defined]
 
     # filtered_windows, filtered_labels = windows, labels
     # filtered_test_windows, filtered_test_labels = test_windows, test_labels
@@ -380,36 +387,33 @@ def do_model_stuff(window_setting, train_log_filepath, train_diary_filepath, tes
     # label: [(x1, y1), ...], ...
     # -> label (x1, y1), label (x2, y2), ...
 
-    flattened_knn_preds = []
-    for pred in knn_preds:
-        for _ in range(window_setting):
-            flattened_knn_preds.append(pred)
-    
-    flattened_test_labels = []
-    for label in filtered_test_labels:
-        for _ in range(window_setting):
-            flattened_test_labels.append(label)
-
-    flattened_rf_preds = []
-    for pred in rf_preds:
-        for _ in range(window_setting):
-            flattened_rf_preds.append(pred)
-
-    flattened_test_windows = []
-    for window in filtered_test_windows:
-        flattened_test_windows.extend(window)
+    flattened_knn_preds    = np.repeat(knn_preds, window_setting).tolist()
+    flattened_test_labels  = np.repeat(filtered_test_labels, window_setting).tolist()
+    flattened_rf_preds     = np.repeat(rf_preds, window_setting).tolist()
+    flattened_test_windows = [tuple(x) for x in filtered_test_windows.reshape(-1, 2).tolist()]
 
     print("="*70)
 
     # Plot the windows, allowing user to compare labels with those printed by debug step 
     # plot(tags)
 
-    graph_labeling(windows, labels, reverse_event_map, window_setting)
+    if show_plot:
+        graph_labeling(windows, labels, reverse_event_map, window_setting)
     
     # return (knn_preds, rf_preds)
     return flattened_knn_preds, flattened_rf_preds, flattened_test_windows, flattened_test_labels, reverse_event_map
 
 
+def sweep_window_settings(window_settings, train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath, target_tag):
+    """Runs do_model_stuff for every window setting across all cores, computing each distinct setting's windows only once, and returns the results in order."""
+    distinct_settings = sorted(set(window_settings))
+    run = functools.partial(do_model_stuff, train_log_filepath=train_log_filepath, train_diary_filepath=train_diary_filepath, test_log_filepath=test_log_filepath,
+                            test_diary_filepath=test_diary_filepath, target_tag=target_tag, show_plot=False)
+    with ProcessPoolExecutor(max_workers=min(len(distinct_settings), os.cpu_count() or 1)) as executor:
+        results = dict(zip(distinct_settings, executor.map(run, distinct_settings)))
+    return [results[window_setting] for window_setting in window_settings]
+
+
 if __name__ == "__main__":
     ### Test the code here! :)
 
@@ -427,11 +431,16 @@ if __name__ == "__main__":
     # flattened random-forest predictions = frp
     # flattened test windows = ftw
     # number = window size
-    flat_knnsize1, flat_rfsize1, flat_test_windowssize1, flat_test_labels_size1, reverse_event_mapsize1 = do_model_stuff(size1, train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath)
-    flat_knnsize2, flat_rfsize2, flat_test_windowssize2, flat_test_labels_size2, reverse_event_mapsize2 = do_model_stuff(size2, train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath)
+    (flat_knnsize1, flat_rfsize1, flat_test_windowssize1, flat_test_labels_size1, reverse_event_mapsize1), \
+    (flat_knnsize2, flat_rfsize2, flat_test_windowssize2, flat_test_labels_size2, reverse_event_mapsize2) = \
+        sweep_window_settings([size1, size2], train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath, target_tag)
 
-    # for i in range (3,30):
-        # do_model_stuff(i, train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath)
+    # Plot the labeled training windows of each setting, as do_model_stuff does when run on its own
+    for window_setting in (size1, size2):
+        windows, labels, event_map = labeled_windows(window_setting, train_log_filepath, train_diary_filepath, target_tag)
+        graph_labeling(windows, labels, {v: k for k, v in event_map.items()}, window_setting)
+
+    # sweep_window_settings(range(3,30), train_log_filepath, train_diary_filepath, test_log_filepath, test_diary_filepath, target_tag)
 
     # print(len(flat_knnsize1), len(flat_testwindowssize1))
 
@@ -55,6 +55,7 @@ typedef struct
   uint8_t    numAlloc;             /*!< Number of outstanding allocations. */
   uint8_t    maxAlloc;             /*!< High allocation watermark. */
   uint16_t   maxReqLen;            /*!< Maximum requested buffer length. */
+  uint16_t   numAllocFail;         /*!< Number of failed requests that best fit this pool. */
 } WsfBufPoolStat_t;
 
 /*! WSF buffer diagnostics - buffer allocation failure */
@@ -86,6 +86,7 @@ typedef struct
   uint8_t           numAlloc;       /* number of buffers currently allocated from pool */
   uint8_t           maxAlloc;       /* maximum buffers ever allocated from pool */
   uint16_t          maxReqLen;      /* maximum request length from pool. */
+  uint16_t          numAllocFail;   /* number of failed requests that best fit this pool */
 #endif
 } wsfBufPool_t;
 
@@ -181,6 +182,7 @@ uint16_t WsfBufInit(uint16_t bufMemLen, uint8_t *pBufMem, uint8_t numPools, wsfB
     pPool->numAlloc = 0;
     pPool->maxAlloc = 0;
     pPool->maxReqLen = 0;
+    pPool->numAllocFail = 0;
 #endif
 
     WSF_TRACE_INFO2("Creating pool len=%u num=%u", pPool->desc.len, pPool->desc.num);
@@ -300,6 +302,18 @@ void *WsfBufAlloc(uint16_t len)
   }
 
   /* allocation failed */
+#if WSF_BUF_STATS == TRUE
+  /* charge the failure to the smallest pool that could have held the request */
+  pPool = (wsfBufPool_t *) wsfBufMem;
+  for (i = wsfBufNumPools; (i > 1) && (len > pPool->desc.len); i--)
+  {
+    pPool++;
+  }
+  WSF_CS_ENTER(cs);
+  pPool->numAllocFail++;
+  WSF_CS_EXIT(cs);
+#endif
+
 #if WSF_OS_DIAG == TRUE
   if (wsfBufDiagCback != NULL)
   {
@@ -455,10 +469,12 @@ void WsfBufGetPoolStats(WsfBufPoolStat_t *pStat, uint8_t poolId)
   pStat->numAlloc = pPool[poolId].numAlloc;
   pStat->maxAlloc = pPool[poolId].maxAlloc;
   pStat->maxReqLen = pPool[poolId].maxReqLen;
+  pStat->numAllocFail = pPool[poolId].numAllocFail;
 #else
   pStat->numAlloc = 0;
   pStat->maxAlloc = 0;
   pStat->maxReqLen = 0;
+  pStat->numAllocFail = 0;
 #endif
 
   /* exit critical section */
@@ -35,8 +35,25 @@
 #define MAX_NUM_RANGING_DEVICES                     10
 #define COMPRESSED_RANGE_DATUM_LENGTH               (1 + sizeof(int16_t))       // EUI + Range
 #define MAX_COMPRESSED_RANGE_DATA_LENGTH            (1 + (COMPRESSED_RANGE_DATUM_LENGTH * MAX_NUM_RANGING_DEVICES))
+#define RANGE_BATCH_HEADER_LENGTH                   5           // Batch Flag + Number of Rounds, First Round Sequence, First Round Age
+#define RANGE_BATCH_ROUND_HEADER_LENGTH             2           // Milliseconds Since First Round
+#define RANGE_BATCH_FLAG                            0x80
+#define MAX_RANGE_BATCH_NUM_ROUNDS                  8
+#define MAX_RANGE_BATCH_DATA_LENGTH                 (RANGE_BATCH_HEADER_LENGTH + (MAX_RANGE_BATCH_NUM_ROUNDS * (RANGE_BATCH_ROUND_HEADER_LENGTH + MAX_COMPRESSED_RANGE_DATA_LENGTH)))
+#define BROADCAST_RANGE_HEADER_LENGTH               4           // Company ID + Round Sequence + Number of Ranges
+#define BROADCAST_RANGE_BITS_PER_RANGE              12          // Centimeters
+#define MAX_BROADCAST_RANGE_DATA_LENGTH             (BROADCAST_RANGE_HEADER_LENGTH + MAX_NUM_RANGING_DEVICES + (((BROADCAST_RANGE_BITS_PER_RANGE * MAX_NUM_RANGING_DEVICES) + 7) / 8))
 
 #define STORAGE_QUEUE_MAX_NUM_ITEMS                 24
+#define STORAGE_ERASE_AHEAD_NUM_BLOCKS              4
+#define STORAGE_BATCH_NUM_PAGES                     4
+#define STORAGE_BATCH_MAX_LATENCY_S                 300
+#define STORAGE_CAPACITY_EVALUATION_PERIOD_S        3600
+#define STORAGE_CAPACITY_SAFETY_MARGIN_PERCENT      10
+#define STORAGE_RANGE_SUMMARY_PERIOD_S              60
+#define STORAGE_TIER_RANGE_SUMMARIES_PERCENT_FULL   90
+#define STORAGE_TIER_MOTION_ONLY_PERCENT_FULL       95
+#define STORAGE_TIER_VOLTAGE_ONLY_PERCENT_FULL      98
 
 #define BATTERY_CHECK_INTERVAL_S                    300
 
@@ -66,7 +83,7 @@ typedef enum { BATTERY_EMPTY = 3500, BATTERY_CRITICAL = 3680, BATTERY_NOMINAL =
 #define HW_MODEL                                    "TotTag"
 #define HW_REVISION                                 "Rev. "STRINGIZE_VAL(_HW_REVISION)
 
-#define MAX_NUM_CONNECTIONS                         1
+#define MAX_NUM_CONNECTIONS                         3           // Must not exceed DM_CONN_MAX
 
 #define BLE_ADVERTISING_DURATION_MS                 0
 #define BLE_ADVERTISING_INTERVAL_0_625_MS           120         // 75 ms
@@ -81,6 +98,15 @@ typedef enum { BATTERY_EMPTY = 3500, BATTERY_CRITICAL = 3680, BATTERY_NOMINAL =
 #define BLE_CONNECTION_SLAVE_LATENCY                9
 #define BLE_SUPERVISION_TIMEOUT_10_MS               100         // 1000 ms
 #define BLE_MAX_CONNECTION_UPDATE_ATTEMPTS          5
+#define BLE_DOWNLOAD_WINDOW_NUM_PACKETS             32
+#define BLE_DOWNLOAD_MAX_PACKETS_IN_FLIGHT          16          // Sent but not yet acknowledged by the host
+#define BLE_SHARED_DOWNLOAD_MAX_PACKETS_IN_FLIGHT   2           // While other connections are open
+#define BLE_DOWNLOAD_MIN_CONNECTION_INTERVAL_1_25_MS 6          // 7.5 ms
+#define BLE_DOWNLOAD_MAX_CONNECTION_INTERVAL_1_25_MS 12         // 15 ms
+#define BLE_DOWNLOAD_CONNECTION_SLAVE_LATENCY       0
+#define BLE_DOWNLOAD_MAX_TX_OCTETS                  251
+#define BLE_DOWNLOAD_MAX_TX_TIME_US                 2120
+#define BLE_MAX_NUM_BUFFER_POOLS                    8
 
 #define BLUETOOTH_COMPANY_ID                        0xe0,0x02
 #define BLE_LIVE_STATS_SERVICE_ID                   0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x52,0x31,0x8c,0xd6
@@ -89,12 +115,15 @@ typedef enum { BATTERY_EMPTY = 3500, BATTERY_CRITICAL = 3680, BATTERY_NOMINAL =
 #define BLE_LIVE_STATS_FINDMYTOTTAG_CHAR            0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x55,0x31,0x8c,0xd6
 #define BLE_LIVE_STATS_RANGING_CHAR                 0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x56,0x31,0x8c,0xd6
 #define BLE_LIVE_STATS_ADDRESS_CHAR                 0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x57,0x31,0x8c,0xd6
+#define BLE_LIVE_STATS_STORAGE_CHAR                 0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x58,0x31,0x8c,0xd6
 #define BLE_SCHEDULING_SERVICE_ID                   0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x5A,0x31,0x8c,0xd6
 #define BLE_SCHEDULING_REQUEST_CHAR                 0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x5B,0x31,0x8c,0xd6
 #define BLE_MAINTENANCE_SERVICE_ID                  0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x60,0x31,0x8c,0xd6
 #define BLE_MAINTENANCE_EXPERIMENT_CHAR             0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x61,0x31,0x8c,0xd6
 #define BLE_MAINTENANCE_COMMAND_CHAR                0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x62,0x31,0x8c,0xd6
 #define BLE_MAINTENANCE_DATA_CHAR                   0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x63,0x31,0x8c,0xd6
+#define BLE_MAINTENANCE_LINK_STATUS_CHAR            0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x64,0x31,0x8c,0xd6
+#define BLE_MAINTENANCE_BUFFER_STATUS_CHAR          0x2e,0x5d,0x5e,0x39,0x31,0x52,0x45,0x0c,0x90,0xee,0x3f,0xa2,0x65,0x31,0x8c,0xd6
 
 
 // Ranging Protocol Configuration --------------------------------------------------------------------------------------
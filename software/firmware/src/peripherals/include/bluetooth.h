@@ -10,6 +10,34 @@
 
 typedef void (*ble_discovery_callback_t)(const uint8_t ble_address[6], uint8_t ranging_role);
 
+typedef struct __attribute__ ((__packed__))
+{
+   uint16_t connection_interval_1_25_ms, slave_latency, supervision_timeout_10_ms;
+   uint8_t tx_phy, rx_phy, bulk_transfer_active;
+   uint16_t max_tx_octets, max_rx_octets;
+   uint32_t last_transfer_num_bytes, last_transfer_duration_ms;
+} ble_link_status_t;
+
+typedef struct
+{
+   bool is_connected, ranges_requested, data_requested;
+   uint16_t mtu;
+   ble_link_status_t link_status;
+} ble_connection_t;
+
+typedef struct __attribute__ ((__packed__))
+{
+   uint16_t buffer_length;
+   uint8_t num_buffers, num_allocated, max_allocated;
+   uint16_t max_request_length, num_failed_allocations;
+} ble_buffer_pool_status_t;
+
+typedef struct __attribute__ ((__packed__))
+{
+   uint8_t num_pools;
+   ble_buffer_pool_status_t pools[BLE_MAX_NUM_BUFFER_POOLS];
+} ble_buffer_status_t;
+
 
 // Public API Functions ------------------------------------------------------------------------------------------------
 
@@ -23,6 +51,7 @@ void bluetooth_register_discovery_callback(ble_discovery_callback_t callback);
 uint8_t bluetooth_get_current_ranging_role(void);
 void bluetooth_set_current_ranging_role(uint8_t ranging_role);
 void bluetooth_write_range_results(const uint8_t *results, uint16_t results_length);
+void bluetooth_flush_range_results(bool force);
 void bluetooth_start_advertising(void);
 void bluetooth_stop_advertising(void);
 bool bluetooth_is_advertising(void);
@@ -31,7 +60,13 @@ void bluetooth_stop_scanning(void);
 void bluetooth_reset_scanning(void);
 bool bluetooth_is_scanning(void);
 bool bluetooth_is_connected(void);
+uint8_t bluetooth_get_num_connections(void);
 void bluetooth_clear_whitelist(void);
 void bluetooth_add_device_to_whitelist(uint8_t* uid);
+void bluetooth_start_bulk_transfer(uint8_t connection_id);
+void bluetooth_finish_bulk_transfer(uint8_t connection_id, uint32_t num_bytes, uint32_t duration_ms);
+void bluetooth_retrieve_link_status(uint8_t connection_id, ble_link_status_t *status);
+void bluetooth_retrieve_buffer_status(ble_buffer_status_t *status);
+void bluetooth_print_buffer_status(void);
 
 #endif  // #ifndef __BLUETOOTH_HEADER_H__
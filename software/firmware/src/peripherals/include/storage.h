@@ -13,7 +13,8 @@ typedef enum {
    STORAGE_TYPE_VOLTAGE,
    STORAGE_TYPE_CHARGING_EVENT,
    STORAGE_TYPE_MOTION,
-   STORAGE_TYPE_RANGES
+   STORAGE_TYPE_RANGES,
+   STORAGE_TYPE_RANGE_SUMMARY
 } storage_data_type_t;
 
 
@@ -28,6 +29,9 @@ typedef enum {
 #define MEMORY_PAGE_WITH_ECC_SIZE_BYTES             (MEMORY_PAGE_SIZE_BYTES + MEMORY_ECC_BYTES_PER_PAGE)
 #define MEMORY_NUM_BLOCK_ERRORS_BEFORE_REMOVAL      3
 #define MEMORY_NUM_DATA_BYTES_PER_PAGE              (MEMORY_PAGE_SIZE_BYTES - 4)
+#define MEMORY_SECTOR_SIZE_BYTES                    512
+#define MEMORY_SECTORS_PER_PAGE                     (MEMORY_PAGE_SIZE_BYTES / MEMORY_SECTOR_SIZE_BYTES)
+#define MEMORY_MAX_PROGRAMS_PER_PAGE                4
 
 
 // Public API Functions ------------------------------------------------------------------------------------------------
@@ -45,5 +49,8 @@ void storage_enter_maintenance_mode(void);
 void storage_exit_maintenance_mode(void);
 uint32_t storage_retrieve_num_data_chunks(uint32_t ending_timestamp);
 uint32_t storage_retrieve_next_data_chunk(uint8_t *buffer);
+void storage_skip_data_chunks(uint32_t num_chunks);
+uint32_t storage_retrieve_capacity_bytes(void);
+uint32_t storage_retrieve_num_free_bytes(void);
 
 #endif  // #ifndef __STORAGE_HEADER_H__
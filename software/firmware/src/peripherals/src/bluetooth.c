@@ -12,18 +12,20 @@
 #include "logging.h"
 #include "maintenance_functionality.h"
 #include "maintenance_service.h"
+#include "wsf_buf.h"
 
 
 // Static Global Variables ---------------------------------------------------------------------------------------------
 
-static volatile uint16_t connection_mtu;
-static volatile bool is_scanning, is_advertising, is_connected, ranges_requested, data_requested;
+static volatile ble_connection_t connections[DM_CONN_MAX];
+static volatile bool is_scanning, is_advertising;
 static volatile bool expected_scanning, expected_advertising, is_initialized, first_initialization;
 static volatile uint8_t adv_data_conn[HCI_ADV_DATA_LEN], scan_data_conn[HCI_ADV_DATA_LEN], current_ranging_role[3];
 static const uint8_t adv_data_flags[] = { DM_FLAG_LE_GENERAL_DISC | DM_FLAG_LE_BREDR_NOT_SUP };
 static const char adv_local_name[] = { 'T', 'o', 't', 'T', 'a', 'g' };
 static ble_discovery_callback_t discovery_callback;
 static uint8_t ble_sys_id[8];
+static uint16_t range_round_sequence;
 
 
 // Bluetooth LE Advertising and Connection Parameters ------------------------------------------------------------------
@@ -42,6 +44,20 @@ static const appUpdateCfg_t ble_update_cfg = {
    BLE_SUPERVISION_TIMEOUT_10_MS,
    BLE_MAX_CONNECTION_UPDATE_ATTEMPTS
 };
+static const hciConnSpec_t ble_bulk_transfer_conn_spec = {
+   BLE_DOWNLOAD_MIN_CONNECTION_INTERVAL_1_25_MS,
+   BLE_DOWNLOAD_MAX_CONNECTION_INTERVAL_1_25_MS,
+   BLE_DOWNLOAD_CONNECTION_SLAVE_LATENCY,
+   BLE_SUPERVISION_TIMEOUT_10_MS,
+   0, 0
+};
+static const hciConnSpec_t ble_low_power_conn_spec = {
+   BLE_MIN_CONNECTION_INTERVAL_1_25_MS,
+   BLE_MAX_CONNECTION_INTERVAL_1_25_MS,
+   BLE_CONNECTION_SLAVE_LATENCY,
+   BLE_SUPERVISION_TIMEOUT_10_MS,
+   0, 0
+};
 static const attCfg_t ble_att_cfg = { 1, BLE_DESIRED_MTU, BLE_TRANSACTION_TIMEOUT_S, 4 };
 static const appMasterCfg_t ble_master_cfg = {
    BLE_SCANNING_INTERVAL_0_625_MS,
@@ -66,12 +82,48 @@ static const attsCccSet_t characteristicSet[TOTTAG_NUM_CCC_CHARACTERISTICS] =
 {
    { GATT_SERVICE_CHANGED_CCC_HANDLE,  ATT_CLIENT_CFG_INDICATE,  DM_SEC_LEVEL_NONE },
    { RANGES_CCC_HANDLE,                  ATT_CLIENT_CFG_NOTIFY,  DM_SEC_LEVEL_NONE },
-   { MAINTENANCE_RESULT_CCC_HANDLE,    ATT_CLIENT_CFG_INDICATE,  DM_SEC_LEVEL_NONE }
+   { MAINTENANCE_RESULT_CCC_HANDLE,    (ATT_CLIENT_CFG_INDICATE | ATT_CLIENT_CFG_NOTIFY),  DM_SEC_LEVEL_NONE }
 };
 
 
 // Bluetooth LE Advertising Setup Functions ----------------------------------------------------------------------------
 
+static volatile ble_connection_t* get_connection(dmConnId_t connId)
+{
+   // Return the bookkeeping for the specified connection, if valid
+   return ((connId == DM_CONN_ID_NONE) || (connId > DM_CONN_MAX)) ? NULL : &connections[connId - 1];
+}
+
+#ifdef ENABLE_LIVE_RANGE_BROADCAST
+static uint8_t build_live_range_broadcast(const uint8_t *results, uint8_t *broadcast)
+{
+   // Prefix the broadcast with a rolling round counter so that observers can discard repeated scan responses
+   static uint8_t round_sequence = 0;
+   const uint8_t num_ranges = MIN(results[0], MAX_NUM_RANGING_DEVICES);
+   const uint8_t ranging_role[] = { BLUETOOTH_COMPANY_ID };
+   uint8_t *packed_ranges = broadcast + BROADCAST_RANGE_HEADER_LENGTH + num_ranges;
+   memcpy(broadcast, ranging_role, sizeof(ranging_role));
+   broadcast[2] = round_sequence++;
+   broadcast[3] = num_ranges;
+
+   // List all device EUIs followed by their ranges packed as consecutive 12-bit centimeter values
+   const uint8_t packed_length = (uint8_t)(((BROADCAST_RANGE_BITS_PER_RANGE * num_ranges) + 7) / 8);
+   memset(packed_ranges, 0, packed_length);
+   for (uint8_t i = 0; i < num_ranges; ++i)
+   {
+      int16_t range_mm;
+      const uint8_t *datum = results + 1 + (i * COMPRESSED_RANGE_DATUM_LENGTH);
+      memcpy(&range_mm, datum + 1, sizeof(range_mm));
+      const uint16_t range_cm = (range_mm > 0) ? (uint16_t)((range_mm + 5) / 10) : 0;
+      const uint32_t bit_index = (uint32_t)i * BROADCAST_RANGE_BITS_PER_RANGE;
+      broadcast[BROADCAST_RANGE_HEADER_LENGTH + i] = datum[0];
+      packed_ranges[bit_index / 8] |= (uint8_t)(range_cm << (bit_index % 8));
+      packed_ranges[(bit_index / 8) + 1] |= (uint8_t)(range_cm >> (8 - (bit_index % 8)));
+   }
+   return BROADCAST_RANGE_HEADER_LENGTH + num_ranges + packed_length;
+}
+#endif
+
 static void advertising_setup(void)
 {
    // Set the advertising data
@@ -131,16 +183,28 @@ static void deviceManagerCallback(dmEvt_t *pDmEvt)
             bluetooth_start_scanning();
          break;
       case DM_CONN_OPEN_IND:
-         print("TotTag BLE: deviceManagerCallback: Received DM_CONN_OPEN_IND\n");
-         is_connected = true;
+      {
+         print("TotTag BLE: deviceManagerCallback: Received DM_CONN_OPEN_IND: connID = %u, Connections = %u\n", (uint32_t)pDmEvt->hdr.param, (uint32_t)bluetooth_get_num_connections() + 1);
+         volatile ble_connection_t *connection = &connections[pDmEvt->hdr.param - 1];
+         memset((void*)connection, 0, sizeof(*connection));
+         connection->is_connected = true;
+         connection->mtu = AttGetMtu(pDmEvt->hdr.param);
+         connection->link_status.connection_interval_1_25_ms = pDmEvt->connOpen.connInterval;
+         connection->link_status.slave_latency = pDmEvt->connOpen.connLatency;
+         connection->link_status.supervision_timeout_10_ms = pDmEvt->connOpen.supTimeout;
+         connection->link_status.tx_phy = connection->link_status.rx_phy = HCI_PHY_LE_1M_BIT;
+         connection->link_status.max_tx_octets = connection->link_status.max_rx_octets = HCI_ACL_DEFAULT_LEN;
+         AttsCccInitTable(pDmEvt->hdr.param, NULL);
          is_advertising = false;
          bluetooth_start_advertising();
-         connection_mtu = AttGetMtu(pDmEvt->hdr.param);
-         AttsCccInitTable(pDmEvt->hdr.param, NULL);
          break;
+      }
       case DM_CONN_CLOSE_IND:
-         print("TotTag BLE: deviceManagerCallback: Received DM_CONN_CLOSE_IND\n");
-         is_connected = ranges_requested = data_requested = false;
+         print("TotTag BLE: deviceManagerCallback: Received DM_CONN_CLOSE_IND: connID = %u\n", (uint32_t)pDmEvt->hdr.param);
+         memset((void*)&connections[pDmEvt->hdr.param - 1], 0, sizeof(connections[0]));
+         setRangeResultsBatchSize((dmConnId_t)pDmEvt->hdr.param, 1);
+         stopSendingLogData((dmConnId_t)pDmEvt->hdr.param);
+         bluetooth_print_buffer_status();
          AttsCccClearTable(pDmEvt->hdr.param);
          bluetooth_start_advertising();
          break;
@@ -183,8 +247,28 @@ static void deviceManagerCallback(dmEvt_t *pDmEvt)
          }
          break;
       }
+      case DM_CONN_UPDATE_IND:
+         print("TotTag BLE: deviceManagerCallback: Negotiated Connection Interval = %u, Latency = %u, Timeout = %u\n",
+               (uint32_t)pDmEvt->connUpdate.connInterval, (uint32_t)pDmEvt->connUpdate.connLatency, (uint32_t)pDmEvt->connUpdate.supTimeout);
+         if (pDmEvt->connUpdate.status == HCI_SUCCESS)
+         {
+            connections[pDmEvt->hdr.param - 1].link_status.connection_interval_1_25_ms = pDmEvt->connUpdate.connInterval;
+            connections[pDmEvt->hdr.param - 1].link_status.slave_latency = pDmEvt->connUpdate.connLatency;
+            connections[pDmEvt->hdr.param - 1].link_status.supervision_timeout_10_ms = pDmEvt->connUpdate.supTimeout;
+         }
+         break;
+      case DM_CONN_DATA_LEN_CHANGE_IND:
+         print("TotTag BLE: deviceManagerCallback: Negotiated Data Length: TX = %u, RX = %u\n", (uint32_t)pDmEvt->dataLenChange.maxTxOctets, (uint32_t)pDmEvt->dataLenChange.maxRxOctets);
+         connections[pDmEvt->hdr.param - 1].link_status.max_tx_octets = pDmEvt->dataLenChange.maxTxOctets;
+         connections[pDmEvt->hdr.param - 1].link_status.max_rx_octets = pDmEvt->dataLenChange.maxRxOctets;
+         break;
       case DM_PHY_UPDATE_IND:
          print("TotTag BLE: deviceManagerCallback: Negotiated PHY: RX = %d, TX = %d\n", pDmEvt->phyUpdate.rxPhy, pDmEvt->phyUpdate.txPhy);
+         if (pDmEvt->phyUpdate.status == HCI_SUCCESS)
+         {
+            connections[pDmEvt->hdr.param - 1].link_status.tx_phy = pDmEvt->phyUpdate.txPhy;
+            connections[pDmEvt->hdr.param - 1].link_status.rx_phy = pDmEvt->phyUpdate.rxPhy;
+         }
          break;
       case DM_HW_ERROR_IND:
          print("TotTag BLE: deviceManagerCallback: Received DM_HW_ERROR_IND...Rebooting BLE\n");
@@ -202,16 +286,25 @@ static void deviceManagerCallback(dmEvt_t *pDmEvt)
 static void attProtocolCallback(attEvt_t *pEvt)
 {
    // Handle the ATT Protocol message based on its type
+   volatile ble_connection_t *connection = get_connection((dmConnId_t)pEvt->hdr.param);
    switch (pEvt->hdr.event)
    {
       case ATT_MTU_UPDATE_IND:
-         print("TotTag BLE: attProtocolCallback: Negotiated MTU = %u\n", (uint32_t)pEvt->mtu);
-         connection_mtu = pEvt->mtu;
+         print("TotTag BLE: attProtocolCallback: Negotiated MTU = %u, connID = %u\n", (uint32_t)pEvt->mtu, (uint32_t)pEvt->hdr.param);
+         if (connection)
+            connection->mtu = pEvt->mtu;
          break;
       case ATTS_HANDLE_VALUE_CNF:
-         print("TotTag BLE: attProtocolCallback: Data Notify Completed = %u\n", (uint32_t)pEvt->hdr.status);
-         if (((pEvt->hdr.status == ATT_SUCCESS) || (pEvt->hdr.status == ATT_ERR_TIMEOUT)) && (pEvt->handle == MAINTENANCE_RESULT_HANDLE) && data_requested)
-            continueSendingLogData((dmConnId_t)pEvt->hdr.param, connection_mtu - 3, pEvt->hdr.status == ATT_ERR_TIMEOUT);
+         if (!connection || !connection->data_requested)
+            break;
+         else if (isStreamingLogData())
+            continueStreamingLogData((dmConnId_t)pEvt->hdr.param, pEvt->handle, pEvt->hdr.status);
+         else if (pEvt->handle == MAINTENANCE_RESULT_HANDLE)
+         {
+            print("TotTag BLE: attProtocolCallback: Data Notify Completed = %u\n", (uint32_t)pEvt->hdr.status);
+            if ((pEvt->hdr.status == ATT_SUCCESS) || (pEvt->hdr.status == ATT_ERR_TIMEOUT))
+               continueSendingLogData((dmConnId_t)pEvt->hdr.param, connection->mtu - 3, pEvt->hdr.status == ATT_ERR_TIMEOUT);
+         }
          break;
       default:
          print("TotTag BLE: attProtocolCallback: Received Event ID %d\n", pEvt->hdr.event);
@@ -222,11 +315,14 @@ static void attProtocolCallback(attEvt_t *pEvt)
 static void cccCallback(attsCccEvt_t *pEvt)
 {
    // Handle various BLE notification requests
-   print("TotTag BLE: cccCallback: index = %d, handle = %d, value = %d\n", pEvt->idx, pEvt->handle, pEvt->value);
-   if (pEvt->idx == TOTTAG_RANGING_CCC_IDX)
-      ranges_requested = (pEvt->value == ATT_CLIENT_CFG_NOTIFY);
+   print("TotTag BLE: cccCallback: connID = %d, index = %d, handle = %d, value = %d\n", pEvt->hdr.param, pEvt->idx, pEvt->handle, pEvt->value);
+   volatile ble_connection_t *connection = get_connection((dmConnId_t)pEvt->hdr.param);
+   if (!connection)
+      return;
+   else if (pEvt->idx == TOTTAG_RANGING_CCC_IDX)
+      connection->ranges_requested = (pEvt->value == ATT_CLIENT_CFG_NOTIFY);
    else if (pEvt->idx == TOTTAG_MAINTENANCE_RESULT_CCC_IDX)
-      data_requested = (pEvt->value == ATT_CLIENT_CFG_INDICATE);
+      connection->data_requested = (pEvt->value == ATT_CLIENT_CFG_INDICATE) || (pEvt->value == ATT_CLIENT_CFG_NOTIFY);
 }
 
 
@@ -237,8 +333,9 @@ void bluetooth_init(uint8_t* uid)
    // Initialize static variables
    const uint8_t ranging_role[] = { BLUETOOTH_COMPANY_ID, 0x00 };
    memcpy((uint8_t*)current_ranging_role, ranging_role, sizeof(ranging_role));
-   data_requested = expected_scanning = expected_advertising = is_initialized = false;
-   is_scanning = is_advertising = is_connected = ranges_requested = false;
+   memset((void*)connections, 0, sizeof(connections));
+   expected_scanning = expected_advertising = is_initialized = false;
+   is_scanning = is_advertising = false;
    first_initialization = true;
    discovery_callback = NULL;
 
@@ -366,9 +463,33 @@ void bluetooth_set_current_ranging_role(uint8_t ranging_role)
 
 void bluetooth_write_range_results(const uint8_t *results, uint16_t results_length)
 {
-   // Update the current set of ranging data
-   if (ranges_requested)
-      updateRangeResults(AppConnIsOpen(), results, results_length);
+   // Update the current set of ranging data for every connection that requested it
+   const uint16_t round_sequence = range_round_sequence++;
+   for (dmConnId_t connId = 1; connId <= DM_CONN_MAX; ++connId)
+      if (connections[connId - 1].is_connected && connections[connId - 1].ranges_requested)
+         updateRangeResults(connId, round_sequence, results, results_length);
+#ifdef ENABLE_LIVE_RANGE_BROADCAST
+
+   // Publish the results in the scan response so that any number of observers can collect them without connecting
+   if (is_initialized)
+   {
+      uint8_t broadcast[MAX_BROADCAST_RANGE_DATA_LENGTH];
+      if (is_advertising)
+      {
+         is_advertising = false;
+         appAdvStop(0, NULL);
+      }
+      appAdvSetAdValue(DM_ADV_HANDLE_DEFAULT, APP_SCAN_DATA_CONNECTABLE, DM_ADV_TYPE_MANUFACTURER, build_live_range_broadcast(results, broadcast), broadcast);
+   }
+#endif
+}
+
+void bluetooth_flush_range_results(bool force)
+{
+   // Send any batched ranging results that are overdue, or all of them once ranging stops
+   for (dmConnId_t connId = 1; connId <= DM_CONN_MAX; ++connId)
+      if (connections[connId - 1].is_connected && connections[connId - 1].ranges_requested)
+         flushRangeResults(connId, force);
 }
 
 void bluetooth_start_advertising(void)
@@ -440,8 +561,17 @@ bool bluetooth_is_scanning(void)
 
 bool bluetooth_is_connected(void)
 {
-   // Return whether we are actively connected to another device
-   return is_connected;
+   // Return whether we are actively connected to at least one other device
+   return bluetooth_get_num_connections() > 0;
+}
+
+uint8_t bluetooth_get_num_connections(void)
+{
+   // Count the number of currently open connections
+   uint8_t num_connections = 0;
+   for (uint8_t i = 0; i < DM_CONN_MAX; ++i)
+      num_connections += connections[i].is_connected ? 1 : 0;
+   return num_connections;
 }
 
 void bluetooth_clear_whitelist(void)
@@ -461,3 +591,69 @@ void bluetooth_add_device_to_whitelist(uint8_t* uid)
    DmDevSetFilterPolicy(DM_FILT_POLICY_MODE_SCAN, HCI_FILT_WHITE_LIST);
 #endif
 }
+
+void bluetooth_start_bulk_transfer(dmConnId_t connId)
+{
+   // Request a short connection interval, the 2M PHY, and maximum-length data packets for the duration of the transfer
+   volatile ble_connection_t *connection = get_connection(connId);
+   if (connection && connection->is_connected && !connection->link_status.bulk_transfer_active)
+   {
+      connection->link_status.bulk_transfer_active = true;
+      DmConnUpdate(connId, (hciConnSpec_t*)&ble_bulk_transfer_conn_spec);
+      DmSetPhy(connId, HCI_ALL_PHY_ALL_PREFERENCES, HCI_PHY_LE_2M_BIT, HCI_PHY_LE_2M_BIT, HCI_PHY_OPTIONS_NONE);
+      DmConnSetDataLen(connId, BLE_DOWNLOAD_MAX_TX_OCTETS, BLE_DOWNLOAD_MAX_TX_TIME_US);
+   }
+}
+
+void bluetooth_finish_bulk_transfer(dmConnId_t connId, uint32_t num_bytes, uint32_t duration_ms)
+{
+   // Record the resulting throughput and revert to the low-power connection parameters
+   volatile ble_connection_t *connection = get_connection(connId);
+   if (!connection)
+      return;
+   connection->link_status.last_transfer_num_bytes = num_bytes;
+   connection->link_status.last_transfer_duration_ms = duration_ms;
+   print("TotTag BLE: Bulk transfer throughput = %u B/s over %u x 1.25 ms intervals, PHY = %u, Data Length = %u, Connections = %u\n",
+         duration_ms ? (uint32_t)(((uint64_t)num_bytes * 1000) / duration_ms) : 0, (uint32_t)connection->link_status.connection_interval_1_25_ms,
+         (uint32_t)connection->link_status.tx_phy, (uint32_t)connection->link_status.max_tx_octets, (uint32_t)bluetooth_get_num_connections());
+   if (connection->is_connected && connection->link_status.bulk_transfer_active)
+      DmConnUpdate(connId, (hciConnSpec_t*)&ble_low_power_conn_spec);
+   connection->link_status.bulk_transfer_active = false;
+   bluetooth_print_buffer_status();
+}
+
+void bluetooth_retrieve_link_status(dmConnId_t connId, ble_link_status_t *status)
+{
+   // Copy the most recently negotiated link parameters and transfer statistics of the specified connection
+   volatile ble_connection_t *connection = get_connection(connId);
+   if (connection)
+      memcpy(status, (const ble_link_status_t*)&connection->link_status, sizeof(*status));
+   else
+      memset(status, 0, sizeof(*status));
+}
+
+void bluetooth_retrieve_buffer_status(ble_buffer_status_t *status)
+{
+   // Copy the current utilization, high-water mark, and failure count of each WSF buffer pool
+   WsfBufPoolStat_t pool_stats;
+   memset(status, 0, sizeof(*status));
+   status->num_pools = MIN(WsfBufGetNumPool(), BLE_MAX_NUM_BUFFER_POOLS);
+   for (uint8_t i = 0; i < status->num_pools; ++i)
+   {
+      WsfBufGetPoolStats(&pool_stats, i);
+      status->pools[i] = (ble_buffer_pool_status_t){ .buffer_length = pool_stats.bufSize, .num_buffers = pool_stats.numBuf,
+         .num_allocated = pool_stats.numAlloc, .max_allocated = pool_stats.maxAlloc,
+         .max_request_length = pool_stats.maxReqLen, .num_failed_allocations = pool_stats.numAllocFail };
+   }
+}
+
+void bluetooth_print_buffer_status(void)
+{
+   // Log the usage of each WSF buffer pool over SWO
+   ble_buffer_status_t status;
+   bluetooth_retrieve_buffer_status(&status);
+   for (uint8_t i = 0; i < status.num_pools; ++i)
+      print("TotTag BLE: WSF Pool %u: Length = %u, Buffers = %u, Allocated = %u, Peak = %u, Max Request = %u, Failures = %u\n",
+            (uint32_t)i, (uint32_t)status.pools[i].buffer_length, (uint32_t)status.pools[i].num_buffers, (uint32_t)status.pools[i].num_allocated,
+            (uint32_t)status.pools[i].max_allocated, (uint32_t)status.pools[i].max_request_length, (uint32_t)status.pools[i].num_failed_allocations);
+}
@@ -45,6 +45,7 @@
 #define BBM_EXTERNAL_LUT_NUM_ENTRIES                20
 #define BBM_NUM_RESERVED_BLOCKS                     40
 #define BBM_LUT_BASE_ADDRESS                        ((MEMORY_BLOCK_COUNT - BBM_NUM_RESERVED_BLOCKS) * MEMORY_PAGES_PER_BLOCK)
+#define NUM_DATA_BLOCKS                             (MEMORY_BLOCK_COUNT - BBM_NUM_RESERVED_BLOCKS)
 
 
 // Helper Structures ---------------------------------------------------------------------------------------------------
@@ -56,8 +57,10 @@ typedef struct __attribute__ ((__packed__)) { uint16_t lba, pba; } bbm_lut_t;
 
 static void *spi_handle;
 static bbm_lut_t bad_block_lookup_table_internal[BBM_INTERNAL_LUT_NUM_ENTRIES];
-static uint8_t cache[2 * MEMORY_PAGE_SIZE_BYTES], transfer_buffer[MEMORY_PAGE_SIZE_BYTES];
+static uint8_t cache[(STORAGE_BATCH_NUM_PAGES + 1) * MEMORY_PAGE_SIZE_BYTES], transfer_buffer[MEMORY_PAGE_SIZE_BYTES], page_image[MEMORY_PAGE_SIZE_BYTES];
+static uint32_t dirty_blocks[(NUM_DATA_BLOCKS + 31) / 32], cache_page_timestamps[(sizeof(cache) / MEMORY_NUM_DATA_BYTES_PER_PAGE) + 1];
 static volatile uint32_t starting_page, current_page, reading_page, last_reading_page, cache_index;
+static volatile uint32_t partial_page_num_sectors, partial_page_num_programs;
 static volatile bool is_reading, in_maintenance_mode, disabled;
 
 
@@ -210,7 +213,7 @@ static bool transfer_block(uint32_t source, uint32_t destination, uint32_t num_p
    return true;
 }
 
-static void add_bad_block(uint16_t block_address)
+static bool add_bad_block(uint16_t block_address, uint32_t num_pages_to_transfer)
 {
    // Find first available workaround block
    uint16_t workaround_block = 0;
@@ -227,9 +230,11 @@ static void add_bad_block(uint16_t block_address)
             }
       }
 
-   // Update LUT with the workaround block
+   // Transfer any already-written pages to the workaround block and update the LUT
    if (workaround_block)
    {
+      if (num_pages_to_transfer)
+         transfer_block(block_address & 0x0000FFC0, (uint32_t)workaround_block * MEMORY_PAGES_PER_BLOCK, num_pages_to_transfer);
       block_address = (uint16_t)(((uint32_t)block_address & 0x0000FFC0) >> 6);
       bbm_lut_t destination_address = {
          .lba = ((block_address << 8) & 0xFF00) | ((block_address >> 8) & 0x00FF),
@@ -248,95 +253,264 @@ static void add_bad_block(uint16_t block_address)
             break;
          }
    }
+   return workaround_block != 0;
 }
 
-static void write_page(uint16_t data_length)
+static void erase_block_raw(uint32_t page)
+{
+   // Erase the block containing the specified page and ensure that the command was successful
+   const uint16_t page_number_reordered = (uint16_t)(((page & 0x0000FF00) >> 8) | ((page & 0x000000FF) << 8));
+   wait_until_not_busy();
+   spi_write(COMMAND_WRITE_ENABLE, NULL, 0, NULL, 0);
+   spi_write(COMMAND_BLOCK_ERASE, &page, 1, &page_number_reordered, 2);
+   wait_until_not_busy();
+   if ((read_register(STATUS_REGISTER_3) & STATUS_ERASE_FAILURE) == STATUS_ERASE_FAILURE)
+      add_bad_block(page, 0);
+}
+
+static void erase_block(uint32_t starting_page, uint32_t ending_page)
 {
    // Disable memory page write protection
+   am_hal_gpio_output_set(PIN_STORAGE_WRITE_PROTECT);
+   write_register(STATUS_REGISTER_1, 0b00000010);
+
+   // Iterate through all blocks to be erased
+   ending_page &= 0x0000FFC0;
+   starting_page &= 0x0000FFC0;
+   const uint8_t num_iterations = (starting_page <= ending_page) ? 1 : 2;
+   uint32_t end = (starting_page <= ending_page) ? ending_page : (BBM_LUT_BASE_ADDRESS - 1);
+   for (uint8_t i = 0; i < num_iterations; ++i)
+   {
+      for (uint32_t page = starting_page; page <= end; page += MEMORY_PAGES_PER_BLOCK)
+         erase_block_raw(page);
+      starting_page = 0;
+      end = ending_page;
+   }
+
+   // Re-enable memory page write protection
+   write_register(STATUS_REGISTER_1, 0b01111110);
+   am_hal_gpio_output_clear(PIN_STORAGE_WRITE_PROTECT);
+}
+
+static bool is_block_dirty(uint32_t block)
+{
+   return (dirty_blocks[block / 32] & (1UL << (block % 32))) != 0;
+}
+
+static void set_block_dirty(uint32_t block, bool dirty)
+{
+   if (dirty)
+      dirty_blocks[block / 32] |= (1UL << (block % 32));
+   else
+      dirty_blocks[block / 32] &= ~(1UL << (block % 32));
+}
+
+static void erase_dirty_block(uint32_t page)
+{
+   // Erase the block containing the specified page only if it is dirty and not already blank
+   const uint32_t block = (page % BBM_LUT_BASE_ADDRESS) / MEMORY_PAGES_PER_BLOCK;
+   if (is_block_dirty(block))
+   {
+      if (!read_page(transfer_buffer, block * MEMORY_PAGES_PER_BLOCK) || (transfer_buffer[0] != 0xFF) || (transfer_buffer[1] != 0xFF))
+         erase_block_raw(block * MEMORY_PAGES_PER_BLOCK);
+      set_block_dirty(block, false);
+   }
+}
+
+static void ensure_next_block_erased(void)
+{
+   // Guarantee that the block following the current page is blank so that the end of valid data can always be located
+   const uint32_t next_block_page = ((current_page + MEMORY_PAGES_PER_BLOCK) & 0x0000FFC0) % BBM_LUT_BASE_ADDRESS;
+   if (next_block_page != (starting_page & 0x0000FFC0))
+      erase_dirty_block(next_block_page);
+}
+
+static void erase_ahead(void)
+{
+   // Incrementally erase the first dirty block found within the erase-ahead window of the current page
+   const uint32_t starting_block = starting_page / MEMORY_PAGES_PER_BLOCK;
+   for (uint32_t i = 1, block = current_page / MEMORY_PAGES_PER_BLOCK; i <= STORAGE_ERASE_AHEAD_NUM_BLOCKS; ++i)
+   {
+      block = (block + 1) % NUM_DATA_BLOCKS;
+      if (block == starting_block)
+         break;
+      else if (is_block_dirty(block))
+      {
+         erase_dirty_block(block * MEMORY_PAGES_PER_BLOCK);
+         break;
+      }
+   }
+}
+
+static void enable_writes(void)
+{
+   // Wake the storage SPI peripheral and disable memory page write protection
    if (!in_maintenance_mode)
       am_hal_iom_power_ctrl(spi_handle, AM_HAL_SYSCTRL_WAKE, true);
    am_hal_gpio_output_set(PIN_STORAGE_WRITE_PROTECT);
    write_register(STATUS_REGISTER_1, 0b00000010);
-   const uint32_t original_page = current_page;
+}
 
+static void disable_writes(void)
+{
+   // Re-enable memory page write protection and put the storage SPI peripheral back to sleep
+   write_register(STATUS_REGISTER_1, 0b01111110);
+   am_hal_gpio_output_clear(PIN_STORAGE_WRITE_PROTECT);
+   if (!in_maintenance_mode)
+      am_hal_iom_power_ctrl(spi_handle, AM_HAL_SYSCTRL_DEEPSLEEP, true);
+}
+
+static void write_page(const uint8_t *image, uint32_t first_new_sector)
+{
    // Continue trying to write the current page to memory until successful
    bool success = false;
    while (!success)
    {
-      // Fill up transfer buffer with current page data
+      // Make sure that the following block is blank before writing into the current block
+      ensure_next_block_erased();
+
+      // Fill up transfer buffer with only the newly-written sectors of the current page image
       memset(transfer_buffer, 0xFF, MEMORY_PAGE_SIZE_BYTES);
-      transfer_buffer[0] = 'D';
-      transfer_buffer[1] = 'A';
-      *(uint16_t*)(transfer_buffer+2) = data_length;
-      memcpy(transfer_buffer+4, cache, data_length);
+      memcpy(transfer_buffer + (first_new_sector * MEMORY_SECTOR_SIZE_BYTES), image + (first_new_sector * MEMORY_SECTOR_SIZE_BYTES), MEMORY_PAGE_SIZE_BYTES - (first_new_sector * MEMORY_SECTOR_SIZE_BYTES));
 
       // Add the current block to the list of bad blocks if unable to write or if read-back contains errors
       if (write_page_raw(transfer_buffer, current_page) && read_page(transfer_buffer, current_page))
          success = true;
-      else
+      else if (!add_bad_block(current_page, current_page & 0x003F))
       {
-         // Transfer any already-written pages in the current block to the next block
+         // Transfer any already-written pages in the current block to the next block if no workaround block is available
          uint32_t next_block = ((current_page + MEMORY_PAGES_PER_BLOCK) & 0x0000FFC0) % BBM_LUT_BASE_ADDRESS;
-         transfer_block(original_page & 0x0000FFC0, next_block, current_page & 0x003F);
-         add_bad_block(current_page);
+         transfer_block(current_page & 0x0000FFC0, next_block, current_page & 0x003F);
          current_page = (current_page + MEMORY_PAGES_PER_BLOCK) % BBM_LUT_BASE_ADDRESS;
+         first_new_sector = 0;
       }
+      else
+         first_new_sector = 0;
    }
+}
 
-   // Re-enable memory page write protection
-   write_register(STATUS_REGISTER_1, 0b01111110);
-   am_hal_gpio_output_clear(PIN_STORAGE_WRITE_PROTECT);
-   if (!in_maintenance_mode)
-      am_hal_iom_power_ctrl(spi_handle, AM_HAL_SYSCTRL_DEEPSLEEP, true);
+static void write_full_page(const uint8_t *data)
+{
+   // Write a complete page of data and move on to the next page
+   memset(page_image, 0xFF, MEMORY_PAGE_SIZE_BYTES);
+   page_image[0] = 'D';
+   page_image[1] = 'A';
+   *(uint16_t*)(page_image+2) = MEMORY_NUM_DATA_BYTES_PER_PAGE;
+   memcpy(page_image+4, data, MEMORY_NUM_DATA_BYTES_PER_PAGE);
+   write_page(page_image, 0);
+   current_page = (current_page + 1) % BBM_LUT_BASE_ADDRESS;
 }
 
-static void erase_block(uint32_t starting_page, uint32_t ending_page)
+static uint32_t sector_header_offset(uint32_t sector)
 {
-   // Disable memory page write protection
-   am_hal_gpio_output_set(PIN_STORAGE_WRITE_PROTECT);
-   write_register(STATUS_REGISTER_1, 0b00000010);
+   // Partial pages begin with a "DP" tag, and each sector begins with the number of valid data bytes it contains
+   return sector ? (sector * MEMORY_SECTOR_SIZE_BYTES) : 2;
+}
 
-   // Iterate through all blocks to be erased
-   ending_page &= 0x0000FFC0;
-   starting_page &= 0x0000FFC0;
-   const uint8_t num_iterations = (starting_page <= ending_page) ? 1 : 2;
-   uint32_t end = (starting_page <= ending_page) ? ending_page : (BBM_LUT_BASE_ADDRESS - 1);
-   for (uint8_t i = 0; i < num_iterations; ++i)
+static uint32_t sector_capacity(uint32_t sector)
+{
+   return MEMORY_SECTOR_SIZE_BYTES - (sector ? 2 : 4);
+}
+
+static uint32_t remaining_partial_page_capacity(void)
+{
+   uint32_t capacity = 0;
+   for (uint32_t sector = partial_page_num_sectors; sector < MEMORY_SECTORS_PER_PAGE; ++sector)
+      capacity += sector_capacity(sector);
+   return capacity;
+}
+
+static uint32_t write_partial_page(const uint8_t *data, uint32_t data_length)
+{
+   // Start a new partial page image if nothing has been programmed to the current page yet
+   const uint32_t first_new_sector = partial_page_num_sectors;
+   if (!first_new_sector)
    {
-      for (uint32_t page = starting_page; page <= end; page += MEMORY_PAGES_PER_BLOCK)
+      memset(page_image, 0xFF, MEMORY_PAGE_SIZE_BYTES);
+      page_image[0] = 'D';
+      page_image[1] = 'P';
+   }
+
+   // Fill as many unprogrammed sectors as required to hold the pending data
+   uint32_t bytes_written = 0;
+   while ((partial_page_num_sectors < MEMORY_SECTORS_PER_PAGE) && (bytes_written < data_length))
+   {
+      const uint32_t sector = partial_page_num_sectors++;
+      const uint16_t sector_length = (uint16_t)(((data_length - bytes_written) < sector_capacity(sector)) ? (data_length - bytes_written) : sector_capacity(sector));
+      memcpy(page_image + sector_header_offset(sector), &sector_length, sizeof(sector_length));
+      memcpy(page_image + sector_header_offset(sector) + sizeof(sector_length), data + bytes_written, sector_length);
+      bytes_written += sector_length;
+   }
+
+   // Program only the new sectors and move on to the next page once all sectors or allowable programs have been used
+   write_page(page_image, first_new_sector);
+   if ((partial_page_num_sectors == MEMORY_SECTORS_PER_PAGE) || (++partial_page_num_programs >= MEMORY_MAX_PROGRAMS_PER_PAGE))
+   {
+      partial_page_num_sectors = partial_page_num_programs = 0;
+      current_page = (current_page + 1) % BBM_LUT_BASE_ADDRESS;
+   }
+   return bytes_written;
+}
+
+static bool is_data_page(const uint8_t *buffer)
+{
+   return (buffer[0] == 'D') && ((buffer[1] == 'A') || (buffer[1] == 'P'));
+}
+
+static bool read_data_page(uint8_t *buffer, uint32_t page_number)
+{
+   // Read the requested page and ensure that it contains valid data
+   if (!read_page(buffer, page_number) || !is_data_page(buffer))
+      return false;
+
+   // Compact the valid data from all programmed sectors of a partial page into the standard page layout
+   if (buffer[1] == 'P')
+   {
+      uint16_t num_bytes = 0, sector_length;
+      for (uint32_t sector = 0; sector < MEMORY_SECTORS_PER_PAGE; ++sector)
       {
-         // Erase the current page and ensure that the command was successful
-         const uint16_t page_number_reordered = (uint16_t)(((page & 0x0000FF00) >> 8) | ((page & 0x000000FF) << 8));
-         wait_until_not_busy();
-         spi_write(COMMAND_WRITE_ENABLE, NULL, 0, NULL, 0);
-         spi_write(COMMAND_BLOCK_ERASE, &page, 1, &page_number_reordered, 2);
-         wait_until_not_busy();
-         if ((read_register(STATUS_REGISTER_3) & STATUS_ERASE_FAILURE) == STATUS_ERASE_FAILURE)
-            add_bad_block(page);
+         memcpy(&sector_length, buffer + sector_header_offset(sector), sizeof(sector_length));
+         if (sector_length > sector_capacity(sector))
+            break;
+         memmove(buffer + 4 + num_bytes, buffer + sector_header_offset(sector) + sizeof(sector_length), sector_length);
+         num_bytes += sector_length;
       }
-      starting_page = 0;
-      end = ending_page;
+      buffer[1] = 'A';
+      memcpy(buffer + 2, &num_bytes, sizeof(num_bytes));
    }
-
-   // Re-enable memory page write protection
-   write_register(STATUS_REGISTER_1, 0b01111110);
-   am_hal_gpio_output_clear(PIN_STORAGE_WRITE_PROTECT);
+   return true;
 }
 
-static void ensure_empty_memory(void)
+static void commit_cache(bool write_partial_pages)
 {
-   // Ensure that all memory blocks have been successfully erased
-   bool current_block_erased = false;
-   const uint32_t current_block = current_page & 0x0000FFC0;
-   for (uint32_t block = 0; block < (MEMORY_BLOCK_COUNT - BBM_NUM_RESERVED_BLOCKS); ++block)
-      if (!read_page(transfer_buffer, block * MEMORY_PAGES_PER_BLOCK) || (transfer_buffer[0] != 0xFF) || (transfer_buffer[1] != 0xFF))
+   // Write all cached data to memory within a single wake cycle, completing any partially-programmed page first
+   uint32_t cache_offset = 0;
+   enable_writes();
+   while ((cache_offset < cache_index) && (starting_page != current_page))
+   {
+      const uint32_t num_pending_bytes = cache_index - cache_offset;
+      if (partial_page_num_sectors && (write_partial_pages || (num_pending_bytes >= remaining_partial_page_capacity())))
+         cache_offset += write_partial_page(cache + cache_offset, num_pending_bytes);
+      else if (!partial_page_num_sectors && (num_pending_bytes >= MEMORY_NUM_DATA_BYTES_PER_PAGE))
       {
-         erase_block(block * MEMORY_PAGES_PER_BLOCK, block * MEMORY_PAGES_PER_BLOCK);
-         if ((block * MEMORY_PAGES_PER_BLOCK) == current_block)
-            current_block_erased = true;
+         write_full_page(cache + cache_offset);
+         cache_offset += MEMORY_NUM_DATA_BYTES_PER_PAGE;
       }
-   if (!current_block_erased)
-      erase_block(current_page, current_page);
+      else if (write_partial_pages)
+         cache_offset += write_partial_page(cache + cache_offset, num_pending_bytes);
+      else
+         break;
+   }
+
+   // Remove all committed data from the cache, keeping the storage times of the page-sized spans that remain
+   const uint32_t committed_page_spans = cache_offset / MEMORY_NUM_DATA_BYTES_PER_PAGE;
+   cache_index -= cache_offset;
+   memmove(cache, cache + cache_offset, cache_index);
+   memmove(cache_page_timestamps, cache_page_timestamps + committed_page_spans, sizeof(cache_page_timestamps) - (committed_page_spans * sizeof(cache_page_timestamps[0])));
+
+   // Incrementally erase stale blocks ahead of the current page while the peripheral is awake
+   erase_ahead();
+   disable_writes();
 }
 
 static bool is_first_boot(void)
@@ -425,13 +599,13 @@ void storage_init(void)
       write_register(STATUS_REGISTER_1, 0b00000010);
       for (uint32_t page = 0; page < BBM_LUT_BASE_ADDRESS; page += MEMORY_PAGES_PER_BLOCK)
          if (!read_page(transfer_buffer, page) || (transfer_buffer[0] != 0xFF))
-            add_bad_block(page);
+            add_bad_block(page, 0);
       write_register(STATUS_REGISTER_1, 0b01111110);
    }
 
    // Search for the starting page
    int32_t start_page = -1;
-   cache_index = last_reading_page = 0;
+   cache_index = last_reading_page = partial_page_num_sectors = partial_page_num_programs = 0;
    memset(cache, 0, sizeof(cache));
    for (uint32_t page = 0; page < BBM_LUT_BASE_ADDRESS; page += MEMORY_PAGES_PER_BLOCK)
       if (read_page(transfer_buffer, page) && (memcmp(transfer_buffer, "META", 4) == 0))
@@ -441,23 +615,22 @@ void storage_init(void)
          break;
       }
 
+   // Assume that all blocks may contain stale data until proven otherwise
+   memset(dirty_blocks, 0xFF, sizeof(dirty_blocks));
+
    // Search for the current page if a starting page was found
    if (start_page >= 0)
    {
-      // Check if the data wraps around memory
+      // Search forward for the last page containing valid data, wrapping around memory if necessary
       starting_page = (uint32_t)start_page;
-      if (read_page(transfer_buffer, 0) && (memcmp(transfer_buffer, "DA", 2) == 0))
-         current_page = 0;
-
-      // Search for the last page containing valid data
       bool curr_page_found = false;
       for ( ; !curr_page_found && (current_page != starting_page); current_page = (current_page + MEMORY_PAGES_PER_BLOCK) % BBM_LUT_BASE_ADDRESS)
-         if (!read_page(transfer_buffer, current_page) || memcmp(transfer_buffer, "DA", 2))
+         if (!read_page(transfer_buffer, current_page) || !is_data_page(transfer_buffer))
          {
             curr_page_found = true;
             current_page = (current_page ? current_page : BBM_LUT_BASE_ADDRESS) - MEMORY_PAGES_PER_BLOCK;
             for (uint32_t i = 0; i < MEMORY_PAGES_PER_BLOCK; ++i)
-               if (read_page(transfer_buffer, current_page + i) && ((memcmp(transfer_buffer, "META", 4) == 0) || (memcmp(transfer_buffer, "DA", 2) == 0)))
+               if (read_page(transfer_buffer, current_page + i) && ((memcmp(transfer_buffer, "META", 4) == 0) || is_data_page(transfer_buffer)))
                   continue;
                else
                {
@@ -465,14 +638,24 @@ void storage_init(void)
                   break;
                }
          }
+
+      // Mark all blocks containing valid experiment data as clean
+      for (uint32_t i = 0, block = starting_page / MEMORY_PAGES_PER_BLOCK; i < NUM_DATA_BLOCKS; ++i, block = (block + 1) % NUM_DATA_BLOCKS)
+      {
+         set_block_dirty(block, false);
+         if ((block == (current_page / MEMORY_PAGES_PER_BLOCK)) && (starting_page != current_page))
+            break;
+      }
    }
    else
    {
       current_page = 1;
       starting_page = 0;
+      write_register(STATUS_REGISTER_1, 0b00000010);
+      erase_dirty_block(starting_page);
+      erase_dirty_block(starting_page + MEMORY_PAGES_PER_BLOCK);
       memset(transfer_buffer, 0, sizeof(transfer_buffer));
       memcpy(transfer_buffer, "META", 4);
-      write_register(STATUS_REGISTER_1, 0b00000010);
       write_page_raw(transfer_buffer, starting_page);
       write_register(STATUS_REGISTER_1, 0b01111110);
    }
@@ -502,11 +685,12 @@ void storage_store_experiment_details(const experiment_details_t *details)
    // Only store new details in maintenance mode
    if (in_maintenance_mode)
    {
-      // Erase all existing used pages and update storage metadata
-      ensure_empty_memory();
+      // Update storage metadata and mark all existing blocks for background erasure
+      const uint32_t previous_starting_page = starting_page;
+      memset(dirty_blocks, 0xFF, sizeof(dirty_blocks));
       starting_page = ((current_page + MEMORY_PAGES_PER_BLOCK) % BBM_LUT_BASE_ADDRESS) & 0x0000FFC0;
       current_page = (starting_page + 1) % BBM_LUT_BASE_ADDRESS;
-      cache_index = 0;
+      cache_index = partial_page_num_sectors = partial_page_num_programs = 0;
 
       // Write experiment details to storage
       bool success = false;
@@ -516,6 +700,11 @@ void storage_store_experiment_details(const experiment_details_t *details)
          am_hal_gpio_output_set(PIN_STORAGE_WRITE_PROTECT);
          write_register(STATUS_REGISTER_1, 0b00000010);
 
+         // Erase the previous metadata block, the new starting block, and the block that follows it
+         erase_dirty_block(previous_starting_page);
+         erase_dirty_block(starting_page);
+         erase_dirty_block(starting_page + MEMORY_PAGES_PER_BLOCK);
+
          // Perform the write
          memset(transfer_buffer, 0, sizeof(transfer_buffer));
          memcpy(transfer_buffer, "META", 4);
@@ -530,7 +719,7 @@ void storage_store_experiment_details(const experiment_details_t *details)
          if (!success)
          {
             erase_block(starting_page, starting_page);
-            add_bad_block(starting_page);
+            add_bad_block(starting_page, 0);
             starting_page = (starting_page + MEMORY_PAGES_PER_BLOCK) % BBM_LUT_BASE_ADDRESS;
             current_page = (starting_page + 1) % BBM_LUT_BASE_ADDRESS;
          }
@@ -552,9 +741,14 @@ void storage_store_experiment_details(const experiment_details_t *details)
 
 void storage_store(const void *data, uint32_t data_length)
 {
-   // Add new data to in-memory cache if not disabled
-   if (!disabled)
+   // Add new data to in-memory cache if not disabled and if space remains, keeping at most one page once memory is full
+   const uint32_t cache_capacity = (starting_page == current_page) ? MEMORY_NUM_DATA_BYTES_PER_PAGE : sizeof(cache);
+   if (!disabled && ((cache_index + data_length) <= cache_capacity))
    {
+      // Record when data first entered each page-sized span of the cache to bound the age of whatever a commit leaves behind
+      const uint32_t timestamp = rtc_get_timestamp();
+      for (uint32_t span = (cache_index + MEMORY_NUM_DATA_BYTES_PER_PAGE - 1) / MEMORY_NUM_DATA_BYTES_PER_PAGE; (span * MEMORY_NUM_DATA_BYTES_PER_PAGE) < (cache_index + data_length); ++span)
+         cache_page_timestamps[span] = timestamp;
       memcpy(cache + cache_index, data, data_length);
       cache_index += data_length;
    }
@@ -566,18 +760,11 @@ void storage_flush(bool write_partial_pages)
    if (disabled || is_reading || (starting_page == current_page))
       return;
 
-   // Flush a full page of data to memory and update the storage metadata
-   if (cache_index >= MEMORY_NUM_DATA_BYTES_PER_PAGE)
-   {
-      write_page(MEMORY_NUM_DATA_BYTES_PER_PAGE);
-      cache_index -= MEMORY_NUM_DATA_BYTES_PER_PAGE;
-      current_page = (current_page + 1) % BBM_LUT_BASE_ADDRESS;
-      memmove(cache, cache + MEMORY_NUM_DATA_BYTES_PER_PAGE, cache_index);
-   }
-
-   // Write a partial page of data if requested
-   if (write_partial_pages && cache_index)
-      write_page((uint16_t)cache_index);
+   // Only commit data once a full batch of pages is available, the oldest cached data exceeds the maximum latency, or if forced
+   if (cache_index && ((rtc_get_timestamp() - cache_page_timestamps[0]) >= STORAGE_BATCH_MAX_LATENCY_S))
+      commit_cache(true);
+   else if ((write_partial_pages && cache_index) || ((cache_index / MEMORY_NUM_DATA_BYTES_PER_PAGE) >= STORAGE_BATCH_NUM_PAGES))
+      commit_cache(write_partial_pages);
 }
 
 void storage_retrieve_experiment_details(experiment_details_t *details)
@@ -595,6 +782,10 @@ void storage_retrieve_experiment_details(experiment_details_t *details)
 
 void storage_begin_reading(uint32_t starting_timestamp)
 {
+   // Commit any pending full pages so that the cache and current partial page together contain at most one page of data
+   if (!disabled && !is_reading && cache_index && (starting_page != current_page))
+      commit_cache(false);
+
    // Update the data reading details
    experiment_details_t details;
    storage_retrieve_experiment_details(&details);
@@ -606,12 +797,12 @@ void storage_begin_reading(uint32_t starting_timestamp)
    // Search for the page that contains the starting timestamp
    bool timestamp_found = !starting_timestamp;
    while (!timestamp_found && (reading_page != current_page))
-      if (read_page(transfer_buffer, reading_page))
+      if (read_data_page(transfer_buffer, reading_page))
       {
          bool found_valid_timestamp = false;
          uint32_t num_bytes_retrieved = *(uint16_t*)(transfer_buffer+2);
          for (uint32_t i = 0; !timestamp_found && ((i + 5) < num_bytes_retrieved); ++i)
-            if ((transfer_buffer[4 + i] == STORAGE_TYPE_RANGES) && (transfer_buffer[9 + i] < MAX_NUM_RANGING_DEVICES) && ((*(uint32_t*)(transfer_buffer + 5 + i) % 500) == 0))
+            if (((transfer_buffer[4 + i] == STORAGE_TYPE_RANGES) || (transfer_buffer[4 + i] == STORAGE_TYPE_RANGE_SUMMARY)) && (transfer_buffer[9 + i] < MAX_NUM_RANGING_DEVICES) && ((*(uint32_t*)(transfer_buffer + 5 + i) % 500) == 0))
             {
                found_valid_timestamp = true;
                if (*(uint32_t*)(transfer_buffer + 5 + i) > starting_timestamp)
@@ -670,12 +861,12 @@ uint32_t storage_retrieve_num_data_chunks(uint32_t ending_timestamp)
       last_reading_page = reading_page;
       uint32_t previous_reading_page = last_reading_page;
       while (!timestamp_found && (last_reading_page != current_page))
-         if (read_page(transfer_buffer, last_reading_page))
+         if (read_data_page(transfer_buffer, last_reading_page))
          {
             bool found_valid_timestamp = false;
             uint32_t num_bytes_retrieved = *(uint16_t*)(transfer_buffer+2);
             for (uint32_t i = 0; !timestamp_found && ((i + 5) < num_bytes_retrieved); ++i)
-               if ((transfer_buffer[4 + i] == STORAGE_TYPE_RANGES) && (transfer_buffer[9 + i] < MAX_NUM_RANGING_DEVICES) && ((*(uint32_t*)(transfer_buffer + 5 + i) % 500) == 0))
+               if (((transfer_buffer[4 + i] == STORAGE_TYPE_RANGES) || (transfer_buffer[4 + i] == STORAGE_TYPE_RANGE_SUMMARY)) && (transfer_buffer[9 + i] < MAX_NUM_RANGING_DEVICES) && ((*(uint32_t*)(transfer_buffer + 5 + i) % 500) == 0))
                {
                   found_valid_timestamp = true;
                   if (*(uint32_t*)(transfer_buffer + 5 + i) > ending_timestamp)
@@ -711,11 +902,17 @@ uint32_t storage_retrieve_next_data_chunk(uint8_t *buffer)
    {
       if (reading_page == current_page)
       {
-         // Return the valid available bytes
-         memcpy(buffer, cache, cache_index);
-         num_bytes_retrieved = cache_index;
+         // Return the valid bytes from any programmed sectors of the current page followed by the cached bytes
+         if (partial_page_num_sectors && read_data_page(buffer, reading_page))
+         {
+            num_bytes_retrieved = *(uint16_t*)(buffer+2);
+            memmove(buffer, buffer + 4, num_bytes_retrieved);
+         }
+         const uint32_t num_cached_bytes = ((num_bytes_retrieved + cache_index) <= MEMORY_NUM_DATA_BYTES_PER_PAGE) ? cache_index : (MEMORY_NUM_DATA_BYTES_PER_PAGE - num_bytes_retrieved);
+         memcpy(buffer + num_bytes_retrieved, cache, num_cached_bytes);
+         num_bytes_retrieved += num_cached_bytes;
       }
-      else if (read_page(buffer, reading_page))
+      else if (read_data_page(buffer, reading_page))
       {
          num_bytes_retrieved = *(uint16_t*)(buffer+2);
          memmove(buffer, buffer + 4, num_bytes_retrieved);
@@ -725,7 +922,7 @@ uint32_t storage_retrieve_next_data_chunk(uint8_t *buffer)
    else
    {
       // Read the next page of memory and update the reading metadata
-      if (read_page(buffer, reading_page))
+      if (read_data_page(buffer, reading_page))
       {
          num_bytes_retrieved = *(uint16_t*)(buffer+2);
          memmove(buffer, buffer + 4, num_bytes_retrieved);
@@ -735,6 +932,25 @@ uint32_t storage_retrieve_next_data_chunk(uint8_t *buffer)
    return num_bytes_retrieved;
 }
 
+void storage_skip_data_chunks(uint32_t num_chunks)
+{
+   // Advance the reading page without retrieving any data, stopping at the final page to be read
+   for ( ; is_reading && num_chunks && (reading_page != last_reading_page); --num_chunks)
+      reading_page = (reading_page + 1) % BBM_LUT_BASE_ADDRESS;
+}
+
+uint32_t storage_retrieve_capacity_bytes(void)
+{
+   return (BBM_LUT_BASE_ADDRESS - 1) * MEMORY_NUM_DATA_BYTES_PER_PAGE;
+}
+
+uint32_t storage_retrieve_num_free_bytes(void)
+{
+   // Determine the number of data bytes remaining before the write pointer wraps back around to the starting page
+   const uint32_t num_free_bytes = ((starting_page + BBM_LUT_BASE_ADDRESS - current_page) % BBM_LUT_BASE_ADDRESS) * MEMORY_NUM_DATA_BYTES_PER_PAGE;
+   return (num_free_bytes > cache_index) ? (num_free_bytes - cache_index) : 0;
+}
+
 #else
 
 void storage_init(void) {}
@@ -750,5 +966,8 @@ void storage_enter_maintenance_mode(void){}
 void storage_exit_maintenance_mode(void) {}
 uint32_t storage_retrieve_data_length(void) { return 0; }
 uint32_t storage_retrieve_next_data_chunk(uint8_t *buffer) { return 0; }
+void storage_skip_data_chunks(uint32_t num_chunks) {}
+uint32_t storage_retrieve_capacity_bytes(void) { return 0; }
+uint32_t storage_retrieve_num_free_bytes(void) { return 0; }
 
 #endif  // #if REVISION_ID != REVISION_APOLLO4_EVB && !defined(_TEST_BLE_RANGING_TASK)
@@ -28,6 +28,19 @@ typedef struct __attribute__ ((__packed__))
    char uid_name_mappings[MAX_NUM_RANGING_DEVICES][EUI_NAME_MAX_LEN];
 } experiment_details_t;
 
+typedef enum {
+   STORAGE_TIER_FULL_RESOLUTION = 0,
+   STORAGE_TIER_RANGE_SUMMARIES,
+   STORAGE_TIER_MOTION_ONLY,
+   STORAGE_TIER_VOLTAGE_ONLY
+} storage_tier_t;
+
+typedef struct __attribute__ ((__packed__))
+{
+   uint8_t tier, percent_full;
+   uint32_t seconds_until_full;
+} storage_capacity_status_t;
+
 
 // Public API Functions ------------------------------------------------------------------------------------------------
 
@@ -46,6 +59,7 @@ void storage_flush_and_shutdown(void);
 void storage_write_battery_level(uint32_t battery_voltage_mV);
 void storage_write_motion_status(bool in_motion);
 void storage_write_ranging_data(uint32_t timestamp, const uint8_t *ranging_data, uint32_t ranging_data_len, int32_t timestamp_offset);
+void storage_retrieve_capacity_status(storage_capacity_status_t *status);
 
 // Main Task Functions
 void AppTaskRanging(void *uid);
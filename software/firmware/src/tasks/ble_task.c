@@ -16,7 +16,8 @@
 // Static Global Variables ---------------------------------------------------------------------------------------------
 
 #define WSF_BUF_POOLS 5
-static uint32_t g_pui32BufMem[(WSF_BUF_POOLS*16 + 16*8 + 32*4 + 64*6 + 280*14 + 424*8) / sizeof(uint32_t)];
+#define WSF_BUF_POOL_OVERHEAD 20    // Size of each internal pool descriptor with WSF_BUF_STATS enabled
+static uint32_t g_pui32BufMem[(WSF_BUF_POOLS*WSF_BUF_POOL_OVERHEAD + 16*8 + 32*4 + 64*6 + 280*14 + 424*8) / sizeof(uint32_t)];
 static wsfBufPoolDesc_t g_psPoolDescriptors[WSF_BUF_POOLS];
 
 
@@ -10,6 +10,33 @@
 #include "system.h"
 
 
+// Static Global Variables ---------------------------------------------------------------------------------------------
+
+static uint8_t range_batch[DM_CONN_MAX][MAX_RANGE_BATCH_DATA_LENGTH];
+static uint16_t range_batch_length[DM_CONN_MAX];
+static uint8_t range_batch_num_rounds[DM_CONN_MAX];
+static uint32_t range_batch_start_ticks[DM_CONN_MAX];
+static volatile uint8_t requested_batch_num_rounds[DM_CONN_MAX];
+
+
+// Private Helper Functions --------------------------------------------------------------------------------------------
+
+static uint32_t range_batch_age_ms(uint8_t index)
+{
+   return (uint32_t)((xTaskGetTickCount() - range_batch_start_ticks[index]) * portTICK_PERIOD_MS);
+}
+
+static void send_range_batch(dmConnId_t connId)
+{
+   // Stamp the batch with the age of its first round so that the client can date every round, then notify all rounds at once
+   const uint32_t age_ms = range_batch_age_ms(connId - 1);
+   const uint16_t first_round_age_ms = (age_ms > 0xFFFF) ? 0xFFFF : (uint16_t)age_ms;
+   memcpy(range_batch[connId - 1] + 1 + sizeof(uint16_t), &first_round_age_ms, sizeof(first_round_age_ms));
+   AttsHandleValueNtf(connId, RANGES_HANDLE, range_batch_length[connId - 1], range_batch[connId - 1]);
+   range_batch_length[connId - 1] = 0;
+}
+
+
 // Public API ----------------------------------------------------------------------------------------------------------
 
 uint8_t handleLiveStatsRead(dmConnId_t connId, uint16_t handle, uint8_t operation, uint16_t offset, attsAttr_t *pAttr)
@@ -19,6 +46,8 @@ uint8_t handleLiveStatsRead(dmConnId_t connId, uint16_t handle, uint8_t operatio
       *(uint16_t*)pAttr->pValue = (uint16_t)battery_monitor_get_level_mV();
    else if (handle == TIMESTAMP_HANDLE)
       *(uint32_t*)pAttr->pValue = rtc_get_timestamp();
+   else if (handle == STORAGE_STATUS_HANDLE)
+      storage_retrieve_capacity_status((storage_capacity_status_t*)pAttr->pValue);
    return ATT_SUCCESS;
 }
 
@@ -32,9 +61,63 @@ uint8_t handleLiveStatsWrite(dmConnId_t connId, uint16_t handle, uint8_t operati
    return ATT_SUCCESS;
 }
 
-void updateRangeResults(dmConnId_t connId, const uint8_t *results, uint16_t results_length)
+void setRangeResultsBatchSize(dmConnId_t connId, uint8_t num_rounds)
 {
-   // Update the BLE ranges characteristic
-   if (connId != DM_CONN_ID_NONE)
+   // The ranging task picks up the new batch size with its next set of results
+   if ((connId != DM_CONN_ID_NONE) && (connId <= DM_CONN_MAX))
+      requested_batch_num_rounds[connId - 1] = (num_rounds < 1) ? 1 : ((num_rounds > MAX_RANGE_BATCH_NUM_ROUNDS) ? MAX_RANGE_BATCH_NUM_ROUNDS : num_rounds);
+}
+
+void updateRangeResults(dmConnId_t connId, uint16_t round_sequence, const uint8_t *results, uint16_t results_length)
+{
+   // Discard any partially filled batch whenever the client changes the batch size
+   if ((connId == DM_CONN_ID_NONE) || (connId > DM_CONN_MAX))
+      return;
+   const uint8_t index = connId - 1;
+   if (range_batch_num_rounds[index] != requested_batch_num_rounds[index])
+   {
+      range_batch_num_rounds[index] = requested_batch_num_rounds[index];
+      range_batch_length[index] = 0;
+   }
+
+   // Update the BLE ranges characteristic every round unless batching was requested
+   if (range_batch_num_rounds[index] <= 1)
+   {
       AttsHandleValueNtf(connId, RANGES_HANDLE, results_length, (uint8_t*)results);
+      return;
+   }
+
+   // Send the pending batch early if this round would not fit into the same notification or its first round is overdue
+   uint8_t *batch = range_batch[index];
+   const uint16_t mtu_length = AttGetMtu(connId) - ATT_VALUE_NTF_LEN;
+   const uint16_t max_batch_length = (mtu_length < sizeof(range_batch[index])) ? mtu_length : sizeof(range_batch[index]);
+   if (range_batch_length[index] && ((range_batch_length[index] + RANGE_BATCH_ROUND_HEADER_LENGTH + results_length) > max_batch_length))
+      send_range_batch(connId);
+   flushRangeResults(connId, false);
+
+   // Append these results behind their offset from the first round and notify the client once the batch holds the requested number of rounds
+   if (!range_batch_length[index])
+   {
+      batch[0] = RANGE_BATCH_FLAG;
+      memcpy(batch + 1, &round_sequence, sizeof(round_sequence));
+      range_batch_length[index] = RANGE_BATCH_HEADER_LENGTH;
+      range_batch_start_ticks[index] = xTaskGetTickCount();
+   }
+   const uint32_t offset_ms = range_batch_age_ms(index);
+   const uint16_t round_offset_ms = (offset_ms > 0xFFFF) ? 0xFFFF : (uint16_t)offset_ms;
+   memcpy(batch + range_batch_length[index], &round_offset_ms, sizeof(round_offset_ms));
+   memcpy(batch + range_batch_length[index] + RANGE_BATCH_ROUND_HEADER_LENGTH, results, results_length);
+   range_batch_length[index] += RANGE_BATCH_ROUND_HEADER_LENGTH + results_length;
+   if ((++batch[0] & ~RANGE_BATCH_FLAG) >= range_batch_num_rounds[index])
+      send_range_batch(connId);
+}
+
+void flushRangeResults(dmConnId_t connId, bool force)
+{
+   // Send a partial batch once its first round is older than a full batch would take to collect, or whenever forced
+   if ((connId == DM_CONN_ID_NONE) || (connId > DM_CONN_MAX))
+      return;
+   const uint8_t index = connId - 1;
+   if (range_batch_length[index] && (force || (range_batch_age_ms(index) >= ((uint32_t)range_batch_num_rounds[index] * (SCHEDULING_INTERVAL_US / 1000)))))
+      send_range_batch(connId);
 }
@@ -5,6 +5,8 @@
 
 uint8_t handleLiveStatsRead(dmConnId_t connId, uint16_t handle, uint8_t operation, uint16_t offset, attsAttr_t *pAttr);
 uint8_t handleLiveStatsWrite(dmConnId_t connId, uint16_t handle, uint8_t operation, uint16_t offset, uint16_t len, uint8_t *pValue, attsAttr_t *pAttr);
-void updateRangeResults(dmConnId_t connId, const uint8_t *results, uint16_t results_length);
+void setRangeResultsBatchSize(dmConnId_t connId, uint8_t num_rounds);
+void updateRangeResults(dmConnId_t connId, uint16_t round_sequence, const uint8_t *results, uint16_t results_length);
+void flushRangeResults(dmConnId_t connId, bool force);
 
 #endif  // #ifndef __LIVE_STATS_FUNCTIONALITY_HEADER_H__
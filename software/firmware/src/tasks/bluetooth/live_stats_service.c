@@ -1,6 +1,7 @@
 // Header Inclusions ---------------------------------------------------------------------------------------------------
 
 #include "app_config.h"
+#include "app_tasks.h"
 #include "wsf_types.h"
 #include "att_api.h"
 #include "live_stats_service.h"
@@ -41,6 +42,13 @@ static const uint8_t rangesDesc[] = "LiveRangingResults";
 static const uint16_t rangesDescLen = sizeof(rangesDesc);
 static uint8_t rangesCcc[] = { UINT16_TO_BYTES(0x0000) };
 static const uint16_t rangesCccLen = sizeof(rangesCcc);
+static const uint8_t storageStatusChUuid[] = { BLE_LIVE_STATS_STORAGE_CHAR };
+static const uint8_t storageStatusChar[] = { ATT_PROP_READ, UINT16_TO_BYTES(STORAGE_STATUS_HANDLE), BLE_LIVE_STATS_STORAGE_CHAR };
+static const uint16_t storageStatusCharLen = sizeof(storageStatusChar);
+static storage_capacity_status_t storageStatus = { 0 };
+static const uint16_t storageStatusLen = sizeof(storageStatus);
+static const uint8_t storageStatusDesc[] = "StorageCapacityStatus";
+static const uint16_t storageStatusDescLen = sizeof(storageStatusDesc);
 
 static const attsAttr_t liveStatsList[] =
 {
@@ -155,6 +163,30 @@ static const attsAttr_t liveStatsList[] =
       sizeof(rangesCcc),
       ATTS_SET_CCC,
       (ATTS_PERMIT_READ | ATTS_PERMIT_WRITE)
+   },
+   {
+      attChUuid,
+      (uint8_t*)storageStatusChar,
+      (uint16_t*)&storageStatusCharLen,
+      sizeof(storageStatusChar),
+      0,
+      ATTS_PERMIT_READ
+   },
+   {
+      storageStatusChUuid,
+      (uint8_t*)&storageStatus,
+      (uint16_t*)&storageStatusLen,
+      sizeof(storageStatus),
+      (ATTS_SET_UUID_128 | ATTS_SET_READ_CBACK),
+      ATTS_PERMIT_READ
+   },
+   {
+      attChUserDescUuid,
+      (uint8_t*)storageStatusDesc,
+      (uint16_t*)&storageStatusDescLen,
+      sizeof(storageStatusDesc),
+      0,
+      ATTS_PERMIT_READ
    }
 };
 
@@ -19,6 +19,9 @@ enum
    RANGES_HANDLE,                           // Current ranges
    RANGES_DESC_HANDLE,                      // Current ranges description
    RANGES_CCC_HANDLE,                       // Current ranges CCCD
+   STORAGE_STATUS_CHAR_HANDLE,              // Storage capacity status characteristic
+   STORAGE_STATUS_HANDLE,                   // Storage capacity status
+   STORAGE_STATUS_DESC_HANDLE,              // Storage capacity status description
    LIVE_STATS_MAX_HANDLE                    // Maximum live statistics handle
 };
 
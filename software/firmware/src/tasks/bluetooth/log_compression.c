@@ -0,0 +1,79 @@
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <string.h>
+#include "log_compression.h"
+
+
+// Private Helper Functions --------------------------------------------------------------------------------------------
+
+static inline uint8_t residual(const uint8_t *input, uint32_t index, uint32_t stride, bool second_order)
+{
+   // Predict each byte from the byte one stride earlier, optionally extrapolating the trend from two strides earlier
+   const uint8_t previous = (index >= stride) ? input[index - stride] : 0;
+   if (!second_order)
+      return (uint8_t)(input[index] - previous);
+   const uint8_t before_previous = (index >= (2 * stride)) ? input[index - (2 * stride)] : 0;
+   return (uint8_t)(input[index] - (2 * previous) + before_previous);
+}
+
+static uint32_t count_nonzero_residuals(const uint8_t *input, uint32_t input_length, uint32_t stride, bool second_order, uint32_t limit)
+{
+   // Count the residuals that will need to be transmitted, stopping early once the current best is exceeded
+   uint32_t num_nonzero = 0;
+   for (uint32_t i = 0; (i < input_length) && (num_nonzero < limit); ++i)
+      num_nonzero += (residual(input, i, stride, second_order) != 0);
+   return num_nonzero;
+}
+
+
+// Public API ----------------------------------------------------------------------------------------------------------
+
+uint32_t log_compression_encode(const uint8_t *input, uint32_t input_length, uint8_t *output)
+{
+   // Search for the record stride and predictor order that leave the fewest nonzero residuals
+   uint32_t best_stride = 1, best_num_nonzero = input_length;
+   bool best_second_order = false;
+   for (uint32_t order = 0; order < 2; ++order)
+      for (uint32_t stride = 1; stride <= LOG_COMPRESSION_MAX_STRIDE; ++stride)
+      {
+         const uint32_t num_nonzero = count_nonzero_residuals(input, input_length, stride, order, best_num_nonzero);
+         if (num_nonzero < best_num_nonzero)
+         {
+            best_num_nonzero = num_nonzero;
+            best_stride = stride;
+            best_second_order = order;
+         }
+      }
+
+   // Encode the residuals as groups of eight, each preceded by a bitmap of the nonzero residuals that follow
+   const uint32_t encoded_length = LOG_COMPRESSION_HEADER_LENGTH + ((input_length + 7) / 8) + best_num_nonzero;
+   if (encoded_length <= input_length)
+   {
+      const uint16_t original_length = (uint16_t)input_length;
+      uint32_t output_index = 0;
+      output[output_index++] = LOG_ENCODING_DELTA;
+      output[output_index++] = (uint8_t)best_stride | (best_second_order ? LOG_COMPRESSION_SECOND_ORDER_FLAG : 0);
+      memcpy(output + output_index, &original_length, sizeof(original_length));
+      output_index += sizeof(original_length);
+      for (uint32_t i = 0; i < input_length; i += 8)
+      {
+         const uint32_t bitmap_index = output_index++;
+         output[bitmap_index] = 0;
+         for (uint32_t bit = 0; (bit < 8) && ((i + bit) < input_length); ++bit)
+         {
+            const uint8_t value = residual(input, i + bit, best_stride, best_second_order);
+            if (value)
+            {
+               output[bitmap_index] |= (1 << bit);
+               output[output_index++] = value;
+            }
+         }
+      }
+      return output_index;
+   }
+
+   // Fall back to sending the data verbatim if it does not compress
+   output[0] = LOG_ENCODING_RAW;
+   memcpy(output + 1, input, input_length);
+   return input_length + LOG_COMPRESSION_MAX_OVERHEAD_BYTES;
+}
@@ -0,0 +1,25 @@
+#ifndef __LOG_COMPRESSION_HEADER_H__
+#define __LOG_COMPRESSION_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Log Compression Definitions -----------------------------------------------------------------------------------------
+
+#define LOG_ENCODING_RAW                                0x00
+#define LOG_ENCODING_DELTA                              0x01
+
+#define LOG_COMPRESSION_HEADER_LENGTH                   4           // Encoding + Stride + Original Length
+#define LOG_COMPRESSION_MAX_STRIDE                      32
+#define LOG_COMPRESSION_SECOND_ORDER_FLAG               0x80
+#define LOG_COMPRESSION_MAX_OVERHEAD_BYTES              1
+
+
+// Public API ----------------------------------------------------------------------------------------------------------
+
+uint32_t log_compression_encode(const uint8_t *input, uint32_t input_length, uint8_t *output);
+
+#endif  // #ifndef __LOG_COMPRESSION_HEADER_H__
@@ -3,6 +3,9 @@
 #include "app_config.h"
 #include "wsf_types.h"
 #include "att_main.h"
+#include "bluetooth.h"
+#include "live_stats_functionality.h"
+#include "log_compression.h"
 #include "logging.h"
 #include "maintenance_functionality.h"
 #include "maintenance_service.h"
@@ -11,7 +14,210 @@
 
 // Static Global Variables ---------------------------------------------------------------------------------------------
 
-static uint32_t download_start_timestamp = 0, download_end_timestamp = 0;
+static uint32_t download_start_timestamp = 0, download_end_timestamp = 0, download_start_ticks = 0, download_num_bytes = 0;
+static uint8_t stream_packets[BLE_DOWNLOAD_WINDOW_NUM_PACKETS][BLE_DESIRED_MTU - 3], stream_buffer[2 * MEMORY_PAGE_SIZE_BYTES], stream_chunk[MEMORY_PAGE_SIZE_BYTES];
+static uint16_t stream_packet_lengths[BLE_DOWNLOAD_WINDOW_NUM_PACKETS], stream_buffer_index, stream_buffer_length, stream_max_payload;
+static uint16_t stream_base_sequence, stream_next_sequence, stream_notified_sequence;
+static uint32_t stream_retransmit_bitmap, stream_data_chunk_index, stream_total_data_chunks;
+static uint32_t stream_first_chunk, stream_max_chunks, stream_num_available_chunks, stream_num_data_bytes;
+static dmConnId_t download_conn_id = DM_CONN_ID_NONE;
+static bool is_streaming, stream_final_queued, stream_manifest_buffered, stream_compressed, stream_notification_pending;
+
+
+// Private Helper Functions --------------------------------------------------------------------------------------------
+
+static uint32_t crc32(const uint8_t *data, uint32_t length)
+{
+   // Compute the standard reflected CRC-32 (as used by zlib) using a nibble-wise lookup table
+   static const uint32_t crc_table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+   uint32_t crc = 0xFFFFFFFF;
+   for (uint32_t i = 0; i < length; ++i)
+   {
+      crc = crc_table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+      crc = crc_table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+   }
+   return ~crc;
+}
+
+static void buffer_next_stream_record(void)
+{
+   // Frame the next storage chunk with its absolute index, or the download manifest once all chunks have been buffered
+   uint8_t *record = stream_buffer + stream_buffer_length, *record_data = record + BLE_MAINTENANCE_RECORD_HEADER_LENGTH;
+   uint32_t chunk_index, crc;
+   uint16_t record_length;
+   if (stream_data_chunk_index < stream_total_data_chunks)
+   {
+      // Prefix the chunk with its encoding, compressing it if requested, and checksum the original data
+      chunk_index = stream_first_chunk + stream_data_chunk_index++;
+      uint8_t *chunk = stream_compressed ? stream_chunk : (record_data + 1);
+      const uint32_t chunk_length = storage_retrieve_next_data_chunk(chunk);
+      if (stream_compressed)
+         record_length = (uint16_t)log_compression_encode(chunk, chunk_length, record_data);
+      else
+      {
+         record_data[0] = LOG_ENCODING_RAW;
+         record_length = (uint16_t)(chunk_length + 1);
+      }
+      crc = crc32(chunk, chunk_length);
+      stream_num_data_bytes += chunk_length;
+   }
+   else
+   {
+      const uint32_t manifest[] = { stream_first_chunk, stream_total_data_chunks, stream_num_available_chunks, stream_num_data_bytes };
+      chunk_index = BLE_MAINTENANCE_MANIFEST_INDEX;
+      record_length = sizeof(manifest);
+      memcpy(record_data, manifest, sizeof(manifest));
+      crc = crc32(record_data, record_length);
+      stream_manifest_buffered = true;
+   }
+
+   // Append the record header and CRC so that the host can verify each chunk individually
+   memcpy(record, &chunk_index, sizeof(chunk_index));
+   memcpy(record + sizeof(chunk_index), &record_length, sizeof(record_length));
+   memcpy(record_data + record_length, &crc, sizeof(crc));
+   stream_buffer_length += BLE_MAINTENANCE_RECORD_HEADER_LENGTH + record_length + BLE_MAINTENANCE_RECORD_CRC_LENGTH;
+}
+
+static void build_stream_packet(void)
+{
+   // Ensure that there is enough buffered data to fill the next packet
+   if (((stream_buffer_length - stream_buffer_index) < stream_max_payload) && !stream_manifest_buffered)
+   {
+      memmove(stream_buffer, stream_buffer + stream_buffer_index, stream_buffer_length - stream_buffer_index);
+      stream_buffer_length -= stream_buffer_index;
+      stream_buffer_index = 0;
+      buffer_next_stream_record();
+   }
+
+   // Store the next sequence-numbered packet in its window slot so that it can be retransmitted if lost
+   uint8_t *packet = stream_packets[stream_next_sequence % BLE_DOWNLOAD_WINDOW_NUM_PACKETS];
+   const uint16_t payload_length = MIN(stream_max_payload, stream_buffer_length - stream_buffer_index);
+   stream_final_queued = ((stream_buffer_index + payload_length) == stream_buffer_length) && stream_manifest_buffered;
+   memcpy(packet, &stream_next_sequence, sizeof(stream_next_sequence));
+   packet[sizeof(stream_next_sequence)] = stream_final_queued ? BLE_MAINTENANCE_STREAM_FLAG_FINAL : 0;
+   memcpy(packet + BLE_MAINTENANCE_STREAM_HEADER_LENGTH, stream_buffer + stream_buffer_index, payload_length);
+   stream_packet_lengths[stream_next_sequence % BLE_DOWNLOAD_WINDOW_NUM_PACKETS] = BLE_MAINTENANCE_STREAM_HEADER_LENGTH + payload_length;
+   stream_buffer_index += payload_length;
+   download_num_bytes += payload_length;
+   ++stream_next_sequence;
+}
+
+static bool is_download_command(uint8_t command)
+{
+   // Determine whether a maintenance command configures or drives a log download
+   switch (command)
+   {
+      case BLE_MAINTENANCE_DOWNLOAD_LOG:
+      case BLE_MAINTENANCE_SET_LOG_DOWNLOAD_DATES:
+      case BLE_MAINTENANCE_DOWNLOAD_LOG_STREAMED:
+      case BLE_MAINTENANCE_DOWNLOAD_ACK:
+      case BLE_MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS:
+      case BLE_MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION:
+         return true;
+      default:
+         return false;
+   }
+}
+
+static uint16_t stream_num_in_flight(void)
+{
+   // Packets stay in flight from the moment they are sent until the host acknowledges them or they must be retransmitted
+   return (uint16_t)(stream_next_sequence - stream_base_sequence) - (uint16_t)__builtin_popcount(stream_retransmit_bitmap);
+}
+
+static void send_stream_packets(dmConnId_t connId)
+{
+   // Leave room in the shared HCI transmit queue for other connections while they exist, since a notification is
+   //   confirmed as soon as it reaches L2CAP and only the host's acknowledgment proves that it left the radio
+   const uint16_t max_packets_in_flight = (bluetooth_get_num_connections() > 1) ? BLE_SHARED_DOWNLOAD_MAX_PACKETS_IN_FLIGHT : BLE_DOWNLOAD_MAX_PACKETS_IN_FLIGHT;
+
+   // Send any requested retransmissions first, followed by new packets while the window remains open, handing only one
+   //   notification to the stack at a time so that each confirmation identifies the packet it belongs to
+   if (!stream_notification_pending && (stream_num_in_flight() < max_packets_in_flight))
+   {
+      uint16_t sequence;
+      if (stream_retransmit_bitmap)
+      {
+         const uint32_t offset = (uint32_t)__builtin_ctz(stream_retransmit_bitmap);
+         stream_retransmit_bitmap &= ~(1UL << offset);
+         sequence = stream_base_sequence + offset;
+      }
+      else if (!stream_final_queued && ((uint16_t)(stream_next_sequence - stream_base_sequence) < BLE_DOWNLOAD_WINDOW_NUM_PACKETS))
+      {
+         sequence = stream_next_sequence;
+         build_stream_packet();
+      }
+      else
+         return;
+
+      // Ask the host to acknowledge immediately once half or all of the in-flight limit is used so that the window keeps moving
+      uint8_t *packet = stream_packets[sequence % BLE_DOWNLOAD_WINDOW_NUM_PACKETS];
+      const uint16_t num_in_flight = stream_num_in_flight();
+      packet[sizeof(sequence)] &= ~BLE_MAINTENANCE_STREAM_FLAG_ACK_REQUESTED;
+      if ((num_in_flight == ((max_packets_in_flight + 1) / 2)) || (num_in_flight == max_packets_in_flight))
+         packet[sizeof(sequence)] |= BLE_MAINTENANCE_STREAM_FLAG_ACK_REQUESTED;
+      stream_notified_sequence = sequence;
+      stream_notification_pending = true;
+      AttsHandleValueNtf(connId, MAINTENANCE_RESULT_HANDLE, stream_packet_lengths[sequence % BLE_DOWNLOAD_WINDOW_NUM_PACKETS], packet);
+   }
+}
+
+static void start_streaming_log_data(dmConnId_t connId)
+{
+   // Skip any chunks that the host already has and limit the download to the requested number of chunks
+   experiment_details_t details;
+   storage_begin_reading(download_start_timestamp);
+   storage_retrieve_experiment_details(&details);
+   stream_num_available_chunks = storage_retrieve_num_data_chunks(download_end_timestamp);
+   stream_total_data_chunks = (stream_num_available_chunks > stream_first_chunk) ? (stream_num_available_chunks - stream_first_chunk) : 0;
+   if (stream_max_chunks && (stream_total_data_chunks > stream_max_chunks))
+      stream_total_data_chunks = stream_max_chunks;
+   storage_skip_data_chunks(stream_first_chunk);
+
+   // Place the estimated total data length and experiment details at the beginning of the stream
+   const uint32_t total_data_length = stream_total_data_chunks * MEMORY_NUM_DATA_BYTES_PER_PAGE;
+   memcpy(stream_buffer, &total_data_length, sizeof(total_data_length));
+   memcpy(stream_buffer + sizeof(total_data_length), &details, sizeof(details));
+   stream_buffer_length = sizeof(total_data_length) + sizeof(details);
+
+   // Reset all streaming variables and begin transmitting the first window of packets
+   stream_max_payload = MIN(AttGetMtu(connId) - 3, sizeof(stream_packets[0])) - BLE_MAINTENANCE_STREAM_HEADER_LENGTH;
+   stream_buffer_index = stream_base_sequence = stream_next_sequence = 0;
+   stream_retransmit_bitmap = stream_data_chunk_index = stream_num_data_bytes = download_num_bytes = 0;
+   download_start_ticks = xTaskGetTickCount();
+   stream_final_queued = stream_manifest_buffered = stream_notification_pending = false;
+   is_streaming = true;
+   send_stream_packets(connId);
+}
+
+static void handle_stream_acknowledgment(dmConnId_t connId, uint16_t next_expected_sequence, uint32_t missing_bitmap)
+{
+   // Ignore stale acknowledgments for sequence numbers outside of the current window
+   const uint16_t num_acknowledged = next_expected_sequence - stream_base_sequence, num_sent = stream_next_sequence - stream_base_sequence;
+   if (!is_streaming || (num_acknowledged > num_sent))
+      return;
+
+   // Slide the window forward and schedule all reported missing packets for retransmission, along with any the stack dropped
+   const uint16_t num_outstanding = num_sent - num_acknowledged;
+   const uint32_t dropped_bitmap = (num_acknowledged >= 32) ? 0 : (stream_retransmit_bitmap >> num_acknowledged);
+   stream_base_sequence = next_expected_sequence;
+   stream_retransmit_bitmap = (missing_bitmap | dropped_bitmap) & ((num_outstanding >= 32) ? 0xFFFFFFFF : ((1UL << num_outstanding) - 1));
+
+   // Finish streaming once the final packet has been acknowledged
+   if (stream_final_queued && !num_outstanding)
+   {
+      const uint32_t duration_ms = (uint32_t)((xTaskGetTickCount() - download_start_ticks) * portTICK_PERIOD_MS);
+      print("TotTag BLE: Streamed %u bytes in %u ms\n", download_num_bytes, duration_ms);
+      is_streaming = false;
+      storage_end_reading();
+      bluetooth_finish_bulk_transfer(connId, download_num_bytes, duration_ms);
+      download_conn_id = DM_CONN_ID_NONE;
+   }
+   else
+      send_stream_packets(connId);
+}
 
 
 // Public API ----------------------------------------------------------------------------------------------------------
@@ -24,6 +230,10 @@ uint8_t handleDeviceMaintenanceRead(dmConnId_t connId, uint16_t handle, uint8_t
 #else
    if (handle == MAINTENANCE_EXPERIMENT_HANDLE)
       storage_retrieve_experiment_details((experiment_details_t*)pAttr->pValue);
+   else if (handle == MAINTENANCE_LINK_STATUS_HANDLE)
+      bluetooth_retrieve_link_status(connId, (ble_link_status_t*)pAttr->pValue);
+   else if (handle == MAINTENANCE_BUFFER_STATUS_HANDLE)
+      bluetooth_retrieve_buffer_status((ble_buffer_status_t*)pAttr->pValue);
 #endif
    return ATT_SUCCESS;
 }
@@ -32,6 +242,17 @@ uint8_t handleDeviceMaintenanceWrite(dmConnId_t connId, uint16_t handle, uint8_t
 {
    // Handle the incoming BLE request
    print("TotTag BLE: Device Maintenance Write: connID = %d handle = %d, value = %d\n", connId, handle, *pValue);
+   if ((handle == MAINTENANCE_COMMAND_HANDLE) && is_download_command(*pValue))
+   {
+      // Storage can only be read by one connection at a time, so the first to start a download owns it until finished
+      if ((download_conn_id != DM_CONN_ID_NONE) && (download_conn_id != connId))
+      {
+         print("TotTag BLE: Rejecting download command from connID = %d while connID = %d is downloading\n", connId, download_conn_id);
+         return ATT_ERR_RESOURCES;
+      }
+      else if ((*pValue == BLE_MAINTENANCE_DOWNLOAD_LOG) || (*pValue == BLE_MAINTENANCE_DOWNLOAD_LOG_STREAMED))
+         download_conn_id = connId;
+   }
    if (handle == MAINTENANCE_COMMAND_HANDLE)
       switch (*pValue)
       {
@@ -51,17 +272,77 @@ uint8_t handleDeviceMaintenanceWrite(dmConnId_t connId, uint16_t handle, uint8_t
          {
             download_start_timestamp = *(uint32_t*)(pValue + 1);
             download_end_timestamp = *(uint32_t*)(pValue + 1 + sizeof(download_start_timestamp));
+            stream_first_chunk = stream_max_chunks = 0;
+            stream_compressed = false;
+            break;
+         }
+         case BLE_MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION:
+            if (len < 2)
+               return ATT_ERR_LENGTH;
+            stream_compressed = pValue[1];
+            break;
+         case BLE_MAINTENANCE_SET_RANGE_BATCHING:
+            if (len < 2)
+               return ATT_ERR_LENGTH;
+            setRangeResultsBatchSize(connId, pValue[1]);
+            break;
+         case BLE_MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS:
+         {
+            if (len < (1 + sizeof(stream_first_chunk) + sizeof(stream_max_chunks)))
+               return ATT_ERR_LENGTH;
+            memcpy(&stream_first_chunk, pValue + 1, sizeof(stream_first_chunk));
+            memcpy(&stream_max_chunks, pValue + 1 + sizeof(stream_first_chunk), sizeof(stream_max_chunks));
             break;
          }
          case BLE_MAINTENANCE_DOWNLOAD_LOG:
+            is_streaming = false;
+            bluetooth_start_bulk_transfer(connId);
             continueSendingLogData(connId, 0, false);
             break;
+         case BLE_MAINTENANCE_DOWNLOAD_LOG_STREAMED:
+            bluetooth_start_bulk_transfer(connId);
+            start_streaming_log_data(connId);
+            break;
+         case BLE_MAINTENANCE_DOWNLOAD_ACK:
+         {
+            uint16_t next_expected_sequence;
+            uint32_t missing_bitmap;
+            if (len < (1 + sizeof(next_expected_sequence) + sizeof(missing_bitmap)))
+               return ATT_ERR_LENGTH;
+            memcpy(&next_expected_sequence, pValue + 1, sizeof(next_expected_sequence));
+            memcpy(&missing_bitmap, pValue + 1 + sizeof(next_expected_sequence), sizeof(missing_bitmap));
+            handle_stream_acknowledgment(connId, next_expected_sequence, missing_bitmap);
+            break;
+         }
          default:
             break;
    }
    return ATT_SUCCESS;
 }
 
+bool isStreamingLogData(void)
+{
+   return is_streaming;
+}
+
+void continueStreamingLogData(dmConnId_t connId, uint16_t handle, uint8_t status)
+{
+   // Schedule an immediate retransmission of any packet that the stack failed to queue
+   if ((connId != download_conn_id) || !is_streaming)
+      return;
+   else if ((handle == MAINTENANCE_RESULT_HANDLE) && stream_notification_pending)
+   {
+      const uint16_t offset = stream_notified_sequence - stream_base_sequence;
+      stream_notification_pending = false;
+      if ((status != ATT_SUCCESS) && (offset < (uint16_t)(stream_next_sequence - stream_base_sequence)))
+         stream_retransmit_bitmap |= (1UL << offset);
+   }
+
+   // Send more packets once the connection is accepting notifications again, including after one on another handle completes
+   if (status == ATT_SUCCESS)
+      send_stream_packets(connId);
+}
+
 void continueSendingLogData(dmConnId_t connId, uint16_t max_length, bool repeat)
 {
    // Define static transmission variables
@@ -71,7 +352,9 @@ void continueSendingLogData(dmConnId_t connId, uint16_t max_length, bool repeat)
    static uint16_t buffer_index, buffer_length, previous_length;
 
    // Determine whether this is a new transmission or a continuation
-   if (max_length == 0)
+   if (connId != download_conn_id)
+      return;
+   else if (max_length == 0)
    {
       // Send meaningless packet just to kick off reading
       is_reading = started_reading = done_reading = false;
@@ -80,8 +363,9 @@ void continueSendingLogData(dmConnId_t connId, uint16_t max_length, bool repeat)
    else if (!started_reading)
    {
       // Reset all transmission variables and send estimated total data length
-      buffer_index = 0;
+      buffer_index = download_num_bytes = 0;
       started_reading = true;
+      download_start_ticks = xTaskGetTickCount();
       experiment_details_t details;
       storage_begin_reading(download_start_timestamp);
       storage_retrieve_experiment_details(&details);
@@ -120,6 +404,7 @@ void continueSendingLogData(dmConnId_t connId, uint16_t max_length, bool repeat)
          memcpy(previous_buffer, transmit_buffer + buffer_index, transmit_length);
          previous_length = transmit_length;
          buffer_index += transmit_length;
+         download_num_bytes += transmit_length;
 
          // Ensure that there is enough buffered data to transmit again in the future without reading
          if (((buffer_length - buffer_index) < max_length) && (data_chunk_index < total_data_chunks))
@@ -137,8 +422,23 @@ void continueSendingLogData(dmConnId_t connId, uint16_t max_length, bool repeat)
          is_reading = false;
          done_reading = true;
          storage_end_reading();
+         const uint32_t duration_ms = (uint32_t)((xTaskGetTickCount() - download_start_ticks) * portTICK_PERIOD_MS);
+         print("TotTag BLE: Sent %u bytes in %u ms\n", download_num_bytes, duration_ms);
+         bluetooth_finish_bulk_transfer(connId, download_num_bytes, duration_ms);
          uint8_t completion_packet = BLE_MAINTENANCE_PACKET_COMPLETE;
          AttsHandleValueInd(connId, MAINTENANCE_RESULT_HANDLE, sizeof(completion_packet), &completion_packet);
+         download_conn_id = DM_CONN_ID_NONE;
       }
    }
 }
+
+void stopSendingLogData(dmConnId_t connId)
+{
+   // Release storage and the download session if its connection was closed mid-transfer
+   if (connId == download_conn_id)
+   {
+      is_streaming = false;
+      storage_end_reading();
+      download_conn_id = DM_CONN_ID_NONE;
+   }
+}
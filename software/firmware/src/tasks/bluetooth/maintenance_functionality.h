@@ -14,13 +14,28 @@
 #define BLE_MAINTENANCE_DELETE_EXPERIMENT               0x02
 #define BLE_MAINTENANCE_DOWNLOAD_LOG                    0x03
 #define BLE_MAINTENANCE_SET_LOG_DOWNLOAD_DATES          0x04
+#define BLE_MAINTENANCE_DOWNLOAD_LOG_STREAMED           0x05
+#define BLE_MAINTENANCE_DOWNLOAD_ACK                    0x06
+#define BLE_MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS         0x07
+#define BLE_MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION    0x08
+#define BLE_MAINTENANCE_SET_RANGE_BATCHING              0x09
 #define BLE_MAINTENANCE_PACKET_COMPLETE                 0xFF
 
+#define BLE_MAINTENANCE_STREAM_HEADER_LENGTH            3           // Sequence Number + Flags
+#define BLE_MAINTENANCE_STREAM_FLAG_FINAL               0x01
+#define BLE_MAINTENANCE_STREAM_FLAG_ACK_REQUESTED       0x02
+#define BLE_MAINTENANCE_RECORD_HEADER_LENGTH            6           // Chunk Index + Length
+#define BLE_MAINTENANCE_RECORD_CRC_LENGTH               4
+#define BLE_MAINTENANCE_MANIFEST_INDEX                  0xFFFFFFFF
+
 
 // Public API ----------------------------------------------------------------------------------------------------------
 
 uint8_t handleDeviceMaintenanceRead(dmConnId_t connId, uint16_t handle, uint8_t operation, uint16_t offset, attsAttr_t *pAttr);
 uint8_t handleDeviceMaintenanceWrite(dmConnId_t connId, uint16_t handle, uint8_t operation, uint16_t offset, uint16_t len, uint8_t *pValue, attsAttr_t *pAttr);
 void continueSendingLogData(dmConnId_t connId, uint16_t max_length, bool repeat);
+void continueStreamingLogData(dmConnId_t connId, uint16_t handle, uint8_t status);
+void stopSendingLogData(dmConnId_t connId);
+bool isStreamingLogData(void);
 
 #endif  // #ifndef __MAINTENANCE_FUNCTIONALITY_HEADER_H__
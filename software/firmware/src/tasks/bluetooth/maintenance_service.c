@@ -3,6 +3,7 @@
 #include "app_tasks.h"
 #include "wsf_types.h"
 #include "att_api.h"
+#include "bluetooth.h"
 #include "maintenance_service.h"
 #include "util/bstream.h"
 
@@ -26,7 +27,7 @@ static const uint16_t maintenanceCommandLen = sizeof(maintenanceCommand);
 static const uint8_t maintenanceCommandDesc[] = "MaintenanceCommand";
 static const uint16_t maintenanceCommandDescLen = sizeof(maintenanceCommandDesc);
 static const uint8_t maintenanceResultChUuid[] = { BLE_MAINTENANCE_DATA_CHAR };
-static const uint8_t maintenanceResultChar[] = { ATT_PROP_INDICATE, UINT16_TO_BYTES(MAINTENANCE_RESULT_HANDLE), BLE_MAINTENANCE_DATA_CHAR };
+static const uint8_t maintenanceResultChar[] = { ATT_PROP_INDICATE | ATT_PROP_NOTIFY, UINT16_TO_BYTES(MAINTENANCE_RESULT_HANDLE), BLE_MAINTENANCE_DATA_CHAR };
 static const uint16_t maintenanceResultCharLen = sizeof(maintenanceResultChar);
 static uint8_t maintenanceResult[] = { 0 };
 static const uint16_t maintenanceResultLen = sizeof(maintenanceResult);
@@ -34,6 +35,20 @@ static const uint8_t maintenanceResultDesc[] = "MaintenanceData";
 static const uint16_t maintenanceResultDescLen = sizeof(maintenanceResultDesc);
 static uint8_t maintenanceResultCcc[] = { UINT16_TO_BYTES(0x0000) };
 static const uint16_t maintenanceResultCccLen = sizeof(maintenanceResultCcc);
+static const uint8_t linkStatusChUuid[] = { BLE_MAINTENANCE_LINK_STATUS_CHAR };
+static const uint8_t linkStatusChar[] = { ATT_PROP_READ, UINT16_TO_BYTES(MAINTENANCE_LINK_STATUS_HANDLE), BLE_MAINTENANCE_LINK_STATUS_CHAR };
+static const uint16_t linkStatusCharLen = sizeof(linkStatusChar);
+static ble_link_status_t linkStatus = { 0 };
+static const uint16_t linkStatusLen = sizeof(linkStatus);
+static const uint8_t linkStatusDesc[] = "LinkStatus";
+static const uint16_t linkStatusDescLen = sizeof(linkStatusDesc);
+static const uint8_t bufferStatusChUuid[] = { BLE_MAINTENANCE_BUFFER_STATUS_CHAR };
+static const uint8_t bufferStatusChar[] = { ATT_PROP_READ, UINT16_TO_BYTES(MAINTENANCE_BUFFER_STATUS_HANDLE), BLE_MAINTENANCE_BUFFER_STATUS_CHAR };
+static const uint16_t bufferStatusCharLen = sizeof(bufferStatusChar);
+static ble_buffer_status_t bufferStatus = { 0 };
+static const uint16_t bufferStatusLen = sizeof(bufferStatus);
+static const uint8_t bufferStatusDesc[] = "BufferStatus";
+static const uint16_t bufferStatusDescLen = sizeof(bufferStatusDesc);
 
 static const attsAttr_t maintenanceList[] =
 {
@@ -124,6 +139,54 @@ static const attsAttr_t maintenanceList[] =
       sizeof(maintenanceResultCcc),
       ATTS_SET_CCC,
       (ATTS_PERMIT_READ | ATTS_PERMIT_WRITE)
+   },
+   {
+      attChUuid,
+      (uint8_t*)linkStatusChar,
+      (uint16_t*)&linkStatusCharLen,
+      sizeof(linkStatusChar),
+      0,
+      ATTS_PERMIT_READ
+   },
+   {
+      linkStatusChUuid,
+      (uint8_t*)&linkStatus,
+      (uint16_t*)&linkStatusLen,
+      sizeof(linkStatus),
+      (ATTS_SET_UUID_128 | ATTS_SET_READ_CBACK),
+      ATTS_PERMIT_READ
+   },
+   {
+      attChUserDescUuid,
+      (uint8_t*)linkStatusDesc,
+      (uint16_t*)&linkStatusDescLen,
+      sizeof(linkStatusDesc),
+      0,
+      ATTS_PERMIT_READ
+   },
+   {
+      attChUuid,
+      (uint8_t*)bufferStatusChar,
+      (uint16_t*)&bufferStatusCharLen,
+      sizeof(bufferStatusChar),
+      0,
+      ATTS_PERMIT_READ
+   },
+   {
+      bufferStatusChUuid,
+      (uint8_t*)&bufferStatus,
+      (uint16_t*)&bufferStatusLen,
+      sizeof(bufferStatus),
+      (ATTS_SET_UUID_128 | ATTS_SET_READ_CBACK),
+      ATTS_PERMIT_READ
+   },
+   {
+      attChUserDescUuid,
+      (uint8_t*)bufferStatusDesc,
+      (uint16_t*)&bufferStatusDescLen,
+      sizeof(bufferStatusDesc),
+      0,
+      ATTS_PERMIT_READ
    }
 };
 
@@ -16,6 +16,12 @@ enum
    MAINTENANCE_RESULT_HANDLE,               // Maintenance command result
    MAINTENANCE_RESULT_DESC_HANDLE,          // Maintenance command result description
    MAINTENANCE_RESULT_CCC_HANDLE,           // Maintenance command result client characteristic configuration descriptor
+   MAINTENANCE_LINK_STATUS_CHAR_HANDLE,     // Connection link status characteristic
+   MAINTENANCE_LINK_STATUS_HANDLE,          // Connection link status
+   MAINTENANCE_LINK_STATUS_DESC_HANDLE,     // Connection link status description
+   MAINTENANCE_BUFFER_STATUS_CHAR_HANDLE,   // WSF buffer pool status characteristic
+   MAINTENANCE_BUFFER_STATUS_HANDLE,        // WSF buffer pool status
+   MAINTENANCE_BUFFER_STATUS_DESC_HANDLE,   // WSF buffer pool status description
    MAINTENANCE_MAX_HANDLE                   // Maximum live statistics handle
 };
 
@@ -234,10 +234,12 @@ void scheduler_run(schedule_role_t role)
    // Notify the application that network connectivity has been established
    app_notify(APP_NOTIFY_NETWORK_CONNECTED, false);
 
-   // Loop forever waiting for actions to wake us up
+   // Loop forever waiting for actions to wake us up, sending any overdue batched results while rounds are missed
    uint32_t pending_actions = 0;
    while (is_running)
-      if (xTaskNotifyWait(pdFALSE, 0xffffffff, &pending_actions, portMAX_DELAY) == pdTRUE)
+      if (xTaskNotifyWait(pdFALSE, 0xffffffff, &pending_actions, pdMS_TO_TICKS(SCHEDULING_INTERVAL_US / 1000)) != pdTRUE)
+         bluetooth_flush_range_results(false);
+      else
       {
          // Handle any pending actions
          if ((pending_actions & RANGING_NEW_ROUND_START))
@@ -309,8 +311,9 @@ void scheduler_run(schedule_role_t role)
    NVIC_DisableIRQ(TIMER0_IRQn + RADIO_WAKEUP_TIMER_NUMBER);
    NVIC_DisableIRQ(RTC_IRQn);
 
-   // Put the DW3000 radio into deep sleep mode
+   // Put the DW3000 radio into deep sleep mode and deliver any results still waiting in a partial batch
    ranging_radio_sleep(true);
+   bluetooth_flush_range_results(true);
 
    // Notify the application that network connectivity has been lost
    current_role = ROLE_IDLE;
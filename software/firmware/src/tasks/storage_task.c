@@ -1,6 +1,8 @@
 // Header Inclusions ---------------------------------------------------------------------------------------------------
 
 #include "app_tasks.h"
+#include "logging.h"
+#include "rtc.h"
 #include "storage.h"
 #include "system.h"
 
@@ -9,6 +11,8 @@
 
 typedef struct storage_item_t { uint32_t timestamp, value; uint8_t type; } storage_item_t;
 typedef struct ranging_data_t { uint8_t data[MAX_COMPRESSED_RANGE_DATA_LENGTH]; uint32_t length; } ranging_data_t;
+typedef struct range_summary_t { int32_t sum_mm; int16_t min_mm, max_mm; uint8_t uid, num_samples; } range_summary_t;
+typedef struct __attribute__ ((__packed__)) range_summary_datum_t { uint8_t uid; int16_t mean_mm, min_mm, max_mm; uint8_t num_samples; } range_summary_datum_t;
 
 
 // Static Global Variables ---------------------------------------------------------------------------------------------
@@ -18,19 +22,25 @@ static uint8_t ucQueueStorage[STORAGE_QUEUE_MAX_NUM_ITEMS * sizeof(storage_item_
 static int32_t ranging_timestamp_offset;
 static StaticQueue_t xQueueBuffer;
 static QueueHandle_t storage_queue;
+static volatile storage_tier_t storage_tier;
 
 
 // Private Helper Functions --------------------------------------------------------------------------------------------
 
 #if REVISION_ID != REVISION_APOLLO4_EVB && !defined(_TEST_BLE_RANGING_TASK)
 
+static range_summary_t range_summaries[MAX_NUM_RANGING_DEVICES];
+static uint32_t range_summary_timestamp, num_range_summaries;
+static uint32_t tier_bytes_per_period[STORAGE_TIER_VOLTAGE_ONLY + 1], tier_rates_measured;
+static uint32_t last_evaluation_timestamp, last_evaluation_free_bytes;
+static uint32_t experiment_end_time, daily_active_seconds;
+
 static void store_battery_voltage(uint32_t timestamp, uint32_t battery_voltage_mV)
 {
    const uint8_t storage_type = STORAGE_TYPE_VOLTAGE;
    storage_store(&storage_type, sizeof(storage_type));
    storage_store(&timestamp, sizeof(timestamp));
    storage_store(&battery_voltage_mV, sizeof(battery_voltage_mV));
-   storage_flush(false);
 }
 
 static void store_motion_change(uint32_t timestamp, bool in_motion)
@@ -39,7 +49,6 @@ static void store_motion_change(uint32_t timestamp, bool in_motion)
    storage_store(&storage_type, sizeof(storage_type));
    storage_store(&timestamp, sizeof(timestamp));
    storage_store(&in_motion, sizeof(in_motion));
-   storage_flush(false);
 }
 
 static void store_ranges(uint32_t timestamp, const uint8_t *range_data, uint32_t range_data_len)
@@ -48,7 +57,161 @@ static void store_ranges(uint32_t timestamp, const uint8_t *range_data, uint32_t
    storage_store(&storage_type, sizeof(storage_type));
    storage_store(&timestamp, sizeof(timestamp));
    storage_store(range_data, range_data_len);
-   storage_flush(false);
+}
+
+static void store_range_summaries(void)
+{
+   // Store the per-device range statistics accumulated during the current summary period
+   if (num_range_summaries)
+   {
+      const uint8_t storage_type = STORAGE_TYPE_RANGE_SUMMARY, num_devices = (uint8_t)num_range_summaries;
+      storage_store(&storage_type, sizeof(storage_type));
+      storage_store(&range_summary_timestamp, sizeof(range_summary_timestamp));
+      storage_store(&num_devices, sizeof(num_devices));
+      for (uint32_t i = 0; i < num_range_summaries; ++i)
+      {
+         const range_summary_datum_t datum = { .uid = range_summaries[i].uid, .mean_mm = (int16_t)(range_summaries[i].sum_mm / range_summaries[i].num_samples),
+                                               .min_mm = range_summaries[i].min_mm, .max_mm = range_summaries[i].max_mm, .num_samples = range_summaries[i].num_samples };
+         storage_store(&datum, sizeof(datum));
+      }
+      num_range_summaries = 0;
+   }
+}
+
+static void summarize_ranges(uint32_t timestamp, const uint8_t *range_data)
+{
+   // Store any existing summaries once a new summary period has started
+   const uint32_t summary_timestamp = (1000 * STORAGE_RANGE_SUMMARY_PERIOD_S) * (timestamp / (1000 * STORAGE_RANGE_SUMMARY_PERIOD_S));
+   if (summary_timestamp != range_summary_timestamp)
+   {
+      store_range_summaries();
+      range_summary_timestamp = summary_timestamp;
+   }
+
+   // Accumulate the new ranges into the statistics for each device
+   for (uint32_t i = 0; i < range_data[0]; ++i)
+   {
+      int16_t range_mm;
+      const uint8_t uid = range_data[1 + (i * COMPRESSED_RANGE_DATUM_LENGTH)];
+      memcpy(&range_mm, range_data + 2 + (i * COMPRESSED_RANGE_DATUM_LENGTH), sizeof(range_mm));
+      uint32_t idx = 0;
+      while ((idx < num_range_summaries) && (range_summaries[idx].uid != uid))
+         ++idx;
+      if (idx == MAX_NUM_RANGING_DEVICES)
+         continue;
+      else if (idx == num_range_summaries)
+         range_summaries[num_range_summaries++] = (range_summary_t){ .sum_mm = 0, .min_mm = INT16_MAX, .max_mm = INT16_MIN, .uid = uid, .num_samples = 0 };
+      if (range_summaries[idx].num_samples < UINT8_MAX)
+      {
+         range_summaries[idx].sum_mm += range_mm;
+         range_summaries[idx].min_mm = (range_mm < range_summaries[idx].min_mm) ? range_mm : range_summaries[idx].min_mm;
+         range_summaries[idx].max_mm = (range_mm > range_summaries[idx].max_mm) ? range_mm : range_summaries[idx].max_mm;
+         ++range_summaries[idx].num_samples;
+      }
+   }
+}
+
+static uint8_t storage_percent_full(uint32_t num_free_bytes)
+{
+   const uint32_t capacity = storage_retrieve_capacity_bytes();
+   return capacity ? (uint8_t)(100 - ((100ULL * num_free_bytes) / capacity)) : 100;
+}
+
+static uint32_t remaining_active_experiment_seconds(uint32_t timestamp)
+{
+   // Only count the time during which the experiment is scheduled to be actively recording
+   if (experiment_end_time <= timestamp)
+      return 0;
+   return (uint32_t)(((uint64_t)(experiment_end_time - timestamp) * daily_active_seconds) / 86400);
+}
+
+static bool tier_fits_in_memory(storage_tier_t tier, uint32_t remaining_seconds, uint32_t num_free_bytes)
+{
+   // Determine whether the measured storage rate for a tier will fit in the remaining memory until the experiment ends
+   const uint64_t projected_bytes = ((uint64_t)tier_bytes_per_period[tier] * remaining_seconds) / STORAGE_CAPACITY_EVALUATION_PERIOD_S;
+   return (tier_rates_measured & (1 << tier)) && ((projected_bytes * (100 + STORAGE_CAPACITY_SAFETY_MARGIN_PERCENT)) <= (100ULL * num_free_bytes));
+}
+
+static void update_storage_tier(void)
+{
+   // Retrieve the experiment schedule and establish a baseline upon the first evaluation
+   const uint32_t timestamp = rtc_get_timestamp(), num_free_bytes = storage_retrieve_num_free_bytes();
+   storage_tier_t new_tier = storage_tier;
+   if (!last_evaluation_timestamp)
+   {
+      experiment_details_t details;
+      storage_retrieve_experiment_details(&details);
+      experiment_end_time = details.experiment_end_time;
+      daily_active_seconds = !details.use_daily_times ? 86400 : (details.daily_end_time > details.daily_start_time) ?
+            (details.daily_end_time - details.daily_start_time) : (86400 - details.daily_start_time + details.daily_end_time);
+   }
+   else if ((timestamp - last_evaluation_timestamp) < STORAGE_CAPACITY_EVALUATION_PERIOD_S)
+      return;
+   else if (last_evaluation_free_bytes > num_free_bytes)
+   {
+      // Update the storage rate of the current tier, normalized to a full evaluation period
+      const uint32_t bytes_per_period = (uint32_t)(((uint64_t)(last_evaluation_free_bytes - num_free_bytes) * STORAGE_CAPACITY_EVALUATION_PERIOD_S) / (timestamp - last_evaluation_timestamp));
+      tier_bytes_per_period[storage_tier] = (tier_rates_measured & (1 << storage_tier)) ? ((tier_bytes_per_period[storage_tier] + bytes_per_period) / 2) : bytes_per_period;
+      tier_rates_measured |= (1 << storage_tier);
+
+      // Move to a coarser tier if the current tier is projected to fill memory, or back to the finest tier that fits
+      const uint32_t remaining_seconds = remaining_active_experiment_seconds(timestamp);
+      if ((storage_tier < STORAGE_TIER_VOLTAGE_ONLY) && !tier_fits_in_memory(storage_tier, remaining_seconds, num_free_bytes))
+         new_tier = storage_tier + 1;
+      for (storage_tier_t tier = STORAGE_TIER_FULL_RESOLUTION; tier < storage_tier; ++tier)
+         if (tier_fits_in_memory(tier, remaining_seconds, num_free_bytes))
+         {
+            new_tier = tier;
+            break;
+         }
+   }
+   last_evaluation_timestamp = timestamp;
+   last_evaluation_free_bytes = num_free_bytes;
+
+   // Enforce a minimum tier based on how full memory is, regardless of projections
+   const uint8_t percent_full = storage_percent_full(num_free_bytes);
+   if ((percent_full >= STORAGE_TIER_VOLTAGE_ONLY_PERCENT_FULL) && (new_tier < STORAGE_TIER_VOLTAGE_ONLY))
+      new_tier = STORAGE_TIER_VOLTAGE_ONLY;
+   else if ((percent_full >= STORAGE_TIER_MOTION_ONLY_PERCENT_FULL) && (new_tier < STORAGE_TIER_MOTION_ONLY))
+      new_tier = STORAGE_TIER_MOTION_ONLY;
+   else if ((percent_full >= STORAGE_TIER_RANGE_SUMMARIES_PERCENT_FULL) && (new_tier < STORAGE_TIER_RANGE_SUMMARIES))
+      new_tier = STORAGE_TIER_RANGE_SUMMARIES;
+
+   // Store any pending range summaries before switching tiers
+   if (new_tier != storage_tier)
+   {
+      print("TotTag Storage: Switching from storage tier %u to %u at %u%% full\n", storage_tier, new_tier, percent_full);
+      if (storage_tier == STORAGE_TIER_RANGE_SUMMARIES)
+         store_range_summaries();
+      storage_tier = new_tier;
+   }
+}
+
+static void process_storage_item(const storage_item_t *item)
+{
+   switch (item->type)
+   {
+      case STORAGE_TYPE_SHUTDOWN:
+         store_range_summaries();
+         storage_flush(true);
+         system_reset(true);
+         break;
+      case STORAGE_TYPE_VOLTAGE:
+         store_battery_voltage(item->timestamp, item->value);
+         break;
+      case STORAGE_TYPE_MOTION:
+         if (storage_tier <= STORAGE_TIER_MOTION_ONLY)
+            store_motion_change(item->timestamp, item->value);
+         break;
+      case STORAGE_TYPE_RANGES:
+         if (storage_tier == STORAGE_TIER_FULL_RESOLUTION)
+            store_ranges(item->timestamp, range_data[item->value].data, range_data[item->value].length);
+         else if (storage_tier == STORAGE_TIER_RANGE_SUMMARIES)
+            summarize_ranges(item->timestamp, range_data[item->value].data);
+         break;
+      default:
+         break;
+   }
 }
 
 
@@ -87,12 +250,32 @@ void storage_write_ranging_data(uint32_t timestamp, const uint8_t *ranging_data,
    xQueueSendToBack(storage_queue, &storage_item, 0);
 }
 
+void storage_retrieve_capacity_status(storage_capacity_status_t *status)
+{
+   // Project the time until memory is full based on the measured storage rate of the current tier
+   const uint32_t num_free_bytes = storage_retrieve_num_free_bytes();
+   const uint64_t bytes_per_period = (tier_rates_measured & (1 << storage_tier)) ? tier_bytes_per_period[storage_tier] : 0;
+   const uint64_t seconds_until_full = bytes_per_period ? (((uint64_t)num_free_bytes * STORAGE_CAPACITY_EVALUATION_PERIOD_S) / bytes_per_period) : UINT32_MAX;
+   status->tier = (uint8_t)storage_tier;
+   status->percent_full = storage_percent_full(num_free_bytes);
+   status->seconds_until_full = (seconds_until_full < UINT32_MAX) ? (uint32_t)seconds_until_full : UINT32_MAX;
+}
+
 #else
 
+static void update_storage_tier(void) {}
+
+static void process_storage_item(const storage_item_t *item)
+{
+   if (item->type == STORAGE_TYPE_SHUTDOWN)
+      system_reset(true);
+}
+
 void storage_flush_and_shutdown(void) {}
 void storage_write_battery_level(uint32_t battery_voltage_mV) {}
 void storage_write_motion_status(bool in_motion) {}
 void storage_write_ranging_data(uint32_t timestamp, const uint8_t *ranging_data, uint32_t ranging_data_len) {}
+void storage_retrieve_capacity_status(storage_capacity_status_t *status) { memset(status, 0, sizeof(*status)); }
 
 #endif    // #if REVISION_ID != REVISION_APOLLO4_EVB && !defined(_TEST_BLE_RANGING_TASK)
 
@@ -101,38 +284,28 @@ void StorageTask(void *params)
    // Create a queue to hold pending storage items
    static storage_item_t item;
    ranging_timestamp_offset = 0;
+   storage_tier = STORAGE_TIER_FULL_RESOLUTION;
    storage_queue = xQueueCreateStatic(STORAGE_QUEUE_MAX_NUM_ITEMS, sizeof(storage_item_t), ucQueueStorage, &xQueueBuffer);
 
    // Set whether the storage peripheral should be in maintenance mode
    if (params)
+   {
       storage_exit_maintenance_mode();
+      update_storage_tier();
+   }
    else
       storage_enter_maintenance_mode();
 
-   // Loop forever, waiting until storage events are received
+   // Loop forever, waiting until storage events are received or the maximum batching latency has elapsed
    while (true)
-      if (xQueueReceive(storage_queue, &item, portMAX_DELAY) == pdPASS)
-#if REVISION_ID == REVISION_APOLLO4_EVB || defined(_TEST_BLE_RANGING_TASK)
-         if (item.type == STORAGE_TYPE_SHUTDOWN)
-            system_reset(true);
-#else
-         switch (item.type)
-         {
-            case STORAGE_TYPE_SHUTDOWN:
-               storage_flush(true);
-               system_reset(true);
-               break;
-            case STORAGE_TYPE_VOLTAGE:
-               store_battery_voltage(item.timestamp, item.value);
-               break;
-            case STORAGE_TYPE_MOTION:
-               store_motion_change(item.timestamp, item.value);
-               break;
-            case STORAGE_TYPE_RANGES:
-               store_ranges(item.timestamp, range_data[item.value].data, range_data[item.value].length);
-               break;
-            default:
-               break;
-         }
-#endif
+   {
+      // Drain all pending storage items before committing any full pages to memory in a single batch
+      if (xQueueReceive(storage_queue, &item, pdMS_TO_TICKS(1000 * STORAGE_BATCH_MAX_LATENCY_S)) == pdPASS)
+         do
+            process_storage_item(&item);
+         while (xQueueReceive(storage_queue, &item, 0) == pdPASS);
+      storage_flush(false);
+      if (params)
+         update_storage_tier();
+   }
 }
@@ -0,0 +1,71 @@
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "host_hal.h"
+#include "rtc.h"
+#include "system.h"
+#include "w25n01_model.h"
+
+
+// Static Global Variables ---------------------------------------------------------------------------------------------
+
+static uint32_t rtc_timestamp = 1700000000, num_system_resets = 0;
+
+
+// Simulated BSP and GPIO HAL Functions --------------------------------------------------------------------------------
+
+const am_hal_gpio_pincfg_t am_hal_gpio_pincfg_output = { .GP.cfg = 0 };
+const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_SCK = { .GP.cfg = 0 };
+const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_MISO = { .GP.cfg = 0 };
+const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_MOSI = { .GP.cfg = 0 };
+const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_CS = { .GP.cfg = 0 };
+
+uint32_t am_hal_gpio_pinconfig(uint32_t pin, am_hal_gpio_pincfg_t config) { return AM_HAL_STATUS_SUCCESS; }
+
+void am_hal_gpio_output_set(uint32_t pin)
+{
+   if (pin == PIN_STORAGE_WRITE_PROTECT)
+      w25n01_model_set_write_protect_pin(true);
+}
+
+void am_hal_gpio_output_clear(uint32_t pin)
+{
+   if (pin == PIN_STORAGE_WRITE_PROTECT)
+      w25n01_model_set_write_protect_pin(false);
+}
+
+void am_hal_delay_us(uint32_t us) { w25n01_model_advance_time_ns(1000ULL * us); }
+void am_util_delay_ms(uint32_t ms) { w25n01_model_advance_time_ns(1000000ULL * ms); }
+
+
+// Simulated Firmware Peripheral Functions -----------------------------------------------------------------------------
+
+uint32_t rtc_get_timestamp(void) { return rtc_timestamp; }
+uint32_t rtc_get_time_of_day(void) { return rtc_timestamp % 86400; }
+bool rtc_is_valid(void) { return true; }
+
+void system_reset(bool immediate)
+{
+   // Track resets rather than aborting so that tests can report them
+   ++num_system_resets;
+   fprintf(stderr, "WARNING: Firmware requested a system reset\n");
+}
+
+void vAssertCalled(const char * const pcFileName, unsigned long ulLine)
+{
+   fprintf(stderr, "ERROR: Assertion failed at %s:%lu\n", pcFileName, ulLine);
+   exit(EXIT_FAILURE);
+}
+
+
+// Public API Functions ------------------------------------------------------------------------------------------------
+
+void host_rtc_set_timestamp(uint32_t timestamp)
+{
+   rtc_timestamp = timestamp;
+}
+
+uint32_t host_num_system_resets(void)
+{
+   return num_system_resets;
+}
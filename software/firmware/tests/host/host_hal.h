@@ -0,0 +1,14 @@
+#ifndef __HOST_HAL_HEADER_H__
+#define __HOST_HAL_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+
+// Public API Functions ------------------------------------------------------------------------------------------------
+
+void host_rtc_set_timestamp(uint32_t timestamp);
+uint32_t host_num_system_resets(void);
+
+#endif  // #ifndef __HOST_HAL_HEADER_H__
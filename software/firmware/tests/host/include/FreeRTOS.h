@@ -0,0 +1,10 @@
+#ifndef __FREERTOS_HOST_HEADER_H__
+#define __FREERTOS_HOST_HEADER_H__
+
+// Host FreeRTOS Definitions -------------------------------------------------------------------------------------------
+
+void vAssertCalled(const char * const pcFileName, unsigned long ulLine);
+#define configASSERT( x ) if( ( x ) == 0 ) vAssertCalled( __FILE__, __LINE__ )
+#define configASSERT0( x ) if( ( x ) != 0 ) vAssertCalled( __FILE__, __LINE__ )
+
+#endif  // #ifndef __FREERTOS_HOST_HEADER_H__
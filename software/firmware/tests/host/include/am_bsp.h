@@ -0,0 +1,16 @@
+#ifndef __AM_BSP_HOST_HEADER_H__
+#define __AM_BSP_HOST_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include "am_mcu_apollo.h"
+
+
+// Host BSP Definitions ------------------------------------------------------------------------------------------------
+
+extern const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_SCK;
+extern const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_MISO;
+extern const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_MOSI;
+extern const am_hal_gpio_pincfg_t g_AM_BSP_GPIO_IOM0_CS;
+
+#endif  // #ifndef __AM_BSP_HOST_HEADER_H__
@@ -0,0 +1,79 @@
+#ifndef __AM_MCU_APOLLO_HOST_HEADER_H__
+#define __AM_MCU_APOLLO_HOST_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Host HAL Definitions ------------------------------------------------------------------------------------------------
+
+#define AM_HAL_STATUS_SUCCESS                       0
+#define AM_HAL_STATUS_FAIL                          1
+#define AM_HAL_STATUS_INVALID_OPERATION             3
+
+#define AM_HAL_PIN_47_M5SCK                         5
+#define AM_HAL_PIN_48_M5MOSI                        5
+#define AM_HAL_PIN_49_M5MISO                        5
+#define AM_HAL_PIN_69_NCE69                         1
+
+typedef enum { AM_HAL_SYSCTRL_WAKE, AM_HAL_SYSCTRL_NORMALSLEEP, AM_HAL_SYSCTRL_DEEPSLEEP } am_hal_sysctrl_power_state_e;
+typedef enum { AM_HAL_IOM_SPI_MODE, AM_HAL_IOM_I2C_MODE } am_hal_iom_mode_e;
+typedef enum { AM_HAL_IOM_SPI_MODE_0, AM_HAL_IOM_SPI_MODE_1, AM_HAL_IOM_SPI_MODE_2, AM_HAL_IOM_SPI_MODE_3 } am_hal_iom_spi_mode_e;
+typedef enum { AM_HAL_IOM_RX, AM_HAL_IOM_TX, AM_HAL_IOM_FULLDUPLEX } am_hal_iom_dir_e;
+
+#define AM_HAL_IOM_48MHZ                            48000000
+
+typedef struct
+{
+   am_hal_iom_mode_e eInterfaceMode;
+   uint32_t ui32ClockFreq;
+   am_hal_iom_spi_mode_e eSpiMode;
+   uint32_t *pNBTxnBuf;
+   uint32_t ui32NBTxnBufLength;
+} am_hal_iom_config_t;
+
+typedef struct
+{
+   union { uint32_t ui32SpiChipSelect; uint32_t ui32I2CDevAddr; } uPeerInfo;
+   uint32_t ui32InstrLen;
+   uint64_t ui64Instr;
+   uint32_t ui32NumBytes;
+   am_hal_iom_dir_e eDirection;
+   uint32_t *pui32TxBuffer;
+   uint32_t *pui32RxBuffer;
+   bool bContinue;
+   uint8_t ui8RepeatCount;
+   uint8_t ui8Priority;
+   uint32_t ui32PauseCondition;
+   uint32_t ui32StatusSetClr;
+} am_hal_iom_transfer_t;
+
+typedef struct
+{
+   union
+   {
+      struct { uint32_t uFuncSel : 4; uint32_t uNCE : 8; uint32_t uReserved : 20; } cfg_b;
+      uint32_t cfg;
+   } GP;
+} am_hal_gpio_pincfg_t;
+
+extern const am_hal_gpio_pincfg_t am_hal_gpio_pincfg_output;
+
+
+// Host HAL Functions --------------------------------------------------------------------------------------------------
+
+uint32_t am_hal_gpio_pinconfig(uint32_t pin, am_hal_gpio_pincfg_t config);
+void am_hal_gpio_output_set(uint32_t pin);
+void am_hal_gpio_output_clear(uint32_t pin);
+void am_hal_delay_us(uint32_t us);
+
+uint32_t am_hal_iom_initialize(uint32_t module, void **handle);
+uint32_t am_hal_iom_uninitialize(void *handle);
+uint32_t am_hal_iom_configure(void *handle, const am_hal_iom_config_t *config);
+uint32_t am_hal_iom_enable(void *handle);
+uint32_t am_hal_iom_power_ctrl(void *handle, am_hal_sysctrl_power_state_e power_state, bool retain_state);
+uint32_t am_hal_iom_blocking_transfer(void *handle, am_hal_iom_transfer_t *transaction);
+
+#endif  // #ifndef __AM_MCU_APOLLO_HOST_HEADER_H__
@@ -0,0 +1,13 @@
+#ifndef __AM_UTIL_HOST_HEADER_H__
+#define __AM_UTIL_HOST_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include "am_mcu_apollo.h"
+
+
+// Host Utility Functions ----------------------------------------------------------------------------------------------
+
+void am_util_delay_ms(uint32_t ms);
+
+#endif  // #ifndef __AM_UTIL_HOST_HEADER_H__
@@ -0,0 +1,6 @@
+#ifndef __EVENT_GROUPS_HOST_HEADER_H__
+#define __EVENT_GROUPS_HOST_HEADER_H__
+
+// Intentionally empty: only required to satisfy the firmware header inclusions on the host
+
+#endif  // #ifndef __EVENT_GROUPS_HOST_HEADER_H__
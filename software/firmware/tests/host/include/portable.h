@@ -0,0 +1,6 @@
+#ifndef __PORTABLE_HOST_HEADER_H__
+#define __PORTABLE_HOST_HEADER_H__
+
+// Intentionally empty: only required to satisfy the firmware header inclusions on the host
+
+#endif  // #ifndef __PORTABLE_HOST_HEADER_H__
@@ -0,0 +1,6 @@
+#ifndef __PORTMACRO_HOST_HEADER_H__
+#define __PORTMACRO_HOST_HEADER_H__
+
+// Intentionally empty: only required to satisfy the firmware header inclusions on the host
+
+#endif  // #ifndef __PORTMACRO_HOST_HEADER_H__
@@ -0,0 +1,9 @@
+#ifndef __WSF_TYPES_HOST_HEADER_H__
+#define __WSF_TYPES_HOST_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#endif  // #ifndef __WSF_TYPES_HOST_HEADER_H__
@@ -0,0 +1,432 @@
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+#include "host_hal.h"
+#include "storage.h"
+#include "w25n01_model.h"
+
+
+// Test Configuration --------------------------------------------------------------------------------------------------
+
+#define EXPERIMENT_START_TIMESTAMP                  1700000000
+#define EXPERIMENT_END_TIMESTAMP                    (EXPERIMENT_START_TIMESTAMP + 30*86400)
+#define DATA_BLOCK_COUNT                            (MEMORY_BLOCK_COUNT - 40)
+#define DATA_CAPACITY_BYTES                         ((size_t)DATA_BLOCK_COUNT * MEMORY_PAGES_PER_BLOCK * MEMORY_NUM_DATA_BYTES_PER_PAGE)
+#define THROUGHPUT_TEST_NUM_BYTES                   (16 * 1024 * 1024)
+#define STRESS_TEST_NUM_ITERATIONS                  25
+#define BATCHING_TEST_DURATION_S                    3600
+#define BATCHING_TEST_NUM_NEIGHBORS                 4
+
+
+// Static Global Variables ---------------------------------------------------------------------------------------------
+
+static uint8_t *reference_data, *retrieved_data;
+static size_t reference_length;
+static uint32_t random_state = 0x50C1;
+static uint32_t num_failures;
+
+
+// Helper Functions ----------------------------------------------------------------------------------------------------
+
+static uint32_t next_random(void)
+{
+   random_state ^= random_state << 13;
+   random_state ^= random_state >> 17;
+   random_state ^= random_state << 5;
+   return random_state;
+}
+
+static double wall_time_s(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (double)now.tv_sec + (1e-9 * (double)now.tv_nsec);
+}
+
+static double simulated_time_ms(void)
+{
+   return 1e-6 * (double)w25n01_model_time_ns();
+}
+
+static void check(bool condition, const char *test_name, const char *description)
+{
+   if (!condition)
+   {
+      ++num_failures;
+      printf("   FAILED [%s]: %s\n", test_name, description);
+   }
+}
+
+static void check_protocol(const char *test_name)
+{
+   // Ensure that the firmware never violated the chip's command protocol
+   const w25n01_stats_t *stats = w25n01_model_stats();
+   check(!stats->busy_violations, test_name, "Command issued while the chip was busy");
+   check(!stats->protection_violations, test_name, "Array modified while write-protected");
+   check(!stats->write_enable_violations, test_name, "Array modified without a preceding Write Enable");
+   check(!stats->partial_program_violations, test_name, "Page programmed more than the allowed number of times");
+   check(!stats->sector_rewrite_violations, test_name, "Sector re-programmed with different data without an erase");
+   check(!stats->sleep_violations, test_name, "SPI transfer attempted while the IOM was asleep");
+   check(!host_num_system_resets(), test_name, "Firmware requested a system reset");
+}
+
+static void fresh_chip(void)
+{
+   // Reset the simulated chip to factory state and boot the storage driver for the first time
+   w25n01_model_format();
+   reference_length = 0;
+   storage_init();
+}
+
+static void reboot(void)
+{
+   storage_deinit();
+   w25n01_model_power_cycle();
+   storage_init();
+}
+
+static void provision_experiment(void)
+{
+   // Store a new set of active experiment details
+   experiment_details_t details = {
+      .experiment_start_time = EXPERIMENT_START_TIMESTAMP, .experiment_end_time = EXPERIMENT_END_TIMESTAMP,
+      .daily_start_time = 0, .daily_end_time = 0, .use_daily_times = 0, .num_devices = 2
+   };
+   for (uint8_t i = 0; i < details.num_devices; ++i)
+   {
+      uint8_t uid[] = { 0xc0, 0x98, 0xe5, 0x42, 0x00, i + 1 };
+      memcpy(details.uids[i], uid, EUI_LEN);
+      snprintf(details.uid_name_mappings[i], EUI_NAME_MAX_LEN, "Tag %u", (uint32_t)i);
+   }
+   host_rtc_set_timestamp(EXPERIMENT_START_TIMESTAMP + 60);
+   storage_enter_maintenance_mode();
+   storage_store_experiment_details(&details);
+   storage_exit_maintenance_mode();
+   reference_length = 0;
+}
+
+static void write_records(size_t num_bytes)
+{
+   // Write records in the same manner as the storage task, flushing one page at a time
+   uint8_t record[1 + sizeof(uint32_t) + MAX_COMPRESSED_RANGE_DATA_LENGTH];
+   for (size_t bytes_written = 0; bytes_written < num_bytes; )
+   {
+      uint32_t record_length = 6 + (next_random() % (sizeof(record) - 6));
+      if ((bytes_written + record_length) > num_bytes)
+         record_length = (uint32_t)(num_bytes - bytes_written);
+      for (uint32_t i = 0; i < record_length; ++i)
+         record[i] = (uint8_t)next_random();
+      storage_store(record, record_length);
+      storage_flush(false);
+      memcpy(reference_data + reference_length, record, record_length);
+      reference_length += record_length;
+      bytes_written += record_length;
+   }
+}
+
+static size_t read_all_records(void)
+{
+   // Retrieve all stored data through the same API used by the maintenance service
+   size_t retrieved_length = 0;
+   static uint8_t chunk[MEMORY_PAGE_SIZE_BYTES];
+   storage_enter_maintenance_mode();
+   storage_begin_reading(0);
+   const uint32_t num_chunks = storage_retrieve_num_data_chunks(0);
+   for (uint32_t i = 0; i < num_chunks; ++i)
+   {
+      const uint32_t chunk_length = storage_retrieve_next_data_chunk(chunk);
+      memcpy(retrieved_data + retrieved_length, chunk, chunk_length);
+      retrieved_length += chunk_length;
+   }
+   storage_end_reading();
+   storage_exit_maintenance_mode();
+   return retrieved_length;
+}
+
+static bool verify_all_records(void)
+{
+   const size_t retrieved_length = read_all_records();
+   return (retrieved_length == reference_length) && (memcmp(retrieved_data, reference_data, reference_length) == 0);
+}
+
+static void seed_page(uint32_t page, const char *header, uint32_t data_length)
+{
+   // Directly place stale data into the simulated memory array
+   uint8_t *contents = w25n01_model_page(page);
+   memcpy(contents, header, strlen(header));
+   if (strcmp(header, "DA") == 0)
+   {
+      *(uint16_t*)(contents + 2) = (uint16_t)data_length;
+      for (uint32_t i = 0; i < data_length; ++i)
+         contents[4 + i] = (uint8_t)next_random();
+   }
+}
+
+
+// Test and Benchmark Cases --------------------------------------------------------------------------------------------
+
+static void test_throughput_and_readback(void)
+{
+   // Measure the simulated write throughput
+   const char *test_name = "throughput";
+   fresh_chip();
+   provision_experiment();
+   w25n01_model_clear_stats();
+   double wall_start = wall_time_s(), simulated_start = simulated_time_ms();
+   write_records(THROUGHPUT_TEST_NUM_BYTES);
+   const double write_ms = simulated_time_ms() - simulated_start, write_wall_s = wall_time_s() - wall_start;
+   const w25n01_stats_t write_stats = *w25n01_model_stats();
+   check_protocol(test_name);
+
+   // Measure the simulated read throughput and verify correctness
+   simulated_start = simulated_time_ms();
+   check(verify_all_records(), test_name, "Read-back data does not match written data");
+   const double read_ms = simulated_time_ms() - simulated_start;
+   check_protocol(test_name);
+
+   printf("   Write throughput:         %8.1f KiB/s  (%.1f ms simulated, %.2f s wall, %llu programs, %llu erases, %llu IOM wakes)\n",
+         (THROUGHPUT_TEST_NUM_BYTES / 1024.0) / (write_ms / 1000.0), write_ms, write_wall_s,
+         (unsigned long long)write_stats.page_programs, (unsigned long long)write_stats.block_erases, (unsigned long long)write_stats.iom_wake_cycles);
+   printf("   Read throughput:          %8.1f KiB/s  (%.1f ms simulated)\n", (reference_length / 1024.0) / (read_ms / 1000.0), read_ms);
+}
+
+static void test_boot_scan_and_provisioning(void)
+{
+   // Measure boot scan time and re-provisioning time at several fill levels
+   const char *test_name = "boot_scan";
+   const uint32_t fill_percentages[] = { 10, 50, 90 };
+   for (uint32_t i = 0; i < sizeof(fill_percentages) / sizeof(fill_percentages[0]); ++i)
+   {
+      // Fill memory to the requested level and persist any partial page
+      fresh_chip();
+      provision_experiment();
+      write_records(DATA_CAPACITY_BYTES / 100 * fill_percentages[i]);
+      storage_flush(true);
+
+      // Time the boot scan and ensure that all data is still accessible
+      const double boot_start = simulated_time_ms();
+      reboot();
+      const double boot_ms = simulated_time_ms() - boot_start;
+      check(verify_all_records(), test_name, "Read-back data does not match written data after reboot");
+
+      // Time the re-provisioning of a new experiment
+      const double provision_start = simulated_time_ms();
+      provision_experiment();
+      const double provision_ms = simulated_time_ms() - provision_start;
+      check(verify_all_records(), test_name, "Re-provisioned storage is not empty");
+      check_protocol(test_name);
+      printf("   %2u%% full: boot scan %8.1f ms, re-provisioning %8.1f ms (simulated)\n", fill_percentages[i], boot_ms, provision_ms);
+   }
+}
+
+static void test_wraparound(void)
+{
+   // Seed a previous experiment that ends shortly before the end of memory with stale data everywhere else
+   const char *test_name = "wraparound";
+   const uint32_t previous_last_block = DATA_BLOCK_COUNT - 25;
+   w25n01_model_format();
+   storage_init();
+   storage_deinit();
+   seed_page(0, "META", 0);
+   for (uint32_t block = 1; block < DATA_BLOCK_COUNT; ++block)
+      if (block != (previous_last_block + 1))
+         for (uint32_t page = 0; page < ((block == previous_last_block) ? 10 : MEMORY_PAGES_PER_BLOCK); ++page)
+            seed_page(block * MEMORY_PAGES_PER_BLOCK + page, "DA", MEMORY_NUM_DATA_BYTES_PER_PAGE);
+   w25n01_model_power_cycle();
+   w25n01_model_clear_stats();
+   storage_init();
+
+   // Provision a new experiment and write enough data to wrap around the end of memory
+   provision_experiment();
+   write_records(40 * MEMORY_BLOCK_SIZE_BYTES);
+   check(verify_all_records(), test_name, "Read-back data does not match written data");
+   storage_flush(true);
+   reboot();
+   check(verify_all_records(), test_name, "Read-back data does not match written data after reboot");
+   check_protocol(test_name);
+}
+
+static void test_bad_block_relocation(void)
+{
+   // Start with a factory-marked bad block that must be detected on first boot
+   const char *test_name = "bad_blocks";
+   w25n01_model_format();
+   w25n01_model_inject_bad_block(5, true);
+   storage_init();
+   check(w25n01_model_num_lut_entries() == 1, test_name, "Factory-marked bad block was not remapped on first boot");
+   provision_experiment();
+
+   // Inject a program failure in the middle of a future block and a runtime bad block that already contains stale data
+   w25n01_model_inject_program_failure(3 * MEMORY_PAGES_PER_BLOCK + 17);
+   w25n01_model_inject_bad_block(8, false);
+   seed_page(8 * MEMORY_PAGES_PER_BLOCK, "DA", MEMORY_NUM_DATA_BYTES_PER_PAGE);
+   write_records(12 * MEMORY_BLOCK_SIZE_BYTES);
+   check(w25n01_model_num_lut_entries() == 3, test_name, "Runtime bad blocks were not remapped");
+   check(verify_all_records(), test_name, "Read-back data does not match written data after relocation");
+
+   // Ensure that everything is still accessible after rebooting
+   storage_flush(true);
+   reboot();
+   check(verify_all_records(), test_name, "Read-back data does not match written data after reboot");
+   check(w25n01_model_stats()->program_failures > 0, test_name, "Injected program failure was never triggered");
+   check_protocol(test_name);
+}
+
+static void test_ecc_failures(void)
+{
+   // Write several blocks of data and inject correctable and uncorrectable errors into an interior block
+   const char *test_name = "ecc";
+   fresh_chip();
+   provision_experiment();
+   write_records(6 * MEMORY_BLOCK_SIZE_BYTES);
+   const uint32_t corrupted_page_index = (2 * MEMORY_PAGES_PER_BLOCK) + 20;
+   w25n01_model_inject_ecc_status(corrupted_page_index, W25N01_ECC_UNCORRECTABLE);
+   w25n01_model_inject_ecc_status(corrupted_page_index + 1, W25N01_ECC_CORRECTED);
+
+   // Only the data from the uncorrectable page should be lost (data starts after the metadata page in block 1)
+   const size_t lost_offset = (size_t)(corrupted_page_index - MEMORY_PAGES_PER_BLOCK - 1) * MEMORY_NUM_DATA_BYTES_PER_PAGE;
+   memmove(reference_data + lost_offset, reference_data + lost_offset + MEMORY_NUM_DATA_BYTES_PER_PAGE, reference_length - lost_offset - MEMORY_NUM_DATA_BYTES_PER_PAGE);
+   reference_length -= MEMORY_NUM_DATA_BYTES_PER_PAGE;
+   check(verify_all_records(), test_name, "Read-back data is incorrect around an ECC failure");
+   check(w25n01_model_stats()->ecc_failures > 0, test_name, "Injected ECC failure was never triggered");
+   check_protocol(test_name);
+}
+
+static void test_partial_flushes(void)
+{
+   // Repeatedly force partial-page flushes followed by more data, as happens when flushing without shutting down
+   const char *test_name = "partial_flush";
+   fresh_chip();
+   provision_experiment();
+   for (uint32_t i = 0; i < 40; ++i)
+   {
+      write_records(100 + (next_random() % (2 * MEMORY_PAGE_SIZE_BYTES)));
+      storage_flush(true);
+   }
+   write_records(3 * MEMORY_BLOCK_SIZE_BYTES);
+   check(verify_all_records(), test_name, "Read-back data does not match written data after partial flushes");
+
+   // Ensure that partially-programmed pages remain readable after a reboot
+   storage_flush(true);
+   reboot();
+   check(verify_all_records(), test_name, "Read-back data does not match written data after reboot");
+   check(!w25n01_model_stats()->ecc_failures, test_name, "Partial flushes corrupted the ECC of previously-programmed data");
+   check_protocol(test_name);
+}
+
+static void test_batched_commits(void)
+{
+   // Simulate one hour of ranging at 2 Hz with periodic battery readings, draining the queue like the storage task
+   const char *test_name = "batching";
+   fresh_chip();
+   provision_experiment();
+   w25n01_model_clear_stats();
+   uint32_t num_records = 0, num_bytes = 0;
+   uint8_t record[1 + sizeof(uint32_t) + MAX_COMPRESSED_RANGE_DATA_LENGTH];
+   for (uint32_t half_seconds = 0; half_seconds < (2 * BATCHING_TEST_DURATION_S); ++half_seconds)
+   {
+      // Generate a ranging record
+      const uint32_t timestamp = 500 * half_seconds;
+      host_rtc_set_timestamp(EXPERIMENT_START_TIMESTAMP + 60 + (half_seconds / 2));
+      record[0] = STORAGE_TYPE_RANGES;
+      memcpy(record + 1, &timestamp, sizeof(timestamp));
+      record[5] = BATCHING_TEST_NUM_NEIGHBORS;
+      uint32_t record_length = 6;
+      for (uint32_t i = 0; i < BATCHING_TEST_NUM_NEIGHBORS; ++i, record_length += COMPRESSED_RANGE_DATUM_LENGTH)
+      {
+         const int16_t range_mm = (int16_t)(500 + (next_random() % 3000));
+         record[record_length] = (uint8_t)(i + 1);
+         memcpy(record + record_length + 1, &range_mm, sizeof(range_mm));
+      }
+      storage_store(record, record_length);
+      memcpy(reference_data + reference_length, record, record_length);
+      reference_length += record_length;
+      num_bytes += record_length;
+      ++num_records;
+
+      // Generate a battery voltage record at the configured interval
+      if ((half_seconds % (2 * BATTERY_CHECK_INTERVAL_S)) == 0)
+      {
+         const uint32_t voltage_mV = 3900;
+         record[0] = STORAGE_TYPE_VOLTAGE;
+         memcpy(record + 1, &timestamp, sizeof(timestamp));
+         memcpy(record + 5, &voltage_mV, sizeof(voltage_mV));
+         storage_store(record, 9);
+         memcpy(reference_data + reference_length, record, 9);
+         reference_length += 9;
+         num_bytes += 9;
+         ++num_records;
+      }
+      storage_flush(false);
+   }
+
+   // Report the storage activity per hour and per stored byte
+   const w25n01_stats_t stats = *w25n01_model_stats();
+   printf("   Batch size %u pages, max latency %u s: %llu IOM wake cycles/hour, %.2f ms IOM awake/hour, %.3f SPI transactions/record, %.3f SPI bytes/stored byte\n",
+         STORAGE_BATCH_NUM_PAGES, STORAGE_BATCH_MAX_LATENCY_S, (unsigned long long)(stats.iom_wake_cycles * 3600 / BATCHING_TEST_DURATION_S),
+         1e-6 * (double)stats.iom_awake_time_ns * 3600.0 / BATCHING_TEST_DURATION_S, (double)stats.transactions / num_records, (double)stats.bytes_transferred / num_bytes);
+   check(stats.iom_wake_cycles <= (1 + ((num_bytes / MEMORY_NUM_DATA_BYTES_PER_PAGE) / STORAGE_BATCH_NUM_PAGES) + (BATCHING_TEST_DURATION_S / STORAGE_BATCH_MAX_LATENCY_S)), test_name, "Too many IOM wake cycles for the configured batch size");
+   check(verify_all_records(), test_name, "Read-back data does not match written data");
+   check_protocol(test_name);
+}
+
+static void test_random_power_cycles(void)
+{
+   // Repeatedly write random amounts of data with random program failures and flush-on-shutdown reboots
+   const char *test_name = "stress";
+   fresh_chip();
+   provision_experiment();
+   for (uint32_t i = 0; i < STRESS_TEST_NUM_ITERATIONS; ++i)
+   {
+      if ((next_random() % 4) == 0)
+         w25n01_model_inject_program_failure((next_random() % (DATA_BLOCK_COUNT / 16)) * MEMORY_PAGES_PER_BLOCK + (next_random() % MEMORY_PAGES_PER_BLOCK));
+      write_records(next_random() % (3 * MEMORY_BLOCK_SIZE_BYTES));
+      storage_flush(true);
+      reboot();
+      check(verify_all_records(), test_name, "Read-back data does not match written data after a power cycle");
+   }
+   check_protocol(test_name);
+}
+
+
+// Main Test Function --------------------------------------------------------------------------------------------------
+
+int main(void)
+{
+   // Allocate the simulated chip and all reference buffers
+   w25n01_model_init();
+   reference_data = (uint8_t*)malloc(DATA_CAPACITY_BYTES + MEMORY_PAGE_SIZE_BYTES);
+   retrieved_data = (uint8_t*)malloc(DATA_CAPACITY_BYTES + MEMORY_PAGE_SIZE_BYTES);
+   if (!reference_data || !retrieved_data)
+   {
+      printf("ERROR: Unable to allocate test buffers\n");
+      return EXIT_FAILURE;
+   }
+
+   // Run all storage tests and benchmarks
+   printf("Throughput and read-back correctness:\n");
+   test_throughput_and_readback();
+   printf("Boot scan and re-provisioning:\n");
+   test_boot_scan_and_provisioning();
+   printf("Wrap-around with stale data:\n");
+   test_wraparound();
+   printf("Bad block relocation:\n");
+   test_bad_block_relocation();
+   printf("ECC failures:\n");
+   test_ecc_failures();
+   printf("Partial page flushes:\n");
+   test_partial_flushes();
+   printf("Batched commits:\n");
+   test_batched_commits();
+   printf("Random power cycles:\n");
+   test_random_power_cycles();
+
+   // Clean up and report the overall result
+   storage_deinit();
+   w25n01_model_deinit();
+   free(reference_data);
+   free(retrieved_data);
+   printf("\n%s: %u failure(s)\n", num_failures ? "FAILED" : "PASSED", num_failures);
+   return num_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,602 @@
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "am_mcu_apollo.h"
+#include "w25n01_model.h"
+
+
+// Simulated Chip Definitions ------------------------------------------------------------------------------------------
+
+#define W25N01_MANUFACTURER_ID                      0xEF
+#define W25N01_DEVICE_ID_MSB                        0xBA
+#define W25N01_DEVICE_ID_LSB                        0x21
+#define W25N01_SECTOR_SIZE_BYTES                    512
+#define W25N01_SECTORS_PER_PAGE                     (W25N01_PAGE_SIZE_BYTES / W25N01_SECTOR_SIZE_BYTES)
+#define W25N01_BUFFER_SIZE_BYTES                    (W25N01_PAGE_SIZE_BYTES + W25N01_SPARE_SIZE_BYTES)
+#define W25N01_MAX_FRAME_SIZE_BYTES                 (4 + W25N01_BUFFER_SIZE_BYTES)
+
+#define COMMAND_READ_DEVICE_ID                      0x9F
+#define COMMAND_DEVICE_RESET                        0xFF
+#define COMMAND_READ_STATUS_REGISTER                0x0F
+#define COMMAND_WRITE_STATUS_REGISTER               0x1F
+#define COMMAND_WRITE_ENABLE                        0x06
+#define COMMAND_WRITE_DISABLE                       0x04
+#define COMMAND_BLOCK_ERASE                         0xD8
+#define COMMAND_PROGRAM_DATA_LOAD                   0x02
+#define COMMAND_RANDOM_PROGRAM_DATA_LOAD            0x84
+#define COMMAND_PROGRAM_EXECUTE                     0x10
+#define COMMAND_PAGE_DATA_READ                      0x13
+#define COMMAND_READ                                0x03
+#define COMMAND_WRITE_BBM_LUT                       0xA1
+#define COMMAND_READ_BBM_LUT                        0xA5
+
+#define STATUS_REGISTER_1                           0xA0
+#define STATUS_REGISTER_2                           0xB0
+#define STATUS_REGISTER_3                           0xC0
+
+#define SR1_BLOCK_PROTECT_BITS                      0b01111000
+#define SR1_WRITE_PROTECT_ENABLE                    0b00000010
+#define SR1_DEFAULT_VALUE                           0b01111100
+#define SR2_OTP_ENABLE                              0b01000000
+#define SR2_ECC_ENABLE                              0b00010000
+#define SR2_DEFAULT_VALUE                           0b00011000
+#define SR3_LUT_FULL                                0b01000000
+#define SR3_ECC_BITS                                0b00110000
+#define SR3_ECC_UNCORRECTABLE                       0b00100000
+#define SR3_ECC_CORRECTED                           0b00010000
+#define SR3_PROGRAM_FAILURE                         0b00001000
+#define SR3_ERASE_FAILURE                           0b00000100
+#define SR3_WRITE_ENABLE_LATCH                      0b00000010
+#define SR3_BUSY                                    0b00000001
+
+#define LUT_ENTRY_ENABLED                           0x8000
+
+
+// Static Global Variables ---------------------------------------------------------------------------------------------
+
+static uint8_t *memory_array, *program_counts, *programmed_sectors, *injected_ecc_status, *natural_ecc_status, *injected_program_failures;
+static uint8_t bad_blocks[W25N01_BLOCK_COUNT], otp_array[W25N01_OTP_PAGE_COUNT][W25N01_PAGE_SIZE_BYTES];
+static uint8_t data_buffer[W25N01_BUFFER_SIZE_BYTES], frame[W25N01_MAX_FRAME_SIZE_BYTES];
+static struct { uint16_t lba, pba; } lut[W25N01_LUT_NUM_ENTRIES];
+static uint32_t frame_length, num_lut_entries;
+static uint8_t status_register_1, status_register_2, status_register_3;
+static uint64_t current_time_ns, busy_until_ns, iom_wake_time_ns;
+static bool write_protect_pin_high, iom_initialized, iom_awake;
+static w25n01_stats_t stats;
+
+
+// Private Helper Functions --------------------------------------------------------------------------------------------
+
+static bool is_busy(void)
+{
+   return current_time_ns < busy_until_ns;
+}
+
+static void set_busy(uint64_t duration_ns)
+{
+   busy_until_ns = current_time_ns + duration_ns;
+}
+
+static bool is_array_protected(void)
+{
+   // Any block protection bits or an asserted hardware write-protect pin will block all array modifications
+   return (status_register_1 & SR1_BLOCK_PROTECT_BITS) ||
+          ((status_register_1 & SR1_WRITE_PROTECT_ENABLE) && !write_protect_pin_high);
+}
+
+static uint32_t map_block(uint32_t logical_block)
+{
+   // Redirect the block through the bad block lookup table
+   for (uint32_t i = 0; i < num_lut_entries; ++i)
+      if ((lut[i].lba & ~LUT_ENTRY_ENABLED) == logical_block)
+         return lut[i].pba;
+   return logical_block;
+}
+
+static uint32_t map_page(uint32_t page_address)
+{
+   page_address %= W25N01_PAGE_COUNT;
+   return (map_block(page_address / W25N01_PAGES_PER_BLOCK) * W25N01_PAGES_PER_BLOCK) + (page_address % W25N01_PAGES_PER_BLOCK);
+}
+
+static uint32_t frame_page_address(void)
+{
+   // Page addresses are sent as a dummy byte followed by a 16-bit big-endian page number
+   return ((uint32_t)frame[2] << 8) | frame[3];
+}
+
+static bool check_write_enabled(void)
+{
+   if ((status_register_3 & SR3_WRITE_ENABLE_LATCH) == 0)
+   {
+      ++stats.write_enable_violations;
+      return false;
+   }
+   return true;
+}
+
+static void page_data_read(uint32_t page_address)
+{
+   // Load the requested page into the data buffer and update the ECC status bits
+   ++stats.page_reads;
+   status_register_3 &= ~SR3_ECC_BITS;
+   if (status_register_2 & SR2_OTP_ENABLE)
+   {
+      memset(data_buffer, 0xFF, sizeof(data_buffer));
+      if (page_address < W25N01_OTP_PAGE_COUNT)
+         memcpy(data_buffer, otp_array[page_address], W25N01_PAGE_SIZE_BYTES);
+   }
+   else
+   {
+      const uint32_t physical_page = map_page(page_address);
+      memcpy(data_buffer, memory_array + ((size_t)physical_page * W25N01_PAGE_SIZE_BYTES), W25N01_PAGE_SIZE_BYTES);
+      memset(data_buffer + W25N01_PAGE_SIZE_BYTES, 0xFF, W25N01_SPARE_SIZE_BYTES);
+      const uint8_t ecc_status = (injected_ecc_status[physical_page] > natural_ecc_status[physical_page]) ? injected_ecc_status[physical_page] : natural_ecc_status[physical_page];
+      if ((status_register_2 & SR2_ECC_ENABLE) && (ecc_status == W25N01_ECC_UNCORRECTABLE))
+      {
+         ++stats.ecc_failures;
+         status_register_3 |= SR3_ECC_UNCORRECTABLE;
+      }
+      else if ((status_register_2 & SR2_ECC_ENABLE) && (ecc_status == W25N01_ECC_CORRECTED))
+         status_register_3 |= SR3_ECC_CORRECTED;
+   }
+   set_busy(W25N01_PAGE_READ_TIME_NS);
+}
+
+static void program_execute(uint32_t page_address)
+{
+   // Ensure that programming is currently allowed
+   if (!check_write_enabled())
+      return;
+   status_register_3 &= ~(SR3_WRITE_ENABLE_LATCH | SR3_PROGRAM_FAILURE);
+   set_busy(W25N01_PAGE_PROGRAM_TIME_NS);
+   if (is_array_protected() && !(status_register_2 & SR2_OTP_ENABLE))
+   {
+      ++stats.protection_violations;
+      return;
+   }
+
+   // Program the OTP area if requested, which is only protected by the hardware write-protect pin
+   ++stats.page_programs;
+   if (status_register_2 & SR2_OTP_ENABLE)
+   {
+      if ((status_register_1 & SR1_WRITE_PROTECT_ENABLE) && !write_protect_pin_high)
+         ++stats.protection_violations;
+      else if (page_address < W25N01_OTP_PAGE_COUNT)
+         for (uint32_t i = 0; i < W25N01_PAGE_SIZE_BYTES; ++i)
+            otp_array[page_address][i] &= data_buffer[i];
+      return;
+   }
+
+   // Simulate a programming failure for bad blocks
+   const uint32_t physical_page = map_page(page_address);
+   if (bad_blocks[physical_page / W25N01_PAGES_PER_BLOCK] || injected_program_failures[physical_page])
+   {
+      ++stats.program_failures;
+      status_register_3 |= SR3_PROGRAM_FAILURE;
+      return;
+   }
+
+   // Program each non-blank sector, corrupting the ECC of any sector that is re-programmed with different data
+   uint8_t *page = memory_array + ((size_t)physical_page * W25N01_PAGE_SIZE_BYTES);
+   if (++program_counts[physical_page] > W25N01_MAX_PARTIAL_PROGRAMS)
+      ++stats.partial_program_violations;
+   for (uint32_t sector = 0; sector < W25N01_SECTORS_PER_PAGE; ++sector)
+   {
+      bool sector_blank = true, sector_changed = false;
+      const uint32_t offset = sector * W25N01_SECTOR_SIZE_BYTES;
+      for (uint32_t i = offset; i < (offset + W25N01_SECTOR_SIZE_BYTES); ++i)
+      {
+         sector_blank = sector_blank && (data_buffer[i] == 0xFF);
+         sector_changed = sector_changed || ((page[i] & data_buffer[i]) != page[i]);
+         page[i] &= data_buffer[i];
+      }
+      if (!sector_blank)
+      {
+         if ((programmed_sectors[physical_page] & (1 << sector)) && sector_changed)
+         {
+            ++stats.sector_rewrite_violations;
+            natural_ecc_status[physical_page] = W25N01_ECC_UNCORRECTABLE;
+         }
+         programmed_sectors[physical_page] |= (1 << sector);
+      }
+   }
+}
+
+static void block_erase(uint32_t page_address)
+{
+   // Ensure that erasing is currently allowed
+   if (!check_write_enabled())
+      return;
+   status_register_3 &= ~(SR3_WRITE_ENABLE_LATCH | SR3_ERASE_FAILURE);
+   set_busy(W25N01_BLOCK_ERASE_TIME_NS);
+   if (is_array_protected())
+   {
+      ++stats.protection_violations;
+      return;
+   }
+
+   // Simulate an erase failure for bad blocks or reset the entire block
+   ++stats.block_erases;
+   const uint32_t physical_block = map_block((page_address % W25N01_PAGE_COUNT) / W25N01_PAGES_PER_BLOCK);
+   if (bad_blocks[physical_block])
+   {
+      ++stats.erase_failures;
+      status_register_3 |= SR3_ERASE_FAILURE;
+      return;
+   }
+   const uint32_t first_page = physical_block * W25N01_PAGES_PER_BLOCK;
+   memset(memory_array + ((size_t)first_page * W25N01_PAGE_SIZE_BYTES), 0xFF, W25N01_PAGES_PER_BLOCK * W25N01_PAGE_SIZE_BYTES);
+   memset(program_counts + first_page, 0, W25N01_PAGES_PER_BLOCK);
+   memset(programmed_sectors + first_page, 0, W25N01_PAGES_PER_BLOCK);
+   memset(natural_ecc_status + first_page, 0, W25N01_PAGES_PER_BLOCK);
+}
+
+static void write_bbm_lut(void)
+{
+   // Add a new link to the bad block lookup table if there is space available
+   if (!check_write_enabled())
+      return;
+   status_register_3 &= ~SR3_WRITE_ENABLE_LATCH;
+   set_busy(W25N01_PAGE_PROGRAM_TIME_NS);
+   ++stats.lut_writes;
+   if (num_lut_entries < W25N01_LUT_NUM_ENTRIES)
+   {
+      lut[num_lut_entries].lba = (uint16_t)((((uint16_t)frame[1] << 8) | frame[2]) & 0x03FF);
+      lut[num_lut_entries].pba = (uint16_t)((((uint16_t)frame[3] << 8) | frame[4]) & 0x03FF);
+      ++num_lut_entries;
+   }
+   if (num_lut_entries == W25N01_LUT_NUM_ENTRIES)
+      status_register_3 |= SR3_LUT_FULL;
+}
+
+static void load_program_data(bool reset_buffer)
+{
+   // Copy the incoming data into the data buffer at the requested column address
+   if (!check_write_enabled())
+      return;
+   if (reset_buffer)
+      memset(data_buffer, 0xFF, sizeof(data_buffer));
+   const uint32_t column = (((uint32_t)frame[1] << 8) | frame[2]) % W25N01_BUFFER_SIZE_BYTES;
+   const uint32_t num_bytes = (frame_length > 3) ? (frame_length - 3) : 0;
+   for (uint32_t i = 0; (i < num_bytes) && ((column + i) < W25N01_BUFFER_SIZE_BYTES); ++i)
+      data_buffer[column + i] = frame[3 + i];
+}
+
+static void write_status_register(void)
+{
+   // Update the requested status register if not write-protected
+   if (frame_length < 3)
+      return;
+   if (frame[1] == STATUS_REGISTER_1)
+   {
+      if ((status_register_1 & SR1_WRITE_PROTECT_ENABLE) && !write_protect_pin_high)
+         ++stats.protection_violations;
+      else
+         status_register_1 = frame[2];
+   }
+   else if (frame[1] == STATUS_REGISTER_2)
+      status_register_2 = frame[2];
+}
+
+static void reset_registers(void)
+{
+   // Restore all volatile chip state to its power-on defaults
+   status_register_1 = SR1_DEFAULT_VALUE;
+   status_register_2 = SR2_DEFAULT_VALUE;
+   status_register_3 = (num_lut_entries == W25N01_LUT_NUM_ENTRIES) ? SR3_LUT_FULL : 0;
+   frame_length = 0;
+   memcpy(data_buffer, memory_array, W25N01_PAGE_SIZE_BYTES);
+   memset(data_buffer + W25N01_PAGE_SIZE_BYTES, 0xFF, W25N01_SPARE_SIZE_BYTES);
+}
+
+static void execute_write_frame(void)
+{
+   // Only status reads and resets are accepted while the chip is busy
+   if (!frame_length)
+      return;
+   if (is_busy() && (frame[0] != COMMAND_DEVICE_RESET))
+   {
+      ++stats.busy_violations;
+      return;
+   }
+
+   // Carry out the requested command
+   switch (frame[0])
+   {
+      case COMMAND_DEVICE_RESET:
+         reset_registers();
+         set_busy(W25N01_RESET_TIME_NS);
+         break;
+      case COMMAND_WRITE_STATUS_REGISTER:
+         write_status_register();
+         break;
+      case COMMAND_WRITE_ENABLE:
+         status_register_3 |= SR3_WRITE_ENABLE_LATCH;
+         break;
+      case COMMAND_WRITE_DISABLE:
+         status_register_3 &= ~SR3_WRITE_ENABLE_LATCH;
+         break;
+      case COMMAND_BLOCK_ERASE:
+         block_erase(frame_page_address());
+         break;
+      case COMMAND_PROGRAM_DATA_LOAD:
+         load_program_data(true);
+         break;
+      case COMMAND_RANDOM_PROGRAM_DATA_LOAD:
+         load_program_data(false);
+         break;
+      case COMMAND_PROGRAM_EXECUTE:
+         program_execute(frame_page_address());
+         break;
+      case COMMAND_PAGE_DATA_READ:
+         page_data_read(frame_page_address());
+         break;
+      case COMMAND_WRITE_BBM_LUT:
+         write_bbm_lut();
+         break;
+      default:
+         break;
+   }
+}
+
+static void execute_read_frame(uint8_t *read_buffer, uint32_t read_length)
+{
+   // Unknown or busy reads return all ones
+   memset(read_buffer, 0xFF, read_length);
+   if (!frame_length)
+      return;
+   if (is_busy() && (frame[0] != COMMAND_READ_STATUS_REGISTER))
+   {
+      ++stats.busy_violations;
+      return;
+   }
+
+   // Carry out the requested command
+   switch (frame[0])
+   {
+      case COMMAND_READ_DEVICE_ID:
+      {
+         const uint8_t device_id[] = { 0x00, W25N01_MANUFACTURER_ID, W25N01_DEVICE_ID_MSB, W25N01_DEVICE_ID_LSB };
+         memcpy(read_buffer, device_id, (read_length < sizeof(device_id)) ? read_length : sizeof(device_id));
+         break;
+      }
+      case COMMAND_READ_STATUS_REGISTER:
+         if (read_length && (frame_length > 1))
+         {
+            if (frame[1] == STATUS_REGISTER_1)
+               read_buffer[0] = status_register_1;
+            else if (frame[1] == STATUS_REGISTER_2)
+               read_buffer[0] = status_register_2;
+            else if (frame[1] == STATUS_REGISTER_3)
+               read_buffer[0] = status_register_3 | (is_busy() ? SR3_BUSY : 0);
+         }
+         break;
+      case COMMAND_READ:
+      {
+         const uint32_t column = (frame_length > 2) ? ((((uint32_t)frame[1] << 8) | frame[2]) % W25N01_BUFFER_SIZE_BYTES) : 0;
+         for (uint32_t i = 0; (i < read_length) && ((column + i) < W25N01_BUFFER_SIZE_BYTES); ++i)
+            read_buffer[i] = data_buffer[column + i];
+         break;
+      }
+      case COMMAND_READ_BBM_LUT:
+         memset(read_buffer, 0, read_length);
+         for (uint32_t i = 0; (i < num_lut_entries) && ((4 * i + 3) < read_length); ++i)
+         {
+            const uint16_t lba = lut[i].lba | LUT_ENTRY_ENABLED;
+            read_buffer[4 * i + 0] = (uint8_t)(lba >> 8);
+            read_buffer[4 * i + 1] = (uint8_t)(lba & 0xFF);
+            read_buffer[4 * i + 2] = (uint8_t)(lut[i].pba >> 8);
+            read_buffer[4 * i + 3] = (uint8_t)(lut[i].pba & 0xFF);
+         }
+         break;
+      default:
+         break;
+   }
+}
+
+
+// Public API Functions ------------------------------------------------------------------------------------------------
+
+void w25n01_model_init(void)
+{
+   // Allocate the simulated memory array and all per-page metadata
+   memory_array = (uint8_t*)malloc((size_t)W25N01_PAGE_COUNT * W25N01_PAGE_SIZE_BYTES);
+   program_counts = (uint8_t*)malloc(W25N01_PAGE_COUNT);
+   programmed_sectors = (uint8_t*)malloc(W25N01_PAGE_COUNT);
+   injected_ecc_status = (uint8_t*)malloc(W25N01_PAGE_COUNT);
+   natural_ecc_status = (uint8_t*)malloc(W25N01_PAGE_COUNT);
+   injected_program_failures = (uint8_t*)malloc(W25N01_PAGE_COUNT);
+   if (!memory_array || !program_counts || !programmed_sectors || !injected_ecc_status || !natural_ecc_status || !injected_program_failures)
+   {
+      fprintf(stderr, "ERROR: Unable to allocate the simulated W25N01 memory array\n");
+      exit(EXIT_FAILURE);
+   }
+   current_time_ns = busy_until_ns = 0;
+   w25n01_model_format();
+}
+
+void w25n01_model_deinit(void)
+{
+   free(memory_array);
+   free(program_counts);
+   free(programmed_sectors);
+   free(injected_ecc_status);
+   free(natural_ecc_status);
+   free(injected_program_failures);
+   memory_array = program_counts = programmed_sectors = injected_ecc_status = natural_ecc_status = injected_program_failures = NULL;
+}
+
+void w25n01_model_format(void)
+{
+   // Return the chip to its factory-fresh state
+   memset(memory_array, 0xFF, (size_t)W25N01_PAGE_COUNT * W25N01_PAGE_SIZE_BYTES);
+   memset(program_counts, 0, W25N01_PAGE_COUNT);
+   memset(programmed_sectors, 0, W25N01_PAGE_COUNT);
+   memset(natural_ecc_status, 0, W25N01_PAGE_COUNT);
+   memset(otp_array, 0xFF, sizeof(otp_array));
+   memset(lut, 0, sizeof(lut));
+   num_lut_entries = 0;
+   w25n01_model_clear_faults();
+   w25n01_model_clear_stats();
+   w25n01_model_power_cycle();
+}
+
+void w25n01_model_power_cycle(void)
+{
+   // Reset all volatile state while retaining the memory array, OTP area, and lookup table
+   reset_registers();
+   busy_until_ns = current_time_ns;
+   write_protect_pin_high = iom_initialized = iom_awake = false;
+}
+
+void w25n01_model_inject_bad_block(uint32_t physical_block, bool factory_marked)
+{
+   // Mark the block as failing all program and erase operations
+   physical_block %= W25N01_BLOCK_COUNT;
+   bad_blocks[physical_block] = 1;
+   if (factory_marked)
+      memory_array[(size_t)physical_block * W25N01_PAGES_PER_BLOCK * W25N01_PAGE_SIZE_BYTES] = 0x00;
+}
+
+void w25n01_model_inject_program_failure(uint32_t physical_page)
+{
+   injected_program_failures[physical_page % W25N01_PAGE_COUNT] = 1;
+}
+
+void w25n01_model_inject_ecc_status(uint32_t physical_page, w25n01_ecc_status_t status)
+{
+   injected_ecc_status[physical_page % W25N01_PAGE_COUNT] = (uint8_t)status;
+}
+
+void w25n01_model_clear_faults(void)
+{
+   memset(bad_blocks, 0, sizeof(bad_blocks));
+   memset(injected_ecc_status, 0, W25N01_PAGE_COUNT);
+   memset(injected_program_failures, 0, W25N01_PAGE_COUNT);
+}
+
+uint8_t* w25n01_model_page(uint32_t physical_page)
+{
+   return memory_array + ((size_t)(physical_page % W25N01_PAGE_COUNT) * W25N01_PAGE_SIZE_BYTES);
+}
+
+uint32_t w25n01_model_page_program_count(uint32_t physical_page)
+{
+   return program_counts[physical_page % W25N01_PAGE_COUNT];
+}
+
+uint32_t w25n01_model_num_lut_entries(void)
+{
+   return num_lut_entries;
+}
+
+uint32_t w25n01_model_map_block(uint32_t logical_block)
+{
+   return map_block(logical_block % W25N01_BLOCK_COUNT);
+}
+
+uint64_t w25n01_model_time_ns(void)
+{
+   return current_time_ns;
+}
+
+void w25n01_model_advance_time_ns(uint64_t ns)
+{
+   current_time_ns += ns;
+}
+
+const w25n01_stats_t* w25n01_model_stats(void)
+{
+   return &stats;
+}
+
+void w25n01_model_clear_stats(void)
+{
+   memset(&stats, 0, sizeof(stats));
+   iom_wake_time_ns = current_time_ns;
+}
+
+void w25n01_model_set_write_protect_pin(bool high)
+{
+   write_protect_pin_high = high;
+}
+
+
+// Simulated IOM HAL Functions -----------------------------------------------------------------------------------------
+
+uint32_t am_hal_iom_initialize(uint32_t module, void **handle)
+{
+   static uint32_t iom_instance;
+   iom_instance = module;
+   *handle = &iom_instance;
+   iom_initialized = true;
+   return AM_HAL_STATUS_SUCCESS;
+}
+
+uint32_t am_hal_iom_uninitialize(void *handle)
+{
+   iom_initialized = iom_awake = false;
+   return AM_HAL_STATUS_SUCCESS;
+}
+
+uint32_t am_hal_iom_configure(void *handle, const am_hal_iom_config_t *config)
+{
+   return iom_initialized ? AM_HAL_STATUS_SUCCESS : AM_HAL_STATUS_INVALID_OPERATION;
+}
+
+uint32_t am_hal_iom_enable(void *handle)
+{
+   return iom_initialized ? AM_HAL_STATUS_SUCCESS : AM_HAL_STATUS_INVALID_OPERATION;
+}
+
+uint32_t am_hal_iom_power_ctrl(void *handle, am_hal_sysctrl_power_state_e power_state, bool retain_state)
+{
+   // Keep track of the number of times and the duration that the IOM peripheral is awake
+   if ((power_state == AM_HAL_SYSCTRL_WAKE) && !iom_awake)
+   {
+      ++stats.iom_wake_cycles;
+      iom_wake_time_ns = current_time_ns;
+   }
+   else if ((power_state != AM_HAL_SYSCTRL_WAKE) && iom_awake)
+      stats.iom_awake_time_ns += current_time_ns - iom_wake_time_ns;
+   iom_awake = (power_state == AM_HAL_SYSCTRL_WAKE);
+   return AM_HAL_STATUS_SUCCESS;
+}
+
+uint32_t am_hal_iom_blocking_transfer(void *handle, am_hal_iom_transfer_t *transaction)
+{
+   // Transfers are not possible while the IOM peripheral is asleep
+   if (!iom_initialized || !iom_awake)
+   {
+      ++stats.sleep_violations;
+      return AM_HAL_STATUS_INVALID_OPERATION;
+   }
+
+   // Account for the time spent clocking data over the SPI bus
+   ++stats.transactions;
+   stats.bytes_transferred += transaction->ui32NumBytes;
+   current_time_ns += W25N01_TRANSACTION_OVERHEAD_NS + (((uint64_t)transaction->ui32NumBytes * 8 * 1000000000ULL) / W25N01_SPI_CLOCK_HZ);
+
+   // Accumulate outgoing bytes until chip-select is released or respond to an incoming read
+   if (transaction->eDirection == AM_HAL_IOM_TX)
+   {
+      const uint8_t *tx_buffer = (const uint8_t*)transaction->pui32TxBuffer;
+      for (uint32_t i = 0; tx_buffer && (i < transaction->ui32NumBytes) && (frame_length < sizeof(frame)); ++i)
+         frame[frame_length++] = tx_buffer[i];
+      if (!transaction->bContinue)
+      {
+         execute_write_frame();
+         frame_length = 0;
+      }
+   }
+   else
+   {
+      execute_read_frame((uint8_t*)transaction->pui32RxBuffer, transaction->ui32NumBytes);
+      if (!transaction->bContinue)
+         frame_length = 0;
+   }
+   return AM_HAL_STATUS_SUCCESS;
+}
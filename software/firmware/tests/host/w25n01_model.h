@@ -0,0 +1,71 @@
+#ifndef __W25N01_MODEL_HEADER_H__
+#define __W25N01_MODEL_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Simulated Chip Definitions ------------------------------------------------------------------------------------------
+
+#define W25N01_PAGE_SIZE_BYTES                      2048
+#define W25N01_SPARE_SIZE_BYTES                     64
+#define W25N01_PAGES_PER_BLOCK                      64
+#define W25N01_BLOCK_COUNT                          1024
+#define W25N01_PAGE_COUNT                           (W25N01_PAGES_PER_BLOCK * W25N01_BLOCK_COUNT)
+#define W25N01_OTP_PAGE_COUNT                       12
+#define W25N01_LUT_NUM_ENTRIES                      20
+#define W25N01_MAX_PARTIAL_PROGRAMS                 4
+
+#define W25N01_SPI_CLOCK_HZ                         48000000
+#define W25N01_TRANSACTION_OVERHEAD_NS              1000
+#define W25N01_PAGE_READ_TIME_NS                    60000
+#define W25N01_PAGE_PROGRAM_TIME_NS                 250000
+#define W25N01_BLOCK_ERASE_TIME_NS                  2000000
+#define W25N01_RESET_TIME_NS                        500000
+
+
+// Simulated Chip Data Types -------------------------------------------------------------------------------------------
+
+typedef enum { W25N01_ECC_OK = 0, W25N01_ECC_CORRECTED, W25N01_ECC_UNCORRECTABLE } w25n01_ecc_status_t;
+
+typedef struct
+{
+   uint64_t page_reads, page_programs, block_erases, lut_writes;
+   uint64_t bytes_transferred, transactions, iom_wake_cycles, iom_awake_time_ns;
+   uint64_t program_failures, erase_failures, ecc_failures;
+   uint64_t busy_violations, protection_violations, write_enable_violations, partial_program_violations, sector_rewrite_violations, sleep_violations;
+} w25n01_stats_t;
+
+
+// Public API Functions ------------------------------------------------------------------------------------------------
+
+// Chip lifetime management
+void w25n01_model_init(void);
+void w25n01_model_deinit(void);
+void w25n01_model_format(void);
+void w25n01_model_power_cycle(void);
+
+// Fault injection
+void w25n01_model_inject_bad_block(uint32_t physical_block, bool factory_marked);
+void w25n01_model_inject_program_failure(uint32_t physical_page);
+void w25n01_model_inject_ecc_status(uint32_t physical_page, w25n01_ecc_status_t status);
+void w25n01_model_clear_faults(void);
+
+// Direct array access for seeding and verification
+uint8_t* w25n01_model_page(uint32_t physical_page);
+uint32_t w25n01_model_page_program_count(uint32_t physical_page);
+uint32_t w25n01_model_num_lut_entries(void);
+uint32_t w25n01_model_map_block(uint32_t logical_block);
+
+// Simulated time and statistics
+uint64_t w25n01_model_time_ns(void);
+void w25n01_model_advance_time_ns(uint64_t ns);
+const w25n01_stats_t* w25n01_model_stats(void);
+void w25n01_model_clear_stats(void);
+
+// GPIO hook used to track the state of the hardware write-protect pin
+void w25n01_model_set_write_protect_pin(bool high);
+
+#endif  // #ifndef __W25N01_MODEL_HEADER_H__
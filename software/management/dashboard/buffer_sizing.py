@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import argparse, asyncio, math, re
+from bleak import BleakClient
+try:
+   from .tottag import MAINTENANCE_BUFFER_STATUS_SERVICE_UUID, unpack_buffer_status
+except ImportError:
+   from tottag import MAINTENANCE_BUFFER_STATUS_SERVICE_UUID, unpack_buffer_status
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+WSF_BUF_POOL_OVERHEAD = 20
+WSF_BUF_ALIGNMENT = 8                  # sizeof(wsfBufMem_t), since WsfBufInit rounds every pool length up to a multiple of it
+WSF_BUF_ALIGNMENT_NO_FREE_CHECK = 4    # sizeof(wsfBufMem_t) when built with WSF_BUF_FREE_CHECK=FALSE
+MAX_BUFFERS_PER_POOL = 255
+SWO_POOL_PATTERN = re.compile(r'WSF Pool (\d+): Length = (\d+), Buffers = (\d+), Allocated = (\d+), Peak = (\d+), Max Request = (\d+), Failures = (\d+)')
+
+
+# USAGE RECORDING -----------------------------------------------------------------------------------------------------
+
+def parse_swo_log(path):
+   # Every run of pool lines starting at pool 0 is one snapshot of the buffer pool status
+   snapshots = []
+   with open(path, 'r', errors='ignore') as file:
+      for line in file:
+         match = SWO_POOL_PATTERN.search(line)
+         if match:
+            index, length, num_buffers, num_allocated, max_allocated, max_request_length, num_failed = (int(value) for value in match.groups())
+            if index == 0 or not snapshots:
+               snapshots.append([])
+            snapshots[-1].append({ 'buffer_length': length, 'num_buffers': num_buffers, 'num_allocated': num_allocated, 'max_allocated': max_allocated,
+                                   'max_request_length': max_request_length, 'num_failed_allocations': num_failed })
+   return snapshots
+
+async def read_buffer_status(address):
+   async with BleakClient(address) as client:
+      return unpack_buffer_status(await client.read_gatt_char(MAINTENANCE_BUFFER_STATUS_SERVICE_UUID))
+
+def merge_snapshots(snapshots):
+   # Combine the peaks of all recordings, which must have been taken with the same pool layout
+   layout = [(pool['buffer_length'], pool['num_buffers']) for pool in snapshots[0]]
+   usage = [dict(pool) for pool in snapshots[0]]
+   for snapshot in snapshots[1:]:
+      if [(pool['buffer_length'], pool['num_buffers']) for pool in snapshot] != layout:
+         raise ValueError('All recordings must use the same buffer pool layout')
+      for merged, pool in zip(usage, snapshot):
+         for key in ('max_allocated', 'max_request_length', 'num_failed_allocations'):
+            merged[key] = max(merged[key], pool[key])
+   return usage
+
+
+# POOL LAYOUT PROPOSAL ------------------------------------------------------------------------------------------------
+
+def aligned_buffer_length(length, alignment=WSF_BUF_ALIGNMENT):
+   # Matches the length that WsfBufInit actually reserves for each buffer of a pool
+   return alignment * max(1, math.ceil(length / alignment))
+
+def pool_layout_size(layout, alignment=WSF_BUF_ALIGNMENT):
+   return sum(WSF_BUF_POOL_OVERHEAD + (aligned_buffer_length(length, alignment) * count) for length, count in layout)
+
+def propose_pool_layout(usage, headroom=0.25, min_buffers=1, alignment=WSF_BUF_ALIGNMENT):
+   # Shrink each pool to its recorded peak plus headroom, growing any pool that ran out of buffers
+   layout, previous_length = [], 0
+   for index, pool in enumerate(usage):
+      length = pool['buffer_length']
+      if index < len(usage) - 1 and pool['max_request_length'] > 0:
+         length = pool['max_request_length']
+      length = max(aligned_buffer_length(length, alignment), previous_length + alignment)
+      needed = pool['max_allocated']
+      if pool['num_failed_allocations']:
+         needed = max(needed, pool['num_buffers']) + pool['num_failed_allocations']
+      count = min(max(min_buffers, math.ceil(needed * (1.0 + headroom))), MAX_BUFFERS_PER_POOL)
+      layout.append((length, count))
+      previous_length = length
+   return layout
+
+def print_report(usage, layout, alignment=WSF_BUF_ALIGNMENT):
+   print('Pool   Length  Buffers   Peak  Max Request  Failures   ->   Length  Buffers')
+   for index, (pool, (length, count)) in enumerate(zip(usage, layout)):
+      warning = '  (exhausted; smaller requests may have spilled into larger pools)' if pool['max_allocated'] >= pool['num_buffers'] else ''
+      print('{:>4} {:>8} {:>8} {:>6} {:>12} {:>9}   -> {:>7} {:>8}{}'.format(index, pool['buffer_length'], pool['num_buffers'], pool['max_allocated'],
+            pool['max_request_length'], pool['num_failed_allocations'], length, count, warning))
+   current_size = pool_layout_size([(pool['buffer_length'], pool['num_buffers']) for pool in usage], alignment)
+   proposed_size = pool_layout_size(layout, alignment)
+   print('\nCurrent pools use {} B of SRAM, proposed pools use {} B ({:+d} B)\n'.format(current_size, proposed_size, proposed_size - current_size))
+   print('Replacement for src/tasks/ble_task.c:\n')
+   print('#define WSF_BUF_POOLS {}'.format(len(layout)))
+   print('static uint32_t g_pui32BufMem[(WSF_BUF_POOLS*WSF_BUF_POOL_OVERHEAD + {}) / sizeof(uint32_t)];'.format(' + '.join('{}*{}'.format(length, count) for length, count in layout)))
+   for index, (length, count) in enumerate(layout):
+      print('   g_psPoolDescriptors[{}] = (wsfBufPoolDesc_t){{{}, {}}};'.format(index, length, count))
+
+
+# TOP-LEVEL FUNCTIONALITY ---------------------------------------------------------------------------------------------
+
+def main():
+   parser = argparse.ArgumentParser(description='Propose the smallest WSF buffer pool layout that covers recorded TotTag buffer usage')
+   parser.add_argument('logs', nargs='*', help='SWO logs containing "WSF Pool" status lines')
+   parser.add_argument('--address', action='append', default=[], help='Read the BufferStatus characteristic from the TotTag with this address')
+   parser.add_argument('--headroom', type=float, default=0.25, help='Fraction of extra buffers to add on top of each recorded peak')
+   parser.add_argument('--min-buffers', type=int, default=1, help='Minimum number of buffers to keep in each pool')
+   parser.add_argument('--no-free-check', action='store_true', help='The firmware is built with WSF_BUF_FREE_CHECK=FALSE, so pools only align to 4 bytes')
+   args = parser.parse_args()
+   snapshots = [snapshot for path in args.logs for snapshot in parse_swo_log(path)]
+   snapshots += [asyncio.run(read_buffer_status(address)) for address in args.address]
+   if not snapshots:
+      parser.error('No buffer pool usage was recorded; provide SWO logs or TotTag addresses')
+   usage = merge_snapshots(snapshots)
+   alignment = WSF_BUF_ALIGNMENT_NO_FREE_CHECK if args.no_free_check else WSF_BUF_ALIGNMENT
+   print_report(usage, propose_pool_layout(usage, args.headroom, args.min_buffers, alignment), alignment)
+
+if __name__ == "__main__":
+   main()
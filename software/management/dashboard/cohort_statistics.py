@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import argparse, concurrent.futures, csv, datetime, glob, itertools, os, shutil, tempfile, time
+import numpy as np
+try:
+   from .contact_episodes import DEFAULT_ENTER_DISTANCE_MM, DEFAULT_EXIT_DISTANCE_MM, DEFAULT_MAX_GAP_S, DEFAULT_MIN_DURATION_S, ContactEpisodeSegmenter
+   from .log_tables import LOG_TABLE_COLUMNS, LOG_TABLES_EXTENSION, read_log_metadata, read_log_table, read_log_time_bounds, write_log_tables
+except ImportError:
+   from contact_episodes import DEFAULT_ENTER_DISTANCE_MM, DEFAULT_EXIT_DISTANCE_MM, DEFAULT_MAX_GAP_S, DEFAULT_MIN_DURATION_S, ContactEpisodeSegmenter
+   from log_tables import LOG_TABLE_COLUMNS, LOG_TABLES_EXTENSION, read_log_metadata, read_log_table, read_log_time_bounds, write_log_tables
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+SAMPLE_PERIOD_S = 0.5
+DEFAULT_AGREEMENT_TOLERANCE_MM = 300
+DEFAULT_HISTOGRAM_BIN_MM = 500
+DEFAULT_HISTOGRAM_MAX_MM = 10000
+
+
+# PER-PAIR STATISTICS -------------------------------------------------------------------------------------------------
+
+def local_day_boundaries(first_timestamp, last_timestamp):
+   # Local midnights surrounding the deployment, so that days follow the analysis machine's calendar like the dashboard does
+   day, dates, boundaries = datetime.date.fromtimestamp(first_timestamp), [], []
+   while True:
+      boundaries.append(datetime.datetime.combine(day, datetime.time()).timestamp())
+      if boundaries[-1] > last_timestamp:
+         return dates, np.array(boundaries)
+      dates.append(day)
+      day += datetime.timedelta(days=1)
+
+def read_directed_ranges(path, peer_label):
+   if path is None:
+      return np.empty(0, dtype=LOG_TABLE_COLUMNS['ranges']['t']), np.empty(0, dtype=LOG_TABLE_COLUMNS['ranges']['distance_mm'])
+   ranges = read_log_table(path, 'ranges', columns=['t', 'distance_mm'], peers=[peer_label])
+   return ranges['t'], ranges['distance_mm'].astype(np.int32)
+
+def directed_statistics(timestamps, distances, boundaries, params):
+   # Bin every measurement into its day and accumulate all per-day metrics with one bincount each
+   num_days, num_bins = len(boundaries) - 1, len(params['histogram_edges_mm'])
+   days = np.searchsorted(boundaries, timestamps, 'right') - 1
+   in_deployment = (days >= 0) & (days < num_days)
+   timestamps, distances, days = timestamps[in_deployment], distances[in_deployment], days[in_deployment]
+   histogram_bins = np.clip(np.searchsorted(params['histogram_edges_mm'], distances, 'right') - 1, 0, num_bins - 1)
+
+   # Segment contacts exactly like the live and per-pair tools, counting each episode on the day it starts and splitting its duration across the days it spans
+   segmenter = ContactEpisodeSegmenter(params['enter_distance_mm'], params['exit_distance_mm'], params['min_duration_s'], params['max_gap_s'], SAMPLE_PERIOD_S)
+   episodes = segmenter.update_many(timestamps, distances) + segmenter.flush()
+   episode_starts = np.array([episode['start'] for episode in episodes], dtype=np.float64)
+   episode_ends = episode_starts + np.array([episode['duration_s'] for episode in episodes], dtype=np.float64)
+   episode_days = np.searchsorted(boundaries, episode_starts, 'right') - 1
+   contact_duration_s = np.clip(np.minimum(episode_ends[:, None], boundaries[None, 1:]) - np.maximum(episode_starts[:, None], boundaries[None, :-1]), 0.0, None).sum(axis=0)
+   return { 'samples': np.bincount(days, minlength=num_days),
+            'distance_sum_mm': np.bincount(days, weights=distances, minlength=num_days),
+            'contact_duration_s': contact_duration_s, 'contact_episodes': np.bincount(episode_days, minlength=num_days),
+            'histogram': np.bincount((days * num_bins) + histogram_bins, minlength=num_days * num_bins).reshape(num_days, num_bins) }
+
+def agreement_statistics(timestamps_a, distances_a, timestamps_b, distances_b, boundaries, params):
+   # Compare the two directions of a pair wherever both TotTags logged a range at the same timestamp
+   num_days = len(boundaries) - 1
+   common_timestamps, indices_a, indices_b = np.intersect1d(timestamps_a, timestamps_b, assume_unique=True, return_indices=True)
+   differences = np.abs(distances_a[indices_a] - distances_b[indices_b])
+   days = np.searchsorted(boundaries, common_timestamps, 'right') - 1
+   in_deployment = (days >= 0) & (days < num_days)
+   days, differences = days[in_deployment], differences[in_deployment]
+   return { 'matched_samples': np.bincount(days, minlength=num_days),
+            'difference_sum_mm': np.bincount(days, weights=differences, minlength=num_days),
+            'agreeing_samples': np.bincount(days[differences <= params['agreement_tolerance_mm']], minlength=num_days) }
+
+def pair_statistics(task):
+   # Each unordered pair only touches its own two range slices, so pairs can be processed independently on any core
+   label_a, path_a, label_b, path_b, boundaries, params = task
+   timestamps_a, distances_a = read_directed_ranges(path_a, label_b)
+   timestamps_b, distances_b = read_directed_ranges(path_b, label_a)
+   return (label_a, label_b, directed_statistics(timestamps_a, distances_a, boundaries, params), directed_statistics(timestamps_b, distances_b, boundaries, params),
+           agreement_statistics(timestamps_a, distances_a, timestamps_b, distances_b, boundaries, params), len(timestamps_a) + len(timestamps_b))
+
+
+# COHORT STATISTICS ---------------------------------------------------------------------------------------------------
+
+def find_log_tables(paths):
+   # Accept both individual .ttgc directories and deployment folders containing them
+   logs = {}
+   for path in paths:
+      candidates = [path] if path.rstrip(os.sep).endswith(LOG_TABLES_EXTENSION) else sorted(glob.glob(os.path.join(path, '*' + LOG_TABLES_EXTENSION)))
+      for candidate in candidates:
+         logs[read_log_metadata(candidate)['label']] = candidate
+   return logs
+
+def statistics_parameters(enter_distance_mm=DEFAULT_ENTER_DISTANCE_MM, exit_distance_mm=DEFAULT_EXIT_DISTANCE_MM, min_duration_s=DEFAULT_MIN_DURATION_S,
+                          max_gap_s=DEFAULT_MAX_GAP_S, agreement_tolerance_mm=DEFAULT_AGREEMENT_TOLERANCE_MM, histogram_bin_mm=DEFAULT_HISTOGRAM_BIN_MM,
+                          histogram_max_mm=DEFAULT_HISTOGRAM_MAX_MM):
+   # The last histogram bin collects every distance beyond the histogram's range
+   return { 'enter_distance_mm': enter_distance_mm, 'exit_distance_mm': exit_distance_mm, 'min_duration_s': min_duration_s, 'max_gap_s': max_gap_s,
+            'agreement_tolerance_mm': agreement_tolerance_mm,
+            'histogram_edges_mm': np.arange(0, histogram_max_mm + histogram_bin_mm, histogram_bin_mm) }
+
+def compute_cohort_statistics(logs, params, num_workers=None):
+   # Split the deployment into one task per unordered pair of TotTags that appear in any log
+   bounds = [read_log_time_bounds(path) for path in logs.values()]
+   bounds = [bound for bound in bounds if bound[0] is not None]
+   if not bounds:
+      return [], [], [], 0
+   dates, boundaries = local_day_boundaries(min(bound[0] for bound in bounds), max(bound[1] for bound in bounds))
+   labels = sorted(set(logs) | { peer for path in logs.values() for peer in read_log_metadata(path)['peers'].values() })
+   tasks = [(label_a, logs.get(label_a), label_b, logs.get(label_b), boundaries, params)
+            for label_a, label_b in itertools.combinations(labels, 2) if label_a in logs or label_b in logs]
+   if num_workers == 1:
+      results = list(map(pair_statistics, tasks))
+   else:
+      with concurrent.futures.ProcessPoolExecutor(max_workers=num_workers) as executor:
+         results = list(executor.map(pair_statistics, tasks, chunksize=max(1, len(tasks) // (4 * (num_workers or os.cpu_count() or 1)))))
+   return dates, params['histogram_edges_mm'], results, sum(result[-1] for result in results)
+
+def contact_rows(dates, histogram_edges_mm, results):
+   # One row per direction and day with any measurements
+   for label_a, label_b, statistics_a, statistics_b, _, _ in results:
+      for source, destination, statistics in ((label_a, label_b, statistics_a), (label_b, label_a, statistics_b)):
+         for day in np.flatnonzero(statistics['samples']):
+            yield [source, destination, dates[day].isoformat(), int(statistics['samples'][day]), statistics['contact_duration_s'][day],
+                   int(statistics['contact_episodes'][day]), statistics['distance_sum_mm'][day] / statistics['samples'][day]] + statistics['histogram'][day].tolist()
+
+def agreement_rows(dates, results):
+   for label_a, label_b, _, _, agreement, _ in results:
+      for day in np.flatnonzero(agreement['matched_samples']):
+         yield [label_a, label_b, dates[day].isoformat(), int(agreement['matched_samples'][day]), agreement['difference_sum_mm'][day] / agreement['matched_samples'][day],
+                agreement['agreeing_samples'][day] / agreement['matched_samples'][day]]
+
+def write_cohort_statistics(output_directory, dates, histogram_edges_mm, results):
+   os.makedirs(output_directory, exist_ok=True)
+   with open(os.path.join(output_directory, 'contacts.csv'), 'w', newline='') as file:
+      writer = csv.writer(file)
+      writer.writerow(['source', 'destination', 'date', 'samples', 'contact_duration_s', 'contact_episodes', 'mean_distance_mm'] +
+                      ['histogram_{}_mm'.format(edge) for edge in histogram_edges_mm[:-1]] + ['histogram_over_{}_mm'.format(histogram_edges_mm[-1])])
+      writer.writerows(contact_rows(dates, histogram_edges_mm, results))
+   with open(os.path.join(output_directory, 'agreement.csv'), 'w', newline='') as file:
+      writer = csv.writer(file)
+      writer.writerow(['tottag_a', 'tottag_b', 'date', 'matched_samples', 'mean_absolute_difference_mm', 'fraction_within_tolerance'])
+      writer.writerows(agreement_rows(dates, results))
+
+
+# SYNTHETIC COHORT BENCHMARK ------------------------------------------------------------------------------------------
+
+def synthesize_directed_ranges(seed, source_uid, destination_uid, start_time, num_days, contact_fraction):
+   # Both directions of a pair share the same contact intervals and true distances, but have their own noise and dropouts
+   pair_rng = np.random.default_rng([seed, min(source_uid, destination_uid), max(source_uid, destination_uid)])
+   direction_rng = np.random.default_rng([seed, source_uid, destination_uid])
+   samples_per_day, num_intervals = int(86400 / SAMPLE_PERIOD_S), 4
+   interval_length = max(1, int(contact_fraction * samples_per_day / num_intervals))
+   starts = pair_rng.integers(0, samples_per_day - interval_length, size=(num_days, num_intervals)) + (samples_per_day * np.arange(num_days)[:, None])
+   steps = np.unique((starts.reshape(-1, 1) + np.arange(interval_length)).ravel())
+   true_distances = np.clip(1500 + np.cumsum(pair_rng.normal(0, 40, len(steps))), 100, 30000)
+   kept = direction_rng.random(len(steps)) > 0.1
+   distances = np.clip(true_distances + direction_rng.normal(0, 100, len(steps)), 0, 32767).astype(np.int16)
+   return start_time + (SAMPLE_PERIOD_S * steps[kept]), distances[kept]
+
+def synthesize_cohort(directory, num_tags, num_days, contact_fraction=0.02, seed=0):
+   # Write one columnar log per TotTag in which every other TotTag of the cohort is a ranging peer
+   start_time = datetime.datetime.combine(datetime.date.today() - datetime.timedelta(days=num_days + 1), datetime.time()).timestamp()
+   labels = { uid: 'TotTag{}'.format(uid) for uid in range(1, num_tags + 1) }
+   empty_tables = { name: { column: np.empty(0, dtype=dtype) for column, dtype in columns.items() } for name, columns in LOG_TABLE_COLUMNS.items() }
+   for uid, label in labels.items():
+      ranges = [(peer,) + synthesize_directed_ranges(seed, uid, peer, start_time, num_days, contact_fraction) for peer in labels if peer != uid]
+      tables = dict(empty_tables, ranges={ 't': np.concatenate([timestamps for _, timestamps, _ in ranges]),
+                                           'peer': np.concatenate([np.full(len(timestamps), peer) for peer, timestamps, _ in ranges]),
+                                           'distance_mm': np.concatenate([distances for _, _, distances in ranges]) })
+      write_log_tables(os.path.join(directory, label + LOG_TABLES_EXTENSION), tables, label, uid, start_time, labels)
+
+def run_benchmark(num_tags, num_days, contact_fraction, params):
+   # Time the same cohort with an increasing number of worker processes
+   directory = tempfile.mkdtemp()
+   try:
+      start = time.perf_counter()
+      synthesize_cohort(directory, num_tags, num_days, contact_fraction)
+      print('Synthesized {} TotTags over {} days in {:.1f} s'.format(num_tags, num_days, time.perf_counter() - start))
+      logs, baseline = find_log_tables([directory]), None
+      num_workers = 1
+      while num_workers <= (os.cpu_count() or 1):
+         start = time.perf_counter()
+         _, _, results, num_measurements = compute_cohort_statistics(logs, params, num_workers)
+         duration = time.perf_counter() - start
+         baseline = baseline or duration
+         print('   {:>3} worker(s): {} pairs, {:.1f} M measurements in {:.2f} s ({:.1f} M/s, {:.2f}x speedup)'.format(
+               num_workers, len(results), num_measurements / 1e6, duration, num_measurements / 1e6 / duration, baseline / duration))
+         num_workers *= 2
+   finally:
+      shutil.rmtree(directory, ignore_errors=True)
+
+
+# TOP-LEVEL FUNCTIONALITY ---------------------------------------------------------------------------------------------
+
+def main():
+   parser = argparse.ArgumentParser(description='Compute per-pair, per-day contact statistics for every TotTag in a deployment')
+   parser.add_argument('logs', nargs='*', help='Deployment folders or individual .ttgc logs')
+   parser.add_argument('--output', default='.', help='Folder in which to write contacts.csv and agreement.csv')
+   parser.add_argument('--workers', type=int, default=None, help='Number of worker processes (default: one per core)')
+   parser.add_argument('--enter-distance-mm', type=int, default=DEFAULT_ENTER_DISTANCE_MM, help='Distance within which a contact episode starts')
+   parser.add_argument('--exit-distance-mm', type=int, default=DEFAULT_EXIT_DISTANCE_MM, help='Distance within which an ongoing contact episode continues')
+   parser.add_argument('--min-duration-s', type=float, default=DEFAULT_MIN_DURATION_S, help='Shortest contact episode that is counted')
+   parser.add_argument('--max-gap-s', type=float, default=DEFAULT_MAX_GAP_S, help='Longest time without an in-contact range that is bridged within one episode')
+   parser.add_argument('--agreement-tolerance-mm', type=int, default=DEFAULT_AGREEMENT_TOLERANCE_MM, help='Maximum difference for symmetric ranges to agree')
+   parser.add_argument('--histogram-bin-mm', type=int, default=DEFAULT_HISTOGRAM_BIN_MM, help='Width of each distance histogram bin')
+   parser.add_argument('--histogram-max-mm', type=int, default=DEFAULT_HISTOGRAM_MAX_MM, help='Distance beyond which all ranges share one histogram bin')
+   parser.add_argument('--benchmark', action='store_true', help='Time the engine on a synthetic cohort instead of processing logs')
+   parser.add_argument('--benchmark-tags', type=int, default=40, help='Number of TotTags in the synthetic cohort')
+   parser.add_argument('--benchmark-days', type=int, default=30, help='Number of days in the synthetic cohort')
+   parser.add_argument('--benchmark-contact-fraction', type=float, default=0.02, help='Fraction of each day that every pair spends in range')
+   args = parser.parse_args()
+   params = statistics_parameters(args.enter_distance_mm, args.exit_distance_mm, args.min_duration_s, args.max_gap_s, args.agreement_tolerance_mm, args.histogram_bin_mm, args.histogram_max_mm)
+   if args.benchmark:
+      run_benchmark(args.benchmark_tags, args.benchmark_days, args.benchmark_contact_fraction, params)
+      return
+   logs = find_log_tables(args.logs)
+   if not logs:
+      parser.error('No .ttgc logs were found')
+   dates, histogram_edges_mm, results, num_measurements = compute_cohort_statistics(logs, params, args.workers)
+   write_cohort_statistics(args.output, dates, histogram_edges_mm, results)
+   print('Processed {} measurements across {} TotTag pairs into {}'.format(num_measurements, len(results), os.path.abspath(args.output)))
+
+if __name__ == "__main__":
+   main()
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import numpy as np
+try:
+   from .log_tables import read_log_table, read_log_time_bounds
+except ImportError:
+   from log_tables import read_log_table, read_log_time_bounds
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+SAMPLE_PERIOD_S = 0.5
+DEFAULT_ENTER_DISTANCE_MM = 914
+DEFAULT_EXIT_DISTANCE_MM = 1219
+DEFAULT_MIN_DURATION_S = 5.0
+DEFAULT_MAX_GAP_S = 30.0
+DEFAULT_CHUNK_DURATION_S = 6 * 3600
+
+
+# STREAMING SEGMENTATION ----------------------------------------------------------------------------------------------
+
+class ContactEpisodeSegmenter:
+   # Turns one pair's range time series into contact episodes while keeping only the statistics of the current episode
+   #   An episode starts at a range within the enter distance and continues through ranges within the exit distance.
+   #   Missing or out-of-contact ranges are bridged until no in-contact range has been seen for longer than the maximum gap.
+   #   Episodes shorter than the minimum duration are dropped once they end.
+
+   def __init__(self, enter_distance_mm=DEFAULT_ENTER_DISTANCE_MM, exit_distance_mm=DEFAULT_EXIT_DISTANCE_MM,
+                min_duration_s=DEFAULT_MIN_DURATION_S, max_gap_s=DEFAULT_MAX_GAP_S, sample_period_s=SAMPLE_PERIOD_S):
+      if exit_distance_mm < enter_distance_mm:
+         raise ValueError('The exit distance must not be smaller than the enter distance')
+      self.enter_distance_mm = enter_distance_mm
+      self.exit_distance_mm = exit_distance_mm
+      self.min_duration_s = min_duration_s
+      self.max_gap_s = max_gap_s
+      self.sample_period_s = sample_period_s
+      self.in_contact = False
+      self.start_timestamp = self.last_timestamp = None
+      self.num_samples = 0
+      self.distance_sum_mm = 0.0
+      self.min_distance_mm = self.max_distance_mm = None
+
+   def _open(self, timestamp):
+      self.in_contact = True
+      self.start_timestamp = timestamp
+      self.num_samples = 0
+      self.distance_sum_mm = 0.0
+      self.min_distance_mm = self.max_distance_mm = None
+
+   def _extend(self, last_timestamp, num_samples, distance_sum_mm, min_distance_mm, max_distance_mm):
+      self.last_timestamp = last_timestamp
+      self.num_samples += num_samples
+      self.distance_sum_mm += distance_sum_mm
+      self.min_distance_mm = min_distance_mm if self.min_distance_mm is None else min(self.min_distance_mm, min_distance_mm)
+      self.max_distance_mm = max_distance_mm if self.max_distance_mm is None else max(self.max_distance_mm, max_distance_mm)
+
+   def _episode(self, start_timestamp, end_timestamp, num_samples, distance_sum_mm, min_distance_mm, max_distance_mm):
+      duration_s = end_timestamp - start_timestamp + self.sample_period_s
+      if duration_s < self.min_duration_s:
+         return []
+      return [{ 'start': float(start_timestamp), 'end': float(end_timestamp), 'duration_s': float(duration_s), 'samples': int(num_samples),
+                'mean_mm': float(distance_sum_mm / num_samples), 'min_mm': float(min_distance_mm), 'max_mm': float(max_distance_mm) }]
+
+   def _close(self):
+      self.in_contact = False
+      return self._episode(self.start_timestamp, self.last_timestamp, self.num_samples, self.distance_sum_mm, self.min_distance_mm, self.max_distance_mm)
+
+   def current_duration(self, timestamp=None):
+      # Length of the ongoing episode so far, or zero when out of contact
+      if not self.in_contact:
+         return 0.0
+      return (timestamp if timestamp is not None else self.last_timestamp) - self.start_timestamp + self.sample_period_s
+
+   def advance(self, timestamp):
+      # Let time pass without a new range, which ends the current episode once the gap can no longer be bridged
+      if self.in_contact and (timestamp - self.last_timestamp) > self.max_gap_s:
+         return self._close()
+      return []
+
+   def update(self, timestamp, distance_mm):
+      # Feed a single live range and return any episode that it completed
+      episodes = self.advance(timestamp)
+      if distance_mm <= self.exit_distance_mm:
+         if not self.in_contact and distance_mm <= self.enter_distance_mm:
+            self._open(timestamp)
+         if self.in_contact:
+            self._extend(timestamp, 1, distance_mm, distance_mm, distance_mm)
+      return episodes
+
+   def update_many(self, timestamps, distances_mm):
+      # Feed a time-sorted block of ranges at once, producing exactly the episodes that feeding them one by one would
+      timestamps, distances_mm = np.asarray(timestamps, dtype=np.float64), np.asarray(distances_mm, dtype=np.float64)
+      if len(timestamps) == 0:
+         return []
+      inside = distances_mm <= self.exit_distance_mm
+      inside_timestamps, inside_distances = timestamps[inside], distances_mm[inside]
+      episodes = []
+      if len(inside_timestamps):
+         # In-contact ranges separated by no more than the maximum gap form runs, and every episode spans the end of one run
+         run_starts = np.flatnonzero(np.concatenate(([True], np.diff(inside_timestamps) > self.max_gap_s)))
+         run_ends = np.append(run_starts[1:], len(inside_timestamps))
+         first_run = 0
+         if self.in_contact and (inside_timestamps[0] - self.last_timestamp) <= self.max_gap_s:
+            run = inside_distances[:run_ends[0]]
+            self._extend(inside_timestamps[run_ends[0] - 1], len(run), run.sum(), run.min(), run.max())
+            first_run = 1
+         if self.in_contact and (first_run == 0 or len(run_starts) > 1):
+            episodes += self._close()
+
+         # Each remaining run holds an episode starting at its first range within the enter distance, if it has one
+         entering = np.flatnonzero(inside_distances <= self.enter_distance_mm)
+         run_starts, run_ends = run_starts[first_run:], run_ends[first_run:]
+         next_entry = np.searchsorted(entering, run_starts)
+         has_episode = next_entry < len(entering)
+         has_episode[has_episode] &= entering[next_entry[has_episode]] < run_ends[has_episode]
+         starts, ends = entering[next_entry[has_episode]], run_ends[has_episode]
+         if len(starts):
+            distance_sums = np.concatenate(([0.0], np.cumsum(inside_distances)))
+            bounds = np.column_stack((starts, ends)).ravel()
+            padded_distances = np.append(inside_distances, 0.0)
+            minimums = np.minimum.reduceat(padded_distances, bounds)[::2]
+            maximums = np.maximum.reduceat(padded_distances, bounds)[::2]
+            for i in range(len(starts) - 1):
+               episodes += self._episode(inside_timestamps[starts[i]], inside_timestamps[ends[i] - 1], ends[i] - starts[i],
+                                         distance_sums[ends[i]] - distance_sums[starts[i]], minimums[i], maximums[i])
+            self._open(inside_timestamps[starts[-1]])
+            self._extend(inside_timestamps[ends[-1] - 1], ends[-1] - starts[-1], distance_sums[ends[-1]] - distance_sums[starts[-1]], minimums[-1], maximums[-1])
+      return episodes + self.advance(timestamps[-1])
+
+   def flush(self):
+      # End of the data, so the current episode cannot continue
+      return self._close() if self.in_contact else []
+
+class ContactTracker:
+   # Keeps one segmenter per TotTag pair for the live range feed
+
+   def __init__(self, **segmenter_parameters):
+      self.segmenter_parameters = segmenter_parameters
+      self.segmenters = {}
+
+   def update(self, pair, timestamp, distance_mm):
+      if pair not in self.segmenters:
+         self.segmenters[pair] = ContactEpisodeSegmenter(**self.segmenter_parameters)
+      return self.segmenters[pair].update(timestamp, distance_mm)
+
+   def advance(self, timestamp):
+      return { pair: episodes for pair, episodes in ((pair, segmenter.advance(timestamp)) for pair, segmenter in self.segmenters.items()) if episodes }
+
+   def current_duration(self, pair, timestamp=None):
+      return self.segmenters[pair].current_duration(timestamp) if pair in self.segmenters else 0.0
+
+
+# OFFLINE SEGMENTATION ------------------------------------------------------------------------------------------------
+
+def log_contact_episodes(path, peer, chunk_duration=DEFAULT_CHUNK_DURATION_S, **segmenter_parameters):
+   # Stream one peer's ranges out of a columnar log in fixed-size time chunks, so memory use does not grow with the deployment
+   segmenter, episodes = ContactEpisodeSegmenter(**segmenter_parameters), []
+   first_timestamp, last_timestamp = read_log_time_bounds(path)
+   chunk_start = first_timestamp
+   while chunk_start is not None and chunk_start <= last_timestamp:
+      ranges = read_log_table(path, 'ranges', columns=['t', 'distance_mm'], peers=[peer], start_time=chunk_start, end_time=chunk_start + chunk_duration)
+      episodes += segmenter.update_many(ranges['t'], ranges['distance_mm'])
+      chunk_start += chunk_duration
+   return episodes + segmenter.flush()
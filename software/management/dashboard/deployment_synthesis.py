@@ -0,0 +1,347 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import argparse, concurrent.futures, glob, math, os, shutil, tempfile, time
+import numpy as np
+try:
+   from .tottag import *
+   from .cohort_statistics import compute_cohort_statistics, find_log_tables, statistics_parameters
+   from .log_tables import LOG_TABLES_EXTENSION, read_log_table
+   from .simulator import synthesize_experiment_details
+except ImportError:
+   from tottag import *
+   from cohort_statistics import compute_cohort_statistics, find_log_tables, statistics_parameters
+   from log_tables import LOG_TABLES_EXTENSION, read_log_table
+   from simulator import synthesize_experiment_details
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+SAMPLE_PERIOD_MS = 500
+ROUNDS_PER_DAY = 86400 * 1000 // SAMPLE_PERIOD_MS
+BATTERY_CHECK_INTERVAL_ROUNDS = 300 * 1000 // SAMPLE_PERIOD_MS
+EXPERIMENT_DETAILS_FILE = 'experiment_details.bin'
+RAW_LOG_EXTENSION = '.ttg'
+
+MOVEMENT_MODELS = ('static', 'rooms', 'walk')
+ROOM_SIZE_MM = 6000
+TRANSIT_ROUNDS = 40
+WALK_STEP_MM = 100
+RANGE_NOISE_MM = 100
+FULL_BATTERY_MV = 4150
+EMPTY_BATTERY_MV = 3500
+BATTERY_DRAIN_MV_PER_HOUR = 10
+BATTERY_NOISE_MV = 10
+
+DEFAULT_NUM_ROOMS = 4
+DEFAULT_MEAN_STAY_S = 900
+DEFAULT_RANGE_LOSS = 0.05
+DEFAULT_ROUND_LOSS = 0.01
+DEFAULT_OUTAGES_PER_DAY = 0.5
+DEFAULT_MEAN_OUTAGE_S = 1800
+
+RECORD_HEADER = np.dtype([('type', 'u1'), ('timestamp', '<u4')])
+RANGE_DATUM = np.dtype([('uid', 'u1'), ('distance_mm', '<u2')])
+
+
+# SITE MOVEMENT AND CONNECTIVITY --------------------------------------------------------------------------------------
+
+def synthesize_stays(rng, num_rounds, params):
+   # Each TotTag moves through a sequence of rooms, staying at one spot in each for an exponentially distributed time
+   if params['movement'] == 'static':
+      return np.zeros(1, dtype=np.int64), np.zeros(1, dtype=np.int64), rng.uniform(0, ROOM_SIZE_MM, (1, 2))
+   mean_stay_rounds = params['mean_stay_s'] * 1000 / SAMPLE_PERIOD_MS
+   durations = np.maximum(rng.exponential(mean_stay_rounds, int(2 * num_rounds / mean_stay_rounds) + 16).astype(np.int64), TRANSIT_ROUNDS + 1)
+   while durations.sum() < num_rounds:
+      durations = np.concatenate((durations, durations))
+   starts = np.concatenate(([0], np.cumsum(durations)[:-1]))
+   starts = starts[starts < num_rounds]
+   rooms = np.cumsum(rng.integers(1, max(params['num_rooms'], 2), len(starts))) % params['num_rooms']
+   return starts, rooms, rng.uniform(0, ROOM_SIZE_MM, (len(starts), 2))
+
+def synthesize_outages(rng, num_rounds, params):
+   # TotTags shut down whenever they are plugged in to charge, so an outage is a span of rounds during which nothing is logged
+   num_outages = rng.poisson(params['outages_per_day'] * num_rounds / ROUNDS_PER_DAY)
+   starts = np.sort(rng.integers(0, num_rounds, num_outages))
+   return starts, starts + rng.exponential(params['mean_outage_s'] * 1000 / SAMPLE_PERIOD_MS, num_outages).astype(np.int64)
+
+def reflect_into_room(positions):
+   positions = np.mod(positions, 2 * ROOM_SIZE_MM)
+   return np.where(positions > ROOM_SIZE_MM, (2 * ROOM_SIZE_MM) - positions, positions)
+
+def site_state(rng, first_round, num_rounds, stays, outages, carry, params):
+   # Room, position, motion and power state of every TotTag for one day of rounds, continuing the walks and boots of the previous day
+   rounds = first_round + np.arange(num_rounds)
+   num_tags = len(stays)
+   rooms, positions = np.empty((num_tags, num_rounds), dtype=np.int64), np.empty((num_tags, num_rounds, 2))
+   moving, on = np.zeros((num_tags, num_rounds), dtype=bool), np.ones((num_tags, num_rounds), dtype=bool)
+   for tag, ((stay_starts, stay_rooms, anchors), (outage_starts, outage_ends)) in enumerate(zip(stays, outages)):
+      stay = np.searchsorted(stay_starts, rounds, 'right') - 1
+      rooms[tag], positions[tag] = stay_rooms[stay], anchors[stay]
+      if params['movement'] != 'static':
+         moving[tag] = (rounds - stay_starts[stay]) < TRANSIT_ROUNDS
+      if params['movement'] == 'walk':
+         # Wandering TotTags random-walk away from the spot where each stay began, and are in motion throughout
+         walks = np.cumsum(rng.normal(0, WALK_STEP_MM, (num_rounds, 2)), axis=0) + carry['walks'][tag]
+         started_today = stay_starts[stay] >= first_round
+         walks -= np.where(started_today[:, None], walks[np.maximum(stay_starts[stay] - first_round, 0)], 0.0)
+         carry['walks'][tag] = walks[-1]
+         positions[tag] = reflect_into_room(positions[tag] + walks)
+         moving[tag] = True
+      changes = np.zeros(num_rounds + 1, dtype=np.int64)
+      np.add.at(changes, np.clip(outage_starts - first_round, 0, num_rounds), 1)
+      np.add.at(changes, np.clip(outage_ends - first_round, 0, num_rounds), -1)
+      on[tag] = np.cumsum(changes[:-1]) == 0
+   return rooms, positions, moving, on
+
+def directed_ranges(rng, rooms, positions, present, params):
+   # Both TotTags of a pair range one another whenever both took part in the round from the same room, each with its own noise and losses
+   num_tags = len(rooms)
+   ranges = [[] for _ in range(num_tags)]
+   for tag_a in range(num_tags):
+      for tag_b in range(tag_a + 1, num_tags):
+         rounds = np.flatnonzero(present[tag_a] & present[tag_b] & (rooms[tag_a] == rooms[tag_b]))
+         distances = np.hypot(*(positions[tag_a, rounds] - positions[tag_b, rounds]).T)
+         for source, destination in ((tag_a, tag_b), (tag_b, tag_a)):
+            kept = rng.random(len(rounds)) >= params['range_loss']
+            measured = np.rint(distances[kept] + rng.normal(0, RANGE_NOISE_MM, np.count_nonzero(kept)))
+            ranges[source].append((rounds[kept], np.full(np.count_nonzero(kept), destination), np.clip(measured, 0, MAX_RANGING_DISTANCE_MM - 1)))
+   return [tuple(np.concatenate(column) for column in zip(*tag_ranges)) if tag_ranges else (np.empty(0, dtype=np.int64),) * 3 for tag_ranges in ranges]
+
+
+# STORAGE RECORD LAYOUT -----------------------------------------------------------------------------------------------
+
+def pack_storage_records(range_rounds, range_uids, range_distances, motion_rounds, motion_values, voltage_rounds, voltage_values):
+   # Lay records out byte-for-byte as storage_task.c stores them, in timestamp order with ranges queued first at any timestamp:
+   #   ranges:  type, timestamp, count, then count x (uid, distance_mm)
+   #   motion:  type, timestamp, in_motion
+   #   voltage: type, timestamp, voltage_mV
+   order = np.lexsort((range_uids, range_rounds))
+   range_rounds, range_uids, range_distances = range_rounds[order], range_uids[order], range_distances[order]
+   record_rounds, first_ranges, num_ranges = np.unique(range_rounds, return_index=True, return_counts=True)
+   rounds = np.concatenate((record_rounds, motion_rounds, voltage_rounds))
+   kinds = np.concatenate((np.full(len(record_rounds), STORAGE_TYPE_RANGES), np.full(len(motion_rounds), STORAGE_TYPE_MOTION),
+                           np.full(len(voltage_rounds), STORAGE_TYPE_VOLTAGE))).astype(np.uint8)
+   lengths = RECORD_HEADER.itemsize + np.concatenate((1 + (RANGE_DATUM.itemsize * num_ranges), np.ones(len(motion_rounds), dtype=np.int64),
+                                                      np.full(len(voltage_rounds), 4, dtype=np.int64)))
+   order = np.lexsort((kinds == STORAGE_TYPE_VOLTAGE, kinds == STORAGE_TYPE_MOTION, rounds))
+   offsets = np.empty(len(rounds), dtype=np.int64)
+   offsets[order] = np.concatenate(([0], np.cumsum(lengths[order])[:-1]))
+   data = np.zeros(int(lengths.sum()), dtype=np.uint8)
+
+   headers = np.empty(len(rounds), dtype=RECORD_HEADER)
+   headers['type'], headers['timestamp'] = kinds, rounds * SAMPLE_PERIOD_MS
+   data[offsets[:, None] + np.arange(RECORD_HEADER.itemsize)] = headers.view(np.uint8).reshape(-1, RECORD_HEADER.itemsize)
+   payloads = offsets + RECORD_HEADER.itemsize
+   num_records, num_motions = len(record_rounds), len(motion_rounds)
+   data[payloads[:num_records]] = num_ranges
+   data[payloads[num_records:num_records+num_motions]] = motion_values
+   data[payloads[num_records+num_motions:, None] + np.arange(4)] = voltage_values.astype('<u4').view(np.uint8).reshape(-1, 4)
+   data_per_range = np.empty(len(range_rounds), dtype=RANGE_DATUM)
+   data_per_range['uid'], data_per_range['distance_mm'] = range_uids, range_distances
+   range_offsets = np.repeat(payloads[:num_records] + 1, num_ranges) + (RANGE_DATUM.itemsize * (np.arange(len(range_rounds)) - np.repeat(first_ranges, num_ranges)))
+   data[range_offsets[:, None] + np.arange(RANGE_DATUM.itemsize)] = data_per_range.view(np.uint8).reshape(-1, RANGE_DATUM.itemsize)
+   return data.tobytes()
+
+
+# SYNTHETIC DEPLOYMENTS -----------------------------------------------------------------------------------------------
+
+def site_labels(site, num_sites, num_tags):
+   return [('Site{}-TotTag{}' if num_sites > 1 else 'TotTag{1}').format(site + 1, tag + 1) for tag in range(num_tags)]
+
+def synthesize_site(task):
+   # Write one raw storage stream per TotTag of a site a day at a time, returning checksums of every record it contains
+   directory, site, num_sites, num_tags, start_time, params = task
+   num_rounds = int(round(params['days'] * ROUNDS_PER_DAY))
+   rng = np.random.default_rng([params['seed'], site])
+   labels = site_labels(site, num_sites, num_tags)
+   with open(os.path.join(directory, EXPERIMENT_DETAILS_FILE), 'wb') as file:
+      file.write(synthesize_experiment_details(start_time, math.ceil(num_rounds * SAMPLE_PERIOD_MS / 1000), num_tags, labels))
+   stays = [synthesize_stays(rng, num_rounds, params) for _ in range(num_tags)]
+   outages = [synthesize_outages(rng, num_rounds, params) for _ in range(num_tags)]
+   carry = { 'walks': np.zeros((num_tags, 2)), 'on': np.zeros(num_tags, dtype=bool), 'moving': np.zeros(num_tags, dtype=bool),
+             'last_boot': np.zeros(num_tags, dtype=np.int64) }
+   checksums = { label: dict.fromkeys(('ranges', 'range_sum_mm', 'range_sum_ms', 'motions', 'motion_sum_ms', 'voltages', 'voltage_sum_mv'), 0) for label in labels }
+   files = [open(os.path.join(directory, label + RAW_LOG_EXTENSION), 'wb') for label in labels]
+   try:
+      for first_round in range(0, num_rounds, ROUNDS_PER_DAY):
+         day_rounds = min(ROUNDS_PER_DAY, num_rounds - first_round)
+         rooms, positions, moving, on = site_state(rng, first_round, day_rounds, stays, outages, carry, params)
+         present = on & (rng.random(on.shape) >= params['round_loss'])
+         ranges = directed_ranges(rng, rooms, positions, present, params)
+         rounds = first_round + np.arange(day_rounds)
+         for tag, (label, file) in enumerate(zip(labels, files)):
+            # The motion state is stored at every boot and whenever it changes, and the battery voltage every five minutes after boot
+            previous_on, previous_moving = np.append(carry['on'][tag], on[tag, :-1]), np.append(carry['moving'][tag], moving[tag, :-1])
+            boots = on[tag] & ~previous_on
+            motions = np.flatnonzero(boots | (on[tag] & (moving[tag] != previous_moving)))
+            last_boots = np.maximum.accumulate(np.where(boots, rounds, carry['last_boot'][tag]))
+            voltages = np.flatnonzero(on[tag] & (((rounds - last_boots) % BATTERY_CHECK_INTERVAL_ROUNDS) == 0))
+            voltage_values = np.clip(FULL_BATTERY_MV - (BATTERY_DRAIN_MV_PER_HOUR * (rounds[voltages] - last_boots[voltages]) * SAMPLE_PERIOD_MS / 3600000.0) +
+                                     rng.normal(0, BATTERY_NOISE_MV, len(voltages)), EMPTY_BATTERY_MV, FULL_BATTERY_MV).astype(np.int64)
+            carry['on'][tag], carry['moving'][tag], carry['last_boot'][tag] = on[tag, -1], moving[tag, -1], last_boots[-1]
+            range_rounds, peers, distances = ranges[tag]
+            file.write(pack_storage_records(first_round + range_rounds, peers + 1, distances, rounds[motions], moving[tag, motions], rounds[voltages], voltage_values))
+            checksum = checksums[label]
+            checksum['ranges'] += len(range_rounds)
+            checksum['range_sum_mm'] += int(distances.sum())
+            checksum['range_sum_ms'] += int((first_round + range_rounds).sum()) * SAMPLE_PERIOD_MS
+            checksum['motions'] += len(motions)
+            checksum['motion_sum_ms'] += int(rounds[motions].sum()) * SAMPLE_PERIOD_MS
+            checksum['voltages'] += len(voltages)
+            checksum['voltage_sum_mv'] += int(voltage_values.sum())
+   finally:
+      for file in files:
+         file.close()
+   return checksums
+
+def synthesis_parameters(days=1.0, movement='rooms', num_rooms=DEFAULT_NUM_ROOMS, mean_stay_s=DEFAULT_MEAN_STAY_S, range_loss=DEFAULT_RANGE_LOSS,
+                         round_loss=DEFAULT_ROUND_LOSS, outages_per_day=DEFAULT_OUTAGES_PER_DAY, mean_outage_s=DEFAULT_MEAN_OUTAGE_S, seed=0):
+   if movement not in MOVEMENT_MODELS:
+      raise ValueError('Unknown movement model {}'.format(movement))
+   return { 'days': days, 'movement': movement, 'num_rooms': num_rooms, 'mean_stay_s': mean_stay_s, 'range_loss': range_loss, 'round_loss': round_loss,
+            'outages_per_day': outages_per_day, 'mean_outage_s': mean_outage_s, 'seed': seed }
+
+def synthesize_deployment(directory, num_tags, params, num_workers=None):
+   # A single experiment holds at most MAX_NUM_DEVICES TotTags, so larger cohorts are split into independent sites of their own
+   num_sites = max(1, math.ceil(num_tags / MAX_NUM_DEVICES))
+   start_time = int(time.time() - (params['days'] * 86400) - 3600) // 60 * 60
+   tasks = []
+   for site in range(num_sites):
+      site_directory = os.path.join(directory, 'site{}'.format(site + 1)) if num_sites > 1 else directory
+      os.makedirs(site_directory, exist_ok=True)
+      tasks.append((site_directory, site, num_sites, (num_tags // num_sites) + (site < (num_tags % num_sites)), start_time, params))
+   if num_workers == 1:
+      results = list(map(synthesize_site, tasks))
+   else:
+      with concurrent.futures.ProcessPoolExecutor(max_workers=num_workers) as executor:
+         results = list(executor.map(synthesize_site, tasks))
+   return [task[0] for task in tasks], { label: checksum for result in results for label, checksum in result.items() }
+
+
+# IMPORT AND VERIFICATION ---------------------------------------------------------------------------------------------
+
+def site_raw_logs(directory):
+   with open(os.path.join(directory, EXPERIMENT_DETAILS_FILE), 'rb') as file:
+      details = unpack_experiment_details(file.read())
+   uid_to_labels = experiment_uid_labels(details)
+   return details, { uid: os.path.join(directory, label + RAW_LOG_EXTENSION) for uid, label in uid_to_labels.items()
+                     if os.path.exists(os.path.join(directory, label + RAW_LOG_EXTENSION)) }
+
+def import_site(directory):
+   # Turn every raw log of a site into columnar log tables exactly as the dashboard does after a download
+   details, raw_logs = site_raw_logs(directory)
+   for uid, path in raw_logs.items():
+      with open(path, 'rb') as file:
+         process_tottag_data(uid, directory, details, file.read(), False)
+
+def imported_checksums(path, experiment_start_time):
+   ranges, motion, voltage = read_log_table(path, 'ranges'), read_log_table(path, 'motion'), read_log_table(path, 'voltage')
+   to_ms = lambda timestamps: int(np.rint((timestamps - experiment_start_time) * 1000).astype(np.int64).sum())
+   return { 'ranges': len(ranges['t']), 'range_sum_mm': int(ranges['distance_mm'].astype(np.int64).sum()), 'range_sum_ms': to_ms(ranges['t']),
+            'motions': len(motion['t']), 'motion_sum_ms': to_ms(motion['t']), 'voltages': len(voltage['t']),
+            'voltage_sum_mv': int(voltage['voltage_mv'].astype(np.int64).sum()) }
+
+def verify_import(site_directories, checksums):
+   # Every generated record must survive decoding and import unchanged, which the per-TotTag checksums confirm
+   mismatches = []
+   for directory in site_directories:
+      details, _ = site_raw_logs(directory)
+      for path in sorted(glob.glob(os.path.join(directory, '*' + LOG_TABLES_EXTENSION))):
+         label = os.path.basename(path)[:-len(LOG_TABLES_EXTENSION)]
+         if imported_checksums(path, details['start_time']) != checksums[label]:
+            mismatches.append(label)
+   return mismatches
+
+
+# BENCHMARKING --------------------------------------------------------------------------------------------------------
+
+def report_stage(name, num_bytes, elapsed):
+   print('   {:<40} {:>10.1f} s {:>10.2f} MB/s'.format(name, elapsed, num_bytes / 1048576.0 / max(elapsed, 1e-9)))
+
+def run_benchmark(directory, num_tags, params, num_workers):
+   # Time every stage of the analysis stack on the synthetic deployment, checking the imported tables against what was generated
+   start = time.perf_counter()
+   site_directories, checksums = synthesize_deployment(directory, num_tags, params, num_workers)
+   raw_logs = [(details, path) for site in site_directories for details, paths in (site_raw_logs(site),) for path in paths.values()]
+   num_bytes = sum(os.path.getsize(path) for _, path in raw_logs)
+   print('Synthesized {} TotTags in {} site(s) over {} days ({:.1f} MB of raw logs, {:.1f} M ranges):'.format(
+         num_tags, len(site_directories), params['days'], num_bytes / 1048576.0, sum(checksum['ranges'] for checksum in checksums.values()) / 1e6))
+   report_stage('Generation', num_bytes, time.perf_counter() - start)
+
+   if native_decode_storage_records:
+      start = time.perf_counter()
+      for details, path in raw_logs:
+         with open(path, 'rb') as file:
+            decode_storage_records(file.read(), details['start_time'], experiment_uid_labels(details).keys())
+      report_stage('Native decoding', num_bytes, time.perf_counter() - start)
+   else:
+      print('   Native decoder is not built; the import below uses the pure-Python parser')
+   start = time.perf_counter()
+   for site in site_directories:
+      import_site(site)
+   report_stage('Dashboard import into .ttgc tables', num_bytes, time.perf_counter() - start)
+   mismatches = verify_import(site_directories, checksums)
+   print('   {:<40} {}'.format('Imported tables match generated records', 'yes' if not mismatches else 'NO: ' + ', '.join(mismatches)))
+
+   try:
+      from .processing import LazyLogData
+   except ImportError:
+      from processing import LazyLogData
+   start = time.perf_counter()
+   for site in site_directories:
+      for path in sorted(glob.glob(os.path.join(site, '*' + LOG_TABLES_EXTENSION))):
+         data = LazyLogData(path)
+         for _ in data.chunks(['v', 'm'] + ['r.' + label for label in data.peer_labels]):
+            pass
+   report_stage('Analysis chunking (processing.py)', num_bytes, time.perf_counter() - start)
+   start = time.perf_counter()
+   _, _, results, num_measurements = compute_cohort_statistics(find_log_tables(site_directories), statistics_parameters(), num_workers)
+   report_stage('Cohort statistics ({} pairs)'.format(len(results)), num_bytes, time.perf_counter() - start)
+   return not mismatches
+
+
+# TOP-LEVEL FUNCTIONALITY ---------------------------------------------------------------------------------------------
+
+def main():
+   parser = argparse.ArgumentParser(description='Synthesize raw TotTag logs of a whole deployment in the on-device storage format')
+   parser.add_argument('--output', default=None, help='Folder in which to write the raw logs (default: a temporary folder when benchmarking)')
+   parser.add_argument('--tags', type=int, default=MAX_NUM_DEVICES, help='Number of TotTags, split into sites of at most {} each'.format(MAX_NUM_DEVICES))
+   parser.add_argument('--days', type=float, default=1.0, help='Length of the deployment in days')
+   parser.add_argument('--movement', choices=MOVEMENT_MODELS, default='rooms', help='Whether TotTags stay put, move between rooms, or also wander within rooms')
+   parser.add_argument('--rooms', type=int, default=DEFAULT_NUM_ROOMS, help='Number of rooms per site, between which no ranging is possible')
+   parser.add_argument('--mean-stay-s', type=float, default=DEFAULT_MEAN_STAY_S, help='Average time a TotTag stays in one room')
+   parser.add_argument('--range-loss', type=float, default=DEFAULT_RANGE_LOSS, help='Probability of losing any single range measurement')
+   parser.add_argument('--round-loss', type=float, default=DEFAULT_ROUND_LOSS, help='Probability of a TotTag missing a whole ranging round')
+   parser.add_argument('--outages-per-day', type=float, default=DEFAULT_OUTAGES_PER_DAY, help='Average number of times per day each TotTag is charged')
+   parser.add_argument('--mean-outage-s', type=float, default=DEFAULT_MEAN_OUTAGE_S, help='Average length of each charging outage')
+   parser.add_argument('--seed', type=int, default=0, help='Seed of the random number generator')
+   parser.add_argument('--workers', type=int, default=None, help='Number of worker processes (default: one per core)')
+   parser.add_argument('--import', dest='import_logs', action='store_true', help='Also import the raw logs into .ttgc tables as the dashboard does')
+   parser.add_argument('--benchmark', action='store_true', help='Time decoding, importing, and analyzing the synthetic deployment')
+   args = parser.parse_args()
+   params = synthesis_parameters(args.days, args.movement, args.rooms, args.mean_stay_s, args.range_loss, args.round_loss, args.outages_per_day, args.mean_outage_s, args.seed)
+   if args.benchmark:
+      directory = args.output or tempfile.mkdtemp()
+      try:
+         if not run_benchmark(directory, args.tags, params, args.workers):
+            raise SystemExit(1)
+      finally:
+         if args.output is None:
+            shutil.rmtree(directory, ignore_errors=True)
+      return
+   if args.output is None:
+      parser.error('An output folder is required unless benchmarking')
+   site_directories, checksums = synthesize_deployment(args.output, args.tags, params, args.workers)
+   if args.import_logs:
+      for site in site_directories:
+         import_site(site)
+      mismatches = verify_import(site_directories, checksums)
+      if mismatches:
+         raise SystemExit('Imported tables do not match the generated records for ' + ', '.join(mismatches))
+   print('Synthesized {} TotTags in {} site(s) into {}'.format(len(checksums), len(site_directories), os.path.abspath(args.output)))
+
+if __name__ == "__main__":
+   main()
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import json, os, shutil
+import numpy as np
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+LOG_TABLES_EXTENSION = '.ttgc'
+LOG_TABLES_FORMAT_VERSION = 1
+LOG_TABLES_METADATA_FILE = 'metadata.json'
+
+STORAGE_TYPE_VOLTAGE = 1
+STORAGE_TYPE_CHARGING_EVENT = 2
+STORAGE_TYPE_MOTION = 3
+STORAGE_TYPE_RANGES = 4
+STORAGE_TYPE_RANGE_SUMMARY = 5
+
+CHARGING_EVENT_NAMES = { 1: 'Plugged', 2: 'Unplugged', 3: 'Charging', 4: 'Not Charging' }
+
+# Every table is stored as one memory-mappable .npy file per column, sorted by peer (where present) and then by time
+LOG_TABLE_COLUMNS = {
+   'ranges': { 't': '<f8', 'peer': '<u1', 'distance_mm': '<i2' },
+   'range_summaries': { 't': '<f8', 'peer': '<u1', 'mean_mm': '<i2', 'min_mm': '<i2', 'max_mm': '<i2', 'n': '<u1' },
+   'motion': { 't': '<f8', 'moving': '<u1' },
+   'voltage': { 't': '<f8', 'voltage_mv': '<u2' },
+   'charging': { 't': '<f8', 'event': '<u1' },
+}
+
+
+# TABLE CONSTRUCTION --------------------------------------------------------------------------------------------------
+
+def keep_last_per_key(*keys):
+   # Sort rows by the given keys, most significant first, keeping only the last row written for each key as the dict-based log format did
+   order = np.lexsort(keys[::-1])
+   is_last = np.ones(len(order), dtype=bool)
+   if len(order) > 1:
+      same_as_next = np.ones(len(order) - 1, dtype=bool)
+      for key in keys:
+         sorted_key = key[order]
+         same_as_next &= (sorted_key[1:] == sorted_key[:-1])
+      is_last[:-1] = ~same_as_next
+   return order[is_last]
+
+def build_log_tables(columns):
+   # Turn decoder columns into deduplicated per-type tables, where a later range record replaces all ranges at its timestamp
+   record_type, timestamp, value = columns['type'], columns['t'], columns['value']
+   tables = {}
+   for name, storage_type, value_column in (('motion', STORAGE_TYPE_MOTION, 'moving'), ('voltage', STORAGE_TYPE_VOLTAGE, 'voltage_mv'),
+                                            ('charging', STORAGE_TYPE_CHARGING_EVENT, 'event')):
+      rows = np.flatnonzero(record_type == storage_type)
+      rows = rows[keep_last_per_key(timestamp[rows])]
+      tables[name] = { 't': timestamp[rows], value_column: value[rows] }
+
+   # Only the measurements of the last range record at each timestamp survive, and repeated peers within it keep their last value
+   range_records = np.flatnonzero((record_type == STORAGE_TYPE_RANGES) | (record_type == STORAGE_TYPE_RANGE_SUMMARY))
+   measurement_records = np.repeat(range_records, value[range_records])
+   final_records = np.zeros(len(record_type), dtype=bool)
+   final_records[range_records[keep_last_per_key(timestamp[range_records])]] = True
+   measurements = np.flatnonzero(final_records[measurement_records])
+   measurement_times, measurement_peers = timestamp[measurement_records[measurements]], columns['uid'][measurements]
+   measurements = measurements[keep_last_per_key(measurement_peers, measurement_times)]
+   tables['ranges'] = { 't': timestamp[measurement_records[measurements]], 'peer': columns['uid'][measurements], 'distance_mm': columns['distance'][measurements] }
+   summaries = measurements[record_type[measurement_records[measurements]] == STORAGE_TYPE_RANGE_SUMMARY]
+   tables['range_summaries'] = { 't': timestamp[measurement_records[summaries]], 'peer': columns['uid'][summaries], 'mean_mm': columns['distance'][summaries],
+                                 'min_mm': columns['min'][summaries], 'max_mm': columns['max'][summaries], 'n': columns['n'][summaries] }
+   return tables
+
+def log_entries_to_columns(log_data, label_to_uid):
+   # Flatten dict-based log entries into the native decoder's column layout for when the decoder is unavailable
+   record_types, timestamps, values, uids, distances, minimums, maximums, counts = [], [], [], [], [], [], [], []
+   charging_events = { event: code for code, event in CHARGING_EVENT_NAMES.items() }
+   for entry in log_data:
+      for key, storage_type in (('v', STORAGE_TYPE_VOLTAGE), ('c', STORAGE_TYPE_CHARGING_EVENT), ('m', STORAGE_TYPE_MOTION)):
+         if key in entry:
+            record_types.append(storage_type)
+            timestamps.append(entry['t'])
+            values.append(charging_events.get(entry[key], 0) if key == 'c' else int(entry[key]))
+      if 'r' in entry:
+         summaries = entry.get('s') if entry.get('s', {}).keys() >= entry['r'].keys() else None
+         measurements = [(label, distance) for label, distance in entry['r'].items() if label in label_to_uid]
+         record_types.append(STORAGE_TYPE_RANGE_SUMMARY if summaries is not None else STORAGE_TYPE_RANGES)
+         timestamps.append(entry['t'])
+         values.append(len(measurements))
+         for label, distance in measurements:
+            summary = summaries[label] if summaries is not None else { 'min': 0, 'max': 0, 'n': 0 }
+            uids.append(label_to_uid[label])
+            distances.append(distance)
+            minimums.append(summary['min'])
+            maximums.append(summary['max'])
+            counts.append(summary['n'])
+   return { 'type': np.array(record_types, dtype='<u1'), 't': np.array(timestamps, dtype='<f8'), 'value': np.array(values, dtype='<i4'),
+            'uid': np.array(uids, dtype='<u1'), 'distance': np.array(distances, dtype='<i2'), 'min': np.array(minimums, dtype='<i2'),
+            'max': np.array(maximums, dtype='<i2'), 'n': np.array(counts, dtype='<u1') }
+
+
+# TABLE STORAGE -------------------------------------------------------------------------------------------------------
+
+def log_tables_path(storage_directory, label):
+   return os.path.join(storage_directory, label + LOG_TABLES_EXTENSION)
+
+def write_log_tables(path, tables, label, uid, experiment_start_time, peer_labels):
+   # Write every column to its own .npy file, replacing any previous tables for this TotTag only once all files are complete
+   partial_path = path + '.partial'
+   shutil.rmtree(partial_path, ignore_errors=True)
+   metadata = { 'format_version': LOG_TABLES_FORMAT_VERSION, 'label': label, 'uid': uid, 'experiment_start_time': experiment_start_time,
+                'peers': { str(peer_uid): peer_label for peer_uid, peer_label in peer_labels.items() }, 'tables': {} }
+   for name, column_types in LOG_TABLE_COLUMNS.items():
+      os.makedirs(os.path.join(partial_path, name))
+      for column, dtype in column_types.items():
+         np.save(os.path.join(partial_path, name, column + '.npy'), np.ascontiguousarray(tables[name][column], dtype=dtype))
+      table_metadata = { 'rows': int(len(tables[name]['t'])) }
+      if 'peer' in column_types:
+         peers, starts, counts = np.unique(tables[name]['peer'], return_index=True, return_counts=True)
+         table_metadata['peer_rows'] = { str(int(peer)): [int(start), int(start + count)] for peer, start, count in zip(peers, starts, counts) }
+      metadata['tables'][name] = table_metadata
+   with open(os.path.join(partial_path, LOG_TABLES_METADATA_FILE), 'w') as file:
+      json.dump(metadata, file, indent=1)
+   shutil.rmtree(path, ignore_errors=True)
+   os.rename(partial_path, path)
+
+
+# TABLE ACCESS --------------------------------------------------------------------------------------------------------
+
+def read_log_metadata(path):
+   with open(os.path.join(path, LOG_TABLES_METADATA_FILE), 'r') as file:
+      metadata = json.load(file)
+   if metadata['format_version'] > LOG_TABLES_FORMAT_VERSION:
+      raise ValueError('Log tables in {} use an unsupported format version {}'.format(path, metadata['format_version']))
+   return metadata
+
+def read_log_table(path, table, columns=None, peers=None, start_time=None, end_time=None):
+   # Memory-map only the requested columns and slice out the requested peers and time window without reading anything else
+   metadata = read_log_metadata(path)
+   columns = list(LOG_TABLE_COLUMNS[table]) if columns is None else list(columns)
+   timestamps = np.load(os.path.join(path, table, 't.npy'), mmap_mode='r')
+   if 'peer_rows' in metadata['tables'][table]:
+      label_to_uid = { peer_label: peer_uid for peer_uid, peer_label in metadata['peers'].items() }
+      peer_uids = metadata['tables'][table]['peer_rows'].keys() if peers is None else [label_to_uid.get(peer, peer) for peer in peers]
+      row_ranges = [metadata['tables'][table]['peer_rows'][str(peer)] for peer in peer_uids if str(peer) in metadata['tables'][table]['peer_rows']]
+   else:
+      row_ranges = [[0, metadata['tables'][table]['rows']]]
+
+   # Every peer's rows are sorted by time, so each time window is a contiguous slice
+   slices = []
+   for start, end in row_ranges:
+      first = start + (np.searchsorted(timestamps[start:end], start_time, 'left') if start_time is not None else 0)
+      last = start + (np.searchsorted(timestamps[start:end], end_time, 'left') if end_time is not None else end - start)
+      slices.append(slice(first, last))
+   result = {}
+   for column in columns:
+      values = np.load(os.path.join(path, table, column + '.npy'), mmap_mode='r')
+      result[column] = np.concatenate([values[rows] for rows in slices]) if slices else np.empty(0, dtype=LOG_TABLE_COLUMNS[table][column])
+   return result
+
+def read_peer_labels(path):
+   return { int(peer_uid): peer_label for peer_uid, peer_label in read_log_metadata(path)['peers'].items() }
+
+def read_log_time_bounds(path):
+   # Every table is time-sorted within each peer, so the first and last timestamps can be read without loading any table
+   metadata, first, last = read_log_metadata(path), None, None
+   for table in LOG_TABLE_COLUMNS:
+      timestamps = np.load(os.path.join(path, table, 't.npy'), mmap_mode='r')
+      row_ranges = metadata['tables'][table].get('peer_rows', { None: [0, metadata['tables'][table]['rows']] }).values()
+      for start, end in row_ranges:
+         if end > start:
+            first = timestamps[start] if first is None else min(first, timestamps[start])
+            last = timestamps[end - 1] if last is None else max(last, timestamps[end - 1])
+   return (float(first), float(last)) if first is not None else (None, None)
@@ -12,11 +12,19 @@ import numpy as np
 from matplotlib.widgets import Slider
 from matplotlib.widgets import TextBox
 import textwrap
+import os
 import re
+try:
+    from .log_tables import CHARGING_EVENT_NAMES, LOG_TABLES_EXTENSION, read_log_table, read_log_time_bounds, read_peer_labels
+except ImportError:
+    from log_tables import CHARGING_EVENT_NAMES, LOG_TABLES_EXTENSION, read_log_table, read_log_time_bounds, read_peer_labels
 
 # suppress the pandas scientific notation
 pd.options.display.float_format = '{:.3f}'.format
 
+# length of the time chunks that lazily loaded logs are materialized in
+DEFAULT_CHUNK_DURATION_S = 6 * 3600
+
 # HELPER FUNCTIONS ----------------------------------------------------------------------------------------------------
 
 def seconds_to_human_readable(seconds):
@@ -57,12 +65,88 @@ def extract_simple_event_log(logpath):
     #    print(f'{timestamp}: {event_dict[timestamp]}')
     return event_dict
 
+def load_log_tables(path, peers=None, start_timestamp=None, end_timestamp=None):
+    # Rebuild the wide per-timestamp layout of a pickled log, reading only the requested peers and time window
+    series = {}
+    voltage = read_log_table(path, 'voltage', start_time=start_timestamp, end_time=end_timestamp)
+    series['v'] = pd.Series(voltage['voltage_mv'], index=voltage['t'])
+    motion = read_log_table(path, 'motion', start_time=start_timestamp, end_time=end_timestamp)
+    series['m'] = pd.Series(motion['moving'] > 0, index=motion['t'])
+    charging = read_log_table(path, 'charging', start_time=start_timestamp, end_time=end_timestamp)
+    series['c'] = pd.Series([CHARGING_EVENT_NAMES.get(event, 'Unknown Battery Event') for event in charging['event']], index=charging['t'], dtype=object)
+    for uid, label in read_peer_labels(path).items():
+        if peers is not None and label not in peers:
+            continue
+        ranges = read_log_table(path, 'ranges', peers=[uid], start_time=start_timestamp, end_time=end_timestamp)
+        if len(ranges['t']):
+            series['r.' + label] = pd.Series(ranges['distance_mm'], index=ranges['t'])
+        summaries = read_log_table(path, 'range_summaries', columns=['t', 'min_mm', 'max_mm', 'n'], peers=[uid], start_time=start_timestamp, end_time=end_timestamp)
+        if len(summaries['t']):
+            for key, column in (('min', 'min_mm'), ('max', 'max_mm'), ('n', 'n')):
+                series['s.' + label + '.' + key] = pd.Series(summaries[column], index=summaries['t'])
+    data = pd.DataFrame({ key: values for key, values in series.items() if len(values) })
+    data.index.name = 't'
+    return data.sort_index()
+
 def load_data(filename):
-    with open(filename, 'rb') as file:
-        data = pd.json_normalize(data=pickle.load(file)).groupby('t').first()
+    if filename.rstrip(os.sep).endswith(LOG_TABLES_EXTENSION):
+        data = load_log_tables(filename)
+    else:
+        with open(filename, 'rb') as file:
+            data = pd.json_normalize(data=pickle.load(file)).groupby('t').first()
     return data.reindex(pd.Series(np.arange(data.head(1).index[0], data.tail(1).index[0], 0.5))).T \
            if data is not None and len(data.index) > 0 else None
 
+class LazyLogData:
+    # Stands in for the frame returned by load_data, but only ever materializes one fixed-size time chunk of the requested rows
+    def __init__(self, filename, start_timestamp=None, end_timestamp=None, chunk_duration=DEFAULT_CHUNK_DURATION_S):
+        self.filename = filename
+        self.chunk_duration = chunk_duration
+        if filename.rstrip(os.sep).endswith(LOG_TABLES_EXTENSION):
+            # Columnar logs are read straight from their memory-mapped tables one chunk at a time
+            self.sparse_data = None
+            self.peer_labels = list(read_peer_labels(filename).values())
+            first_timestamp, last_timestamp = read_log_time_bounds(filename)
+        else:
+            # Pickled logs must be unpickled in full, but are kept sparse until each chunk is requested
+            with open(filename, 'rb') as file:
+                self.sparse_data = pd.json_normalize(data=pickle.load(file)).groupby('t').first()
+            self.peer_labels = [key[2:] for key in self.sparse_data.columns if key.startswith('r.')]
+            first_timestamp = self.sparse_data.index[0] if len(self.sparse_data.index) > 0 else None
+            last_timestamp = self.sparse_data.index[-1] if len(self.sparse_data.index) > 0 else None
+        self.start_timestamp = start_timestamp if start_timestamp is not None else first_timestamp
+        self.end_timestamp = end_timestamp if end_timestamp is not None else (last_timestamp + 0.5 if last_timestamp is not None else None)
+
+    def read_sparse(self, peers, start_timestamp, end_timestamp):
+        if self.sparse_data is None:
+            return load_log_tables(self.filename, peers=peers, start_timestamp=start_timestamp, end_timestamp=end_timestamp)
+        return self.sparse_data[(self.sparse_data.index >= start_timestamp) & (self.sparse_data.index < end_timestamp)]
+
+    def chunks(self, rows, start_timestamp=None, end_timestamp=None):
+        # Yield the requested rows over consecutive 0.5 s grids, filtering by time before anything is materialized
+        start_timestamp = start_timestamp if start_timestamp is not None else self.start_timestamp
+        end_timestamp = end_timestamp if end_timestamp is not None else self.end_timestamp
+        if start_timestamp is None or end_timestamp is None:
+            return
+        peers = [row.split('.')[1] for row in rows if row.startswith('r.') or row.startswith('s.')]
+        num_steps, steps_per_chunk = int(np.ceil((end_timestamp - start_timestamp) / 0.5)), max(1, int(self.chunk_duration * 2))
+        for first_step in range(0, num_steps, steps_per_chunk):
+            timestamps = start_timestamp + (0.5 * np.arange(first_step, min(first_step + steps_per_chunk, num_steps)))
+            sparse_data = self.read_sparse(peers, timestamps[0], timestamps[-1] + 0.5)
+            yield sparse_data.reindex(index=pd.Series(timestamps), columns=rows).T
+
+def iterate_chunks(data, rows, start_timestamp=None, end_timestamp=None):
+    # Feed fully loaded and lazily loaded logs through the same chunk-by-chunk processing
+    if isinstance(data, LazyLogData):
+        yield from data.chunks(rows, start_timestamp, end_timestamp)
+    else:
+        data = data.loc[rows]
+        if start_timestamp is not None or end_timestamp is not None:
+            data = data.T.reindex(pd.Series(np.arange(start_timestamp if start_timestamp is not None else data.T.head(1).index[0],
+                                                      end_timestamp if end_timestamp is not None else 1+data.T.tail(1).index[0],
+                                                      0.5))).T
+        yield data
+
 def plot_data(title, x_axis_label, y_axis_label, x_axis_data, y_axis_data):
     plt.close()
     plt.title(title)
@@ -78,12 +162,23 @@ def plot_data(title, x_axis_label, y_axis_label, x_axis_data, y_axis_data):
 # DATA PROCESSING FUNCTIONALITY ---------------------------------------------------------------------------------------
 
 def get_voltage_time_series(data, tottag_label):
-    voltages = data.loc['v'].dropna()
+    voltages = pd.concat([chunk.loc['v'].dropna() for chunk in iterate_chunks(data, ['v'])])
     timestamps = mdates.date2num([datetime.fromtimestamp(ts) for ts in voltages.keys()])
     plot_data(f'Battery Voltage for {tottag_label}', 'Date and Time', 'Voltage (mV)', timestamps, voltages)
 
 def get_motion_time_series(data, tottag_label):
-    motions = data.loc['m'].ffill()
+    motions, last_motion = [], None
+    for chunk in iterate_chunks(data, ['m']):
+        # Carry the last known motion status across chunk boundaries
+        chunk_motions = chunk.loc['m']
+        if last_motion is not None and len(chunk_motions.index) > 0 and pd.isna(chunk_motions.iloc[0]):
+            chunk_motions = chunk_motions.copy()
+            chunk_motions.iloc[0] = last_motion
+        chunk_motions = chunk_motions.ffill()
+        if len(chunk_motions.index) > 0:
+            last_motion = chunk_motions.iloc[-1]
+        motions.append(chunk_motions)
+    motions = pd.concat(motions)
     timestamps = mdates.date2num([datetime.fromtimestamp(ts) for ts in motions.keys()])
     plot_data(f'Motion Status for {tottag_label}', 'Date and Time', 'Motion Status', timestamps, motions)
 
@@ -92,11 +187,13 @@ def extract_ranging_time_series(data, destination_tottag_label, start_timestamp=
         conversion_factor_from_mm = 304.8
     elif unit == 'm':
         conversion_factor_from_mm = 1000.0
-    ranges = data.loc['r.' + destination_tottag_label] / conversion_factor_from_mm
-    ranges = ranges.mask(ranges > cutoff_distance)\
-                   .reindex(pd.Series(np.arange(start_timestamp if start_timestamp is not None else data.T.head(1).index[0],
-                                                end_timestamp if end_timestamp is not None else 1+data.T.tail(1).index[0],
-                                                0.5)))
+    if end_timestamp is None and not isinstance(data, LazyLogData):
+        end_timestamp = 1+data.T.tail(1).index[0]
+    ranges = []
+    for chunk in iterate_chunks(data, ['r.' + destination_tottag_label], start_timestamp=start_timestamp, end_timestamp=end_timestamp):
+        chunk_ranges = chunk.loc['r.' + destination_tottag_label].astype(float) / conversion_factor_from_mm
+        ranges.append(chunk_ranges.mask(chunk_ranges > cutoff_distance))
+    ranges = pd.concat(ranges)
     timestamps = mdates.date2num([datetime.fromtimestamp(ts) for ts in ranges.keys()])
     return timestamps, ranges
 
@@ -106,27 +203,33 @@ def get_ranging_time_series(data, source_tottag_label, destination_tottag_label,
               'Date and Time', f'Range ({unit})', timestamps, ranges)
 
 def get_daily_ranging_statistics(data, target_tottag_labels, max_touching_distance, unit='ft'):
-    ranges = data.loc[['r.' + label for label in target_tottag_labels]] / (304.8 if unit == 'ft' else 1000.0)
-    dates = [datetime.fromtimestamp(ts).day for ts in ranges.keys()]
-    day_change_indices = np.where(np.roll(dates, 1) != dates)[0]
-    for i in range(len(day_change_indices)):
-        print(f'\nRanging Statistics on {datetime.fromtimestamp(ranges.keys()[day_change_indices[i]]).strftime("%m/%d/%Y")}:')
-        day_ranges = ranges.T.iloc[day_change_indices[i]:(day_change_indices[i+1] if (i + 1) < len(day_change_indices) else ranges.count().count())]
-        for target in day_ranges.keys():
-            print(f'   Statistics to {target}:')
-            in_range_data = day_ranges[target].dropna()
-            touching_distance_data = day_ranges[target].mask(day_ranges[target] > max_touching_distance).dropna()
-            minutes_in_range = 1 + (len(in_range_data.index) // 120)
-            minutes_in_touching_distance = 1 + (len(touching_distance_data.index) // 120)
-            mean_distance_in_range = in_range_data.mean()
-            print(f'      Minutes in Range: {minutes_in_range}\n      Minutes in Touching Distance: {minutes_in_touching_distance}\n      Mean Distance While in Range: {mean_distance_in_range}')
-        if len(target_tottag_labels) > 1:
-            print(f'   Statistics to Either of {target_tottag_labels}:')
-            in_range_data = day_ranges.dropna(how='all')
-            touching_distance_data = day_ranges.mask(day_ranges > max_touching_distance).dropna(how='all')
-            minutes_in_range = 1 + (len(in_range_data.index) // 120)
-            minutes_in_touching_distance = 1 + (len(touching_distance_data.index) // 120)
-            mean_distance_in_range = pd.concat([in_range_data[col] for col in in_range_data.columns]).mean()
+    # Accumulate the number of samples in range and in touching distance, and the sum and count of in-range distances, for each day
+    daily_statistics = {}
+    for chunk in iterate_chunks(data, ['r.' + label for label in target_tottag_labels]):
+        ranges = chunk.astype(float) / (304.8 if unit == 'ft' else 1000.0)
+        dates = np.array([datetime.fromtimestamp(ts).date() for ts in ranges.keys()])
+        for date in dict.fromkeys(dates):
+            day_ranges = ranges.T[dates == date]
+            statistics = daily_statistics.setdefault(date, { target: [0, 0, 0.0, 0] for target in list(day_ranges.keys()) + [None] })
+            for target in day_ranges.keys():
+                in_range_data = day_ranges[target].dropna()
+                statistics[target][0] += len(in_range_data.index)
+                statistics[target][1] += len(in_range_data[in_range_data <= max_touching_distance].index)
+                statistics[target][2] += in_range_data.sum()
+                statistics[target][3] += len(in_range_data.index)
+            statistics[None][0] += len(day_ranges.dropna(how='all').index)
+            statistics[None][1] += len(day_ranges.mask(day_ranges > max_touching_distance).dropna(how='all').index)
+            statistics[None][2] += np.nansum(day_ranges.values)
+            statistics[None][3] += np.count_nonzero(~np.isnan(day_ranges.values))
+    for date, statistics in daily_statistics.items():
+        print(f'\nRanging Statistics on {date.strftime("%m/%d/%Y")}:')
+        for target, (num_in_range, num_in_touching_distance, total_distance, num_distances) in statistics.items():
+            if target is None and len(target_tottag_labels) <= 1:
+                continue
+            print(f'   Statistics to {target}:' if target is not None else f'   Statistics to Either of {target_tottag_labels}:')
+            minutes_in_range = 1 + (num_in_range // 120)
+            minutes_in_touching_distance = 1 + (num_in_touching_distance // 120)
+            mean_distance_in_range = total_distance / num_distances if num_distances > 0 else np.nan
             print(f'      Minutes in Range: {minutes_in_range}\n      Minutes in Touching Distance: {minutes_in_touching_distance}\n      Mean Distance While in Range: {mean_distance_in_range}')
 
 def visualize_ranging_pair_slider(data1, data2, label1, label2, start_timestamp=None, end_timestamp=None, unit='ft', events=dict()):
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import argparse, concurrent.futures, csv, itertools, os
+import numpy as np
+from numpy.lib.stride_tricks import sliding_window_view
+try:
+   from .cohort_statistics import find_log_tables
+   from .log_tables import read_log_metadata, read_log_table
+except ImportError:
+   from cohort_statistics import find_log_tables
+   from log_tables import read_log_metadata, read_log_table
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+SAMPLE_PERIOD_S = 0.5
+DEFAULT_MAX_OFFSET_S = 30.0
+DEFAULT_ALIGNMENT_WINDOW_S = 3600.0
+DEFAULT_AGREEMENT_TOLERANCE_MM = 300
+MIN_WINDOW_MATCHES = 120
+MAX_LAG_SCORE_RATIO = 0.8
+MAX_FIT_RESIDUAL_ROUNDS = 1.0
+MIN_DRIFT_FIT_SPAN_S = 6 * 3600
+
+
+# ROUND-INDEXED RANGES ------------------------------------------------------------------------------------------------
+
+def read_directed_rounds(path, peer_label):
+   # A TotTag's ranges to one peer, indexed by ranging round, keeping the last range logged for any round
+   if path is None:
+      return np.empty(0, dtype=np.int64), np.empty(0)
+   ranges = read_log_table(path, 'ranges', columns=['t', 'distance_mm'], peers=[peer_label])
+   rounds = np.rint(ranges['t'] / SAMPLE_PERIOD_S).astype(np.int64)
+   last = np.append(rounds[1:] != rounds[:-1], True) if len(rounds) else np.empty(0, dtype=bool)
+   return rounds[last], ranges['distance_mm'][last].astype(np.float64)
+
+def to_reference_rounds(rounds, clock):
+   # Undo a TotTag's estimated clock offset and drift, both expressed relative to the reference TotTag
+   offset_rounds, drift, epoch_round = clock
+   return np.rint(rounds - offset_rounds - (drift * (rounds - epoch_round))).astype(np.int64)
+
+
+# PAIRWISE CLOCK ALIGNMENT --------------------------------------------------------------------------------------------
+
+def window_lag_estimates(rounds_a, distances_a, rounds_b, distances_b, window_rounds, max_lag_rounds):
+   # For every window of A's ranges, find the shift of B's clock that best lines up B's ranges with A's ranges of the same rounds
+   #   Only windows in which the best shift clearly beats a typical one can pin it down, since a constant distance matches at any shift.
+   centers, lags, weights = [], [], []
+   for window in np.unique(rounds_a // window_rounds):
+      first_round = window * window_rounds
+      in_a = slice(*np.searchsorted(rounds_a, [first_round, first_round + window_rounds]))
+      in_b = slice(*np.searchsorted(rounds_b, [first_round - max_lag_rounds, first_round + window_rounds + max_lag_rounds]))
+      if (in_a.stop - in_a.start) < MIN_WINDOW_MATCHES or (in_b.stop - in_b.start) < MIN_WINDOW_MATCHES:
+         continue
+      dense_a = np.full(window_rounds, np.nan)
+      dense_a[rounds_a[in_a] - first_round] = distances_a[in_a]
+      dense_b = np.full(window_rounds + (2 * max_lag_rounds), np.nan)
+      dense_b[rounds_b[in_b] - first_round + max_lag_rounds] = distances_b[in_b]
+
+      # Row k of the shifted view holds B's ranges from k - max_lag_rounds rounds later than each of A's rounds
+      differences = np.abs(sliding_window_view(dense_b, window_rounds) - dense_a)
+      matches = np.count_nonzero(~np.isnan(differences), axis=1)
+      with np.errstate(invalid='ignore', divide='ignore'):
+         scores = np.where(matches >= MIN_WINDOW_MATCHES, np.nansum(differences, axis=1) / matches, np.inf)
+      best = int(np.argmin(scores))
+      if not np.isfinite(scores[best]) or scores[best] > MAX_LAG_SCORE_RATIO * np.median(scores[np.isfinite(scores)]):
+         continue
+
+      # Clocks rarely differ by a whole number of rounds, so refine the best shift with a parabola through its neighbors
+      lag = float(best - max_lag_rounds)
+      if 0 < best < len(scores) - 1 and np.isfinite(scores[best - 1]) and np.isfinite(scores[best + 1]):
+         curvature = scores[best - 1] - (2.0 * scores[best]) + scores[best + 1]
+         if curvature > 0:
+            lag += 0.5 * (scores[best - 1] - scores[best + 1]) / curvature
+      centers.append(first_round + (window_rounds // 2))
+      lags.append(lag)
+      weights.append(matches[best])
+   return np.array(centers, dtype=np.int64), np.array(lags, dtype=np.float64), np.array(weights, dtype=np.float64)
+
+def fit_clock_difference(centers, lags, weights, epoch_round):
+   # Weighted straight-line fit of B's clock lead over A's versus time, refitted once without windows that clearly disagree with it
+   #   Windows bunched into a few hours say little about drift, so only the offset is fitted unless they span long enough.
+   if len(centers) == 0:
+      return None
+   keep = np.ones(len(centers), dtype=bool)
+   for _ in range(2):
+      x, y, w = (centers[keep] - epoch_round).astype(np.float64), lags[keep], weights[keep]
+      if np.ptp(x) * SAMPLE_PERIOD_S >= MIN_DRIFT_FIT_SPAN_S:
+         drift, offset = np.polyfit(x, y, 1, w=np.sqrt(w))
+      else:
+         drift, offset = 0.0, np.average(y, weights=w)
+      residuals = np.abs(lags - (offset + (drift * (centers - epoch_round))))
+      if np.array_equal(keep, residuals <= MAX_FIT_RESIDUAL_ROUNDS) or not np.any(residuals <= MAX_FIT_RESIDUAL_ROUNDS):
+         break
+      keep = residuals <= MAX_FIT_RESIDUAL_ROUNDS
+   return float(offset), float(drift), float(weights[keep].sum())
+
+def pair_alignment(task):
+   # Each unordered pair only touches its own two range slices, so pairs can be aligned independently on any core
+   label_a, path_a, label_b, path_b, epoch_round, params = task
+   rounds_a, distances_a = read_directed_rounds(path_a, label_b)
+   rounds_b, distances_b = read_directed_rounds(path_b, label_a)
+   estimates = window_lag_estimates(rounds_a, distances_a, rounds_b, distances_b, params['window_rounds'], params['max_lag_rounds'])
+   return label_a, label_b, fit_clock_difference(*estimates, epoch_round)
+
+def solve_tag_clocks(labels, pair_fits, reference_label, epoch_round):
+   # Find the per-TotTag offsets and drifts relative to the reference TotTag that best explain every pairwise clock difference
+   #   Each pair contributes offset_b - offset_a and drift_b - drift_a equations weighted by how many matched ranges support them.
+   index = { label: i for i, label in enumerate(labels) }
+   rows, offsets, drifts, weights = [], [], [], []
+   for label_a, label_b, fit in pair_fits:
+      if fit is not None:
+         row = np.zeros(len(labels))
+         row[index[label_a]], row[index[label_b]] = -1.0, 1.0
+         rows.append(row)
+         offsets.append(fit[0])
+         drifts.append(fit[1])
+         weights.append(np.sqrt(fit[2]))
+   anchor = np.zeros(len(labels))
+   anchor[index[reference_label]] = 1.0
+   row_weights = np.array(weights + [max(weights, default=1.0) * 1e3])
+   system = np.vstack(rows + [anchor]) * row_weights[:, None]
+   solved_offsets = np.linalg.lstsq(system, np.array(offsets + [0.0]) * row_weights, rcond=None)[0]
+   solved_drifts = np.linalg.lstsq(system, np.array(drifts + [0.0]) * row_weights, rcond=None)[0]
+   supporting_pairs = { label: sum(1 for label_a, label_b, fit in pair_fits if fit is not None and label in (label_a, label_b)) for label in labels }
+   solved_offsets[index[reference_label]] = solved_drifts[index[reference_label]] = 0.0
+   return { label: (float(solved_offsets[i]), float(solved_drifts[i]), epoch_round) for label, i in index.items() }, supporting_pairs
+
+
+# RECONCILIATION ------------------------------------------------------------------------------------------------------
+
+def reconcile_pair(task):
+   # Join both directions of a pair on the reference clock's rounds and combine them into one range series
+   label_a, path_a, clock_a, label_b, path_b, clock_b, params = task
+   rounds_a, distances_a = read_directed_rounds(path_a, label_b)
+   rounds_b, distances_b = read_directed_rounds(path_b, label_a)
+   rounds_a, rounds_b = to_reference_rounds(rounds_a, clock_a), to_reference_rounds(rounds_b, clock_b)
+   unique_a, unique_b = np.append(rounds_a[1:] != rounds_a[:-1], True), np.append(rounds_b[1:] != rounds_b[:-1], True)
+   rounds_a, distances_a, rounds_b, distances_b = rounds_a[unique_a], distances_a[unique_a], rounds_b[unique_b], distances_b[unique_b]
+   rounds = np.union1d(rounds_a, rounds_b)
+   series_a, series_b = np.full(len(rounds), np.nan), np.full(len(rounds), np.nan)
+   series_a[np.searchsorted(rounds, rounds_a)] = distances_a
+   series_b[np.searchsorted(rounds, rounds_b)] = distances_b
+
+   # Matched rounds are averaged and scored, while rounds seen from only one side keep that side's range
+   matched = ~np.isnan(series_a) & ~np.isnan(series_b)
+   differences = np.abs(series_a[matched] - series_b[matched])
+   reconciled = np.where(matched, 0.5 * (series_a + series_b), np.where(np.isnan(series_a), series_b, series_a))
+   summary = { 'matched_rounds': int(matched.sum()), 'only_a_rounds': int((~np.isnan(series_a) & ~matched).sum()), 'only_b_rounds': int((~np.isnan(series_b) & ~matched).sum()),
+               'mean_absolute_difference_mm': float(differences.mean()) if len(differences) else np.nan,
+               'agreement': float(np.mean(differences <= params['agreement_tolerance_mm'])) if len(differences) else np.nan }
+   return label_a, label_b, rounds * SAMPLE_PERIOD_S, series_a, series_b, reconciled, summary
+
+
+# TOP-LEVEL PIPELINE --------------------------------------------------------------------------------------------------
+
+def alignment_parameters(max_offset_s=DEFAULT_MAX_OFFSET_S, window_s=DEFAULT_ALIGNMENT_WINDOW_S, agreement_tolerance_mm=DEFAULT_AGREEMENT_TOLERANCE_MM):
+   return { 'max_lag_rounds': int(round(max_offset_s / SAMPLE_PERIOD_S)), 'window_rounds': int(round(window_s / SAMPLE_PERIOD_S)),
+            'agreement_tolerance_mm': agreement_tolerance_mm }
+
+def run_tasks(function, tasks, num_workers):
+   if num_workers == 1:
+      return list(map(function, tasks))
+   with concurrent.futures.ProcessPoolExecutor(max_workers=num_workers) as executor:
+      return list(executor.map(function, tasks, chunksize=max(1, len(tasks) // (4 * (num_workers or os.cpu_count() or 1)))))
+
+def reconcile_deployment(logs, params, reference_label=None, num_workers=None):
+   # Only pairs with both directions logged can be aligned, but every pair with either direction is reconciled
+   labels = sorted(logs)
+   reference_label = reference_label or labels[0]
+   epoch_round = int(round(min(read_log_metadata(path)['experiment_start_time'] for path in logs.values()) / SAMPLE_PERIOD_S))
+   pair_fits = run_tasks(pair_alignment, [(label_a, logs[label_a], label_b, logs[label_b], epoch_round, params)
+                                          for label_a, label_b in itertools.combinations(labels, 2)], num_workers)
+   clocks, supporting_pairs = solve_tag_clocks(labels, pair_fits, reference_label, epoch_round)
+   peers = sorted(set(labels) | { peer for path in logs.values() for peer in read_log_metadata(path)['peers'].values() })
+   no_correction = (0.0, 0.0, epoch_round)
+   reconciled = run_tasks(reconcile_pair, [(label_a, logs.get(label_a), clocks.get(label_a, no_correction), label_b, logs.get(label_b), clocks.get(label_b, no_correction), params)
+                                           for label_a, label_b in itertools.combinations(peers, 2) if label_a in logs or label_b in logs], num_workers)
+   return reference_label, clocks, supporting_pairs, pair_fits, reconciled
+
+def range_text(distances):
+   return np.where(np.isnan(distances), '', np.char.mod('%d', np.nan_to_num(distances).astype(np.int64)))
+
+def write_reconciliation(output_directory, reference_label, clocks, supporting_pairs, pair_fits, reconciled):
+   os.makedirs(output_directory, exist_ok=True)
+   with open(os.path.join(output_directory, 'clock_alignment.csv'), 'w', newline='') as file:
+      writer = csv.writer(file)
+      writer.writerow(['tottag', 'reference', 'offset_s', 'drift_ppm', 'aligned_pairs'])
+      for label, (offset_rounds, drift, _) in clocks.items():
+         writer.writerow([label, reference_label, offset_rounds * SAMPLE_PERIOD_S, drift * 1e6, supporting_pairs[label]])
+   fits = { (label_a, label_b): fit for label_a, label_b, fit in pair_fits }
+   with open(os.path.join(output_directory, 'pair_agreement.csv'), 'w', newline='') as file:
+      writer = csv.writer(file)
+      writer.writerow(['tottag_a', 'tottag_b', 'measured_offset_s', 'measured_drift_ppm', 'matched_rounds', 'only_a_rounds', 'only_b_rounds', 'mean_absolute_difference_mm', 'agreement'])
+      for label_a, label_b, _, _, _, _, summary in reconciled:
+         fit = fits.get((label_a, label_b))
+         writer.writerow([label_a, label_b, fit[0] * SAMPLE_PERIOD_S if fit else '', fit[1] * 1e6 if fit else '', summary['matched_rounds'], summary['only_a_rounds'],
+                          summary['only_b_rounds'], summary['mean_absolute_difference_mm'], summary['agreement']])
+   with open(os.path.join(output_directory, 'reconciled_ranges.csv'), 'w', newline='') as file:
+      writer = csv.writer(file)
+      writer.writerow(['tottag_a', 'tottag_b', 't', 'distance_a_mm', 'distance_b_mm', 'reconciled_mm'])
+      for label_a, label_b, timestamps, series_a, series_b, series, _ in reconciled:
+         columns = (np.full(len(timestamps), label_a), np.full(len(timestamps), label_b), np.char.mod('%.1f', timestamps), range_text(series_a), range_text(series_b), np.char.mod('%.1f', series))
+         writer.writerows(zip(*columns))
+
+def main():
+   parser = argparse.ArgumentParser(description='Align TotTag clocks using symmetric ranges and reconcile both directions of every pair into one range series')
+   parser.add_argument('logs', nargs='+', help='Deployment folders or individual .ttgc logs')
+   parser.add_argument('--output', default='.', help='Folder in which to write clock_alignment.csv, pair_agreement.csv and reconciled_ranges.csv')
+   parser.add_argument('--reference', default=None, help='TotTag whose clock all others are aligned to (default: the first label)')
+   parser.add_argument('--workers', type=int, default=None, help='Number of worker processes (default: one per core)')
+   parser.add_argument('--max-offset-s', type=float, default=DEFAULT_MAX_OFFSET_S, help='Largest clock offset between two TotTags to search for')
+   parser.add_argument('--window-s', type=float, default=DEFAULT_ALIGNMENT_WINDOW_S, help='Length of each window over which one clock offset is measured')
+   parser.add_argument('--agreement-tolerance-mm', type=int, default=DEFAULT_AGREEMENT_TOLERANCE_MM, help='Maximum difference for symmetric ranges to agree')
+   args = parser.parse_args()
+   logs = find_log_tables(args.logs)
+   if not logs:
+      parser.error('No .ttgc logs were found')
+   if args.reference is not None and args.reference not in logs:
+      parser.error('The reference TotTag {} has no log'.format(args.reference))
+   params = alignment_parameters(args.max_offset_s, args.window_s, args.agreement_tolerance_mm)
+   results = reconcile_deployment(logs, params, args.reference, args.workers)
+   write_reconciliation(args.output, *results)
+   print('Aligned {} TotTag clocks to {} and reconciled {} pairs into {}'.format(len(results[1]), results[0], len(results[4]), os.path.abspath(args.output)))
+
+if __name__ == "__main__":
+   main()
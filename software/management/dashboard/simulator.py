@@ -0,0 +1,681 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# PYTHON INCLUSIONS ---------------------------------------------------------------------------------------------------
+
+import argparse, asyncio, collections, os, queue, random, shutil, struct, tempfile, time, zlib
+import numpy as np
+try:
+   from .tottag import *
+except ImportError:
+   from tottag import *
+
+
+# CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
+
+SIMULATED_ADDRESS_FORMAT = 'C0:98:E5:42:00:{:02X}'
+SIMULATED_MTU = 247
+SIMULATED_CONNECTION_INTERVAL_S = 0.0075
+SIMULATED_LIVE_CONNECTION_INTERVAL_S = 0.03
+SIMULATED_RADIO_SLOT_S = 0.00125
+SIMULATED_CONTROLLER_ACL_BUFFERS = (2, 4)
+MAX_NUM_CONNECTIONS = 3
+SIMULATED_RANGING_PERIOD_S = 0.5
+SIMULATED_BATTERY_VOLTAGE_MV = 3950
+MAX_RANGE_BATCH_NUM_ROUNDS = 8
+
+STREAM_HEADER_LENGTH = 3
+SIMULATED_PACKETS_PER_CONNECTION_EVENT = 4
+STREAM_MAX_PACKETS_IN_FLIGHT = 16
+STREAM_SHARED_MAX_PACKETS_IN_FLIGHT = 2
+ATT_ERR_RESOURCES = 0x11
+MAINTENANCE_DOWNLOAD_COMMANDS = (MAINTENANCE_DOWNLOAD_LOG, MAINTENANCE_SET_LOG_DOWNLOAD_DATES, MAINTENANCE_DOWNLOAD_LOG_STREAMED,
+                                 MAINTENANCE_DOWNLOAD_ACK, MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS, MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION)
+LOG_COMPRESSION_MAX_STRIDE = 32
+
+LINK_STATUS_IDLE = (24, 0, 400, 1, 1, 0, 27, 27)
+LINK_STATUS_BULK = (6, 0, 400, 2, 2, 1, 251, 251)
+
+
+# LOG DATA GENERATION -------------------------------------------------------------------------------------------------
+
+def synthesize_log_data(duration_s, num_neighbors, seed=0):
+   # Random-walk the distance to each neighbor and store records exactly as the storage task lays them out
+   rng = random.Random(seed)
+   distances = [rng.randint(500, 5000) for _ in range(num_neighbors)]
+   data = bytearray()
+   for i in range(int(duration_s * 2)):
+      timestamp = (i + 1) * 500
+      for j in range(num_neighbors):
+         distances[j] = min(max(distances[j] + rng.randint(-40, 40), 100), MAX_RANGING_DISTANCE_MM - 1)
+      data += struct.pack('<BIB', STORAGE_TYPE_RANGES, timestamp, num_neighbors)
+      data += b''.join(struct.pack('<BH', j + 1, distances[j]) for j in range(num_neighbors))
+      if rng.random() < 0.02:
+         data += struct.pack('<BIB', STORAGE_TYPE_MOTION, timestamp, rng.randint(0, 1))
+      if (i % 120) == 0:
+         data += struct.pack('<BII', STORAGE_TYPE_VOLTAGE, timestamp, SIMULATED_BATTERY_VOLTAGE_MV + rng.randint(-20, 20))
+   return bytes(data)
+
+def synthesize_experiment_details(start_time, duration_s, num_devices, labels=None):
+   return pack_experiment_details({
+      'start_time': start_time,
+      'end_time': start_time + int(duration_s),
+      'daily_start_time': 0,
+      'daily_end_time': 0,
+      'use_daily_times': 0,
+      'num_devices': num_devices,
+      'uids': [[i + 1, 0, 0x42, 0xE5, 0x98, 0xC0] if i < num_devices else [0] * 6 for i in range(MAX_NUM_DEVICES)],
+      'labels': [((labels[i] if labels else 'TotTag{}'.format(i + 1)) if i < num_devices else '').encode() for i in range(MAX_NUM_DEVICES)]
+   })[1:]
+
+def split_into_pages(data):
+   return [data[i:i+MEMORY_NUM_DATA_BYTES_PER_PAGE] for i in range(0, len(data), MEMORY_NUM_DATA_BYTES_PER_PAGE)]
+
+def log_compression_encode(page):
+   # Mirror log_compression_encode() from the firmware so that the host decoder sees byte-identical chunks
+   data = np.frombuffer(page, dtype=np.uint8).astype(np.int32)
+   best_residuals, best_num_nonzero, best_mode = None, len(data), 1
+   for second_order in (False, True):
+      for stride in range(1, LOG_COMPRESSION_MAX_STRIDE + 1):
+         previous = np.concatenate((np.zeros(stride, dtype=np.int32), data[:-stride]))[:len(data)]
+         if second_order:
+            before_previous = np.concatenate((np.zeros(2 * stride, dtype=np.int32), data[:-2*stride]))[:len(data)]
+            residuals = (data - (2 * previous) + before_previous) & 0xFF
+         else:
+            residuals = (data - previous) & 0xFF
+         num_nonzero = int(np.count_nonzero(residuals))
+         if best_residuals is None or num_nonzero < best_num_nonzero:
+            best_residuals, best_num_nonzero = residuals, num_nonzero
+            best_mode = stride | (LOG_COMPRESSION_SECOND_ORDER_FLAG if second_order else 0)
+   num_groups = (len(data) + 7) // 8
+   header_length = struct.calcsize(LOG_COMPRESSION_HEADER_FORMAT)
+   if header_length + num_groups + best_num_nonzero > len(data):
+      return bytes([LOG_ENCODING_RAW]) + bytes(page)
+
+   # Interleave each group's bitmap with the nonzero residuals that follow it
+   residuals = np.zeros(num_groups * 8, dtype=np.uint8)
+   residuals[:len(data)] = best_residuals
+   nonzero = residuals != 0
+   bitmaps = np.packbits(nonzero.reshape(-1, 8), axis=1, bitorder='little').ravel()
+   group_counts = nonzero.reshape(-1, 8).sum(axis=1)
+   bitmap_positions = np.arange(num_groups) + np.concatenate(([0], np.cumsum(group_counts)[:-1]))
+   nonzero_indices = np.flatnonzero(nonzero)
+   encoded = np.zeros(num_groups + best_num_nonzero, dtype=np.uint8)
+   encoded[bitmap_positions] = bitmaps
+   encoded[np.arange(len(nonzero_indices)) + (nonzero_indices // 8) + 1] = residuals[nonzero_indices]
+   return struct.pack(LOG_COMPRESSION_HEADER_FORMAT, LOG_ENCODING_DELTA, best_mode, len(data)) + encoded.tobytes()
+
+
+# SIMULATED TOTTAG PERIPHERAL -----------------------------------------------------------------------------------------
+
+def pack_live_range_broadcast(sequence, results):
+   # Mirror the firmware scan response: round sequence, neighbor EUIs, then ranges packed as 12-bit centimeter values
+   num_ranges = min(results[0], MAX_NUM_DEVICES)
+   euis, packed_ranges = bytearray(), 0
+   for i in range(num_ranges):
+      eui, range_mm = struct.unpack('<Bh', results[1+3*i:4+3*i])
+      euis.append(eui)
+      packed_ranges |= (((range_mm + 5) // 10) if range_mm > 0 else 0) << (BROADCAST_RANGE_BITS_PER_RANGE * i)
+   packed_length = ((BROADCAST_RANGE_BITS_PER_RANGE * num_ranges) + 7) // 8
+   return bytes([sequence & 0xFF, num_ranges]) + bytes(euis) + packed_ranges.to_bytes(packed_length, 'little')
+
+
+class SimulatedTotTag:
+
+   def __init__(self, address, pages, details, packet_loss=0.0, disconnect_after_packets=0, seed=None):
+      self.address = address
+      self.name = 'TotTag'
+      self.pages = pages
+      self.details = bytes(details)
+      self.packet_loss = packet_loss
+      self.disconnect_after_packets = disconnect_after_packets
+      self.random = random.Random(seed)
+      self.encoded_pages = {}
+      self.timestamp_offset = 0
+      self.num_packets_sent = 0
+      self.clients = []
+      self.download_owner = None
+      self.link_status = LINK_STATUS_IDLE
+      self.last_transfer = (0, 0)
+      self.download_start_timestamp = self.download_end_timestamp = 0
+      self.stream_first_chunk = self.stream_max_chunks = 0
+      self.stream_compressed = False
+      self.is_streaming = False
+      self.legacy_packets = None
+      self.broadcast_sequence = 0
+      self.range_batch = bytearray()
+      self.range_batch_num_rounds = 1
+      self.range_round_sequence = 0
+      self.distances = [self.random.randint(500, 5000) for _ in range(min(unpack_experiment_details(self.details)['num_devices'], MAX_NUM_DEVICES))]
+
+   def read(self, uuid):
+      if uuid == TIMESTAMP_SERVICE_UUID:
+         return struct.pack('<I', int(time.time()) + self.timestamp_offset)
+      elif uuid == VOLTAGE_SERVICE_UUID:
+         return struct.pack('<H', SIMULATED_BATTERY_VOLTAGE_MV)
+      elif uuid == STORAGE_STATUS_SERVICE_UUID:
+         return struct.pack('<BBI', 0, min(100, len(self.pages) * 100 // 65536), 0xFFFFFFFF)
+      elif uuid == EXPERIMENT_SERVICE_UUID:
+         return self.details
+      elif uuid == MAINTENANCE_LINK_STATUS_SERVICE_UUID:
+         return struct.pack(LINK_STATUS_FORMAT, *self.link_status, *self.last_transfer)
+      raise ValueError('Characteristic {} is not readable'.format(uuid))
+
+   def write(self, uuid, data, mtu, client=None):
+      # Only one central at a time may drive a log download, since storage has a single read cursor
+      if uuid == MAINTENANCE_COMMAND_SERVICE_UUID and data[0] in MAINTENANCE_DOWNLOAD_COMMANDS:
+         if self.download_owner is not None and self.download_owner is not client:
+            raise ConnectionRefusedError('ATT error 0x{:02X}: Simulated TotTag {} is downloading to another central'.format(ATT_ERR_RESOURCES, self.address))
+         elif data[0] in (MAINTENANCE_DOWNLOAD_LOG, MAINTENANCE_DOWNLOAD_LOG_STREAMED):
+            self.download_owner = client
+
+      # Handle each command exactly as the maintenance and live-stats services do
+      if uuid == TIMESTAMP_SERVICE_UUID:
+         self.timestamp_offset = struct.unpack('<I', data[0:4])[0] - int(time.time())
+      elif uuid == FIND_MY_TOTTAG_SERVICE_UUID:
+         print('Simulated TotTag {}: Find My TotTag activated for {} seconds'.format(self.address, struct.unpack('<I', data[0:4])[0]))
+      elif uuid != MAINTENANCE_COMMAND_SERVICE_UUID:
+         raise ValueError('Characteristic {} is not writable'.format(uuid))
+      elif data[0] == MAINTENANCE_NEW_EXPERIMENT:
+         self.details = bytes(data[1:1+EXPERIMENT_DETAILS_LENGTH])
+      elif data[0] == MAINTENANCE_DELETE_EXPERIMENT:
+         self.details = bytes(EXPERIMENT_DETAILS_LENGTH)
+      elif data[0] == MAINTENANCE_SET_LOG_DOWNLOAD_DATES:
+         self.download_start_timestamp, self.download_end_timestamp = struct.unpack('<II', data[1:9])
+         self.stream_first_chunk = self.stream_max_chunks = 0
+         self.stream_compressed = False
+      elif data[0] == MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION:
+         self.stream_compressed = bool(data[1])
+      elif data[0] == MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS:
+         self.stream_first_chunk, self.stream_max_chunks = struct.unpack('<II', data[1:9])
+      elif data[0] == MAINTENANCE_SET_RANGE_BATCHING:
+         self.set_range_batch_size(data[1])
+      elif data[0] == MAINTENANCE_DOWNLOAD_LOG:
+         self.is_streaming = False
+         self.start_bulk_transfer()
+         self.legacy_packets = self.legacy_log_packets(mtu - 3)
+      elif data[0] == MAINTENANCE_DOWNLOAD_LOG_STREAMED:
+         self.legacy_packets = None
+         self.start_bulk_transfer()
+         self.start_streaming_log_data(mtu)
+      elif data[0] == MAINTENANCE_DOWNLOAD_ACK:
+         self.handle_stream_acknowledgment(*struct.unpack('<HI', data[1:7]))
+
+   def start_bulk_transfer(self):
+      self.link_status = LINK_STATUS_BULK
+      self.download_num_bytes = 0
+      self.download_start_time = time.time()
+
+   def finish_bulk_transfer(self):
+      self.last_transfer = (self.download_num_bytes, int((time.time() - self.download_start_time) * 1000))
+      self.link_status = LINK_STATUS_IDLE
+      self.download_owner = None
+
+   def stop_sending_log_data(self, client):
+      if client is self.download_owner:
+         self.is_streaming = False
+         self.legacy_packets = None
+         self.download_owner = None
+
+   def max_packets_in_flight(self):
+      # Leave room in the shared HCI transmit queue for other centrals while they are connected
+      return STREAM_SHARED_MAX_PACKETS_IN_FLIGHT if len(self.clients) > 1 else STREAM_MAX_PACKETS_IN_FLIGHT
+
+   def retrieve_chunk(self, index):
+      return self.pages[index] if index < len(self.pages) else b''
+
+   def encode_chunk(self, index):
+      if index not in self.encoded_pages:
+         self.encoded_pages[index] = log_compression_encode(self.pages[index])
+      return self.encoded_pages[index]
+
+   def legacy_log_packets(self, max_length):
+      # Kick off reading with a meaningless packet, then send the header, all data, and a completion packet
+      yield b'\x00'
+      yield struct.pack('<I', len(self.pages) * MEMORY_NUM_DATA_BYTES_PER_PAGE) + self.details
+      data = b''.join(self.pages)
+      for i in range(0, len(data), max_length):
+         self.download_num_bytes += min(max_length, len(data) - i)
+         yield data[i:i+max_length]
+      self.finish_bulk_transfer()
+      yield bytes([MAINTENANCE_DOWNLOAD_COMPLETE])
+
+   def start_streaming_log_data(self, mtu):
+      # Skip any chunks that the host already has and limit the download to the requested number of chunks
+      self.stream_num_available_chunks = len(self.pages)
+      self.stream_total_data_chunks = max(self.stream_num_available_chunks - self.stream_first_chunk, 0)
+      if self.stream_max_chunks:
+         self.stream_total_data_chunks = min(self.stream_total_data_chunks, self.stream_max_chunks)
+
+      # Reset all streaming variables and place the estimated length and experiment details at the beginning
+      self.stream_buffer = bytearray(struct.pack('<I', self.stream_total_data_chunks * MEMORY_NUM_DATA_BYTES_PER_PAGE) + self.details)
+      self.stream_max_payload = mtu - 3 - STREAM_HEADER_LENGTH
+      self.stream_packets = [b''] * STREAM_WINDOW_NUM_PACKETS
+      self.stream_base_sequence = self.stream_next_sequence = self.stream_retransmit_bitmap = 0
+      self.stream_data_chunk_index = self.stream_num_data_bytes = 0
+      self.stream_final_queued = self.stream_manifest_buffered = False
+      self.is_streaming = True
+
+   def buffer_next_stream_record(self):
+      # Frame the next storage chunk with its absolute index, or the download manifest once all chunks are buffered
+      if self.stream_data_chunk_index < self.stream_total_data_chunks:
+         chunk_index = self.stream_first_chunk + self.stream_data_chunk_index
+         self.stream_data_chunk_index += 1
+         chunk = self.retrieve_chunk(chunk_index)
+         record_data = self.encode_chunk(chunk_index) if self.stream_compressed else (bytes([LOG_ENCODING_RAW]) + chunk)
+         self.stream_num_data_bytes += len(chunk)
+      else:
+         chunk_index = STREAM_MANIFEST_INDEX
+         chunk = record_data = struct.pack(STREAM_MANIFEST_FORMAT, self.stream_first_chunk, self.stream_total_data_chunks, self.stream_num_available_chunks, self.stream_num_data_bytes)
+         self.stream_manifest_buffered = True
+      self.stream_buffer += struct.pack(STREAM_RECORD_HEADER_FORMAT, chunk_index, len(record_data)) + record_data + struct.pack('<I', zlib.crc32(chunk))
+
+   def build_stream_packet(self):
+      # Store the next sequence-numbered packet in its window slot so that it can be retransmitted if lost
+      if len(self.stream_buffer) < self.stream_max_payload and not self.stream_manifest_buffered:
+         self.buffer_next_stream_record()
+      payload = self.stream_buffer[:self.stream_max_payload]
+      del self.stream_buffer[:self.stream_max_payload]
+      self.stream_final_queued = not self.stream_buffer and self.stream_manifest_buffered
+      self.stream_packets[self.stream_next_sequence % STREAM_WINDOW_NUM_PACKETS] = struct.pack('<HB', self.stream_next_sequence, STREAM_FLAG_FINAL if self.stream_final_queued else 0) + payload
+      self.download_num_bytes += len(payload)
+      self.stream_next_sequence = (self.stream_next_sequence + 1) & 0xFFFF
+
+   def stream_num_in_flight(self):
+      # Packets stay in flight from the moment they are sent until the host acknowledges them or they must be retransmitted
+      return ((self.stream_next_sequence - self.stream_base_sequence) & 0xFFFF) - bin(self.stream_retransmit_bitmap).count('1')
+
+   def next_stream_packets(self, max_packets=SIMULATED_PACKETS_PER_CONNECTION_EVENT, max_packets_in_flight=None):
+      # Send any requested retransmissions first, followed by new packets while the window remains open
+      packets = []
+      max_packets_in_flight = self.max_packets_in_flight() if max_packets_in_flight is None else max_packets_in_flight
+      while self.is_streaming and len(packets) < max_packets and self.stream_num_in_flight() < max_packets_in_flight:
+         if self.stream_retransmit_bitmap:
+            offset = (self.stream_retransmit_bitmap & -self.stream_retransmit_bitmap).bit_length() - 1
+            self.stream_retransmit_bitmap &= ~(1 << offset)
+            sequence = (self.stream_base_sequence + offset) & 0xFFFF
+         elif not self.stream_final_queued and ((self.stream_next_sequence - self.stream_base_sequence) & 0xFFFF) < STREAM_WINDOW_NUM_PACKETS:
+            sequence = self.stream_next_sequence
+            self.build_stream_packet()
+         else:
+            break
+
+         # Ask the host to acknowledge immediately once half or all of the in-flight limit is used
+         packet = self.stream_packets[sequence % STREAM_WINDOW_NUM_PACKETS]
+         num_in_flight = self.stream_num_in_flight()
+         flags = (packet[2] & ~STREAM_FLAG_ACK_REQUESTED) | (STREAM_FLAG_ACK_REQUESTED if num_in_flight in ((max_packets_in_flight + 1) // 2, max_packets_in_flight) else 0)
+         packet = self.stream_packets[sequence % STREAM_WINDOW_NUM_PACKETS] = packet[0:2] + bytes([flags]) + packet[3:]
+         packets.append(packet)
+      return packets
+
+   def handle_stream_acknowledgment(self, next_expected_sequence, missing_bitmap):
+      # Ignore stale acknowledgments for sequence numbers outside of the current window
+      num_acknowledged = (next_expected_sequence - self.stream_base_sequence) & 0xFFFF
+      num_sent = (self.stream_next_sequence - self.stream_base_sequence) & 0xFFFF
+      if not self.is_streaming or num_acknowledged > num_sent:
+         return
+
+      # Slide the window forward, schedule all reported missing packets, and finish once the final packet is acknowledged
+      num_outstanding = num_sent - num_acknowledged
+      self.stream_base_sequence = next_expected_sequence
+      self.stream_retransmit_bitmap = missing_bitmap & ((1 << num_outstanding) - 1)
+      if self.stream_final_queued and not num_outstanding:
+         self.is_streaming = False
+         self.finish_bulk_transfer()
+
+   def connection_event(self, client=None):
+      # Hand the packets that fit into one connection event to the radio
+      if client is not self.download_owner:
+         return []
+      elif self.is_streaming:
+         return self.next_stream_packets()
+      elif self.legacy_packets is not None:
+         packet = next(self.legacy_packets, None)
+         if packet is None:
+            self.legacy_packets = None
+         return [packet] if packet is not None else []
+      return []
+
+   def ranging_results(self):
+      for i in range(len(self.distances)):
+         self.distances[i] = min(max(self.distances[i] + self.random.randint(-100, 100), 100), MAX_RANGING_DISTANCE_MM - 1)
+      return bytes([len(self.distances)]) + b''.join(struct.pack('<BH', i + 1, distance) for i, distance in enumerate(self.distances))
+
+   def set_range_batch_size(self, num_rounds):
+      self.range_batch_num_rounds = min(max(num_rounds, 1), MAX_RANGE_BATCH_NUM_ROUNDS)
+      self.range_batch = bytearray()
+
+   def range_notifications(self, mtu):
+      # Batch consecutive rounds into MTU-sized notifications exactly as the live-stats service does
+      results = self.ranging_results()
+      self.range_round_sequence = (self.range_round_sequence + 1) & 0xFFFF
+      if self.range_batch_num_rounds == 1:
+         return [results]
+      notifications, now = [], time.time()
+      round_header_length = struct.calcsize(RANGE_BATCH_ROUND_HEADER_FORMAT)
+      if self.range_batch and (len(self.range_batch) + round_header_length + len(results) > mtu - 3 or now - self.range_batch_start >= self.range_batch_num_rounds * SIMULATED_RANGING_PERIOD_S):
+         notifications.append(self.send_range_batch(now))
+      if not self.range_batch:
+         self.range_batch = bytearray(struct.pack(RANGE_BATCH_HEADER_FORMAT, RANGE_BATCH_FLAG, (self.range_round_sequence - 1) & 0xFFFF, 0))
+         self.range_batch_start = now
+      self.range_batch += struct.pack(RANGE_BATCH_ROUND_HEADER_FORMAT, min(int((now - self.range_batch_start) * 1000), 0xFFFF)) + results
+      self.range_batch[0] += 1
+      if (self.range_batch[0] & ~RANGE_BATCH_FLAG) >= self.range_batch_num_rounds:
+         notifications.append(self.send_range_batch(now))
+      return notifications
+
+   def send_range_batch(self, now):
+      # Stamp the batch with the age of its first round so that the host can date every round
+      struct.pack_into('<H', self.range_batch, 3, min(int((now - self.range_batch_start) * 1000), 0xFFFF))
+      batch, self.range_batch = bytes(self.range_batch), bytearray()
+      return batch
+
+   def live_range_broadcast(self):
+      self.broadcast_sequence += 1
+      return pack_live_range_broadcast(self.broadcast_sequence, self.ranging_results())
+
+
+# SIMULATED BLE TRANSPORT ---------------------------------------------------------------------------------------------
+
+class SimulatedAdvertisementData:
+
+   def __init__(self, local_name, manufacturer_data=None):
+      self.local_name = local_name
+      self.manufacturer_data = manufacturer_data or {}
+
+class SimulatedTotTagScanner:
+
+   def __init__(self, peripherals, cb=None, detection_callback=None):
+      self.discovered_devices_and_advertisement_data = {}
+      self.peripherals = peripherals
+      self.detection_callback = detection_callback
+      self.broadcast_task = None
+
+   async def start(self):
+      for peripheral in self.peripherals:
+         self.discovered_devices_and_advertisement_data[peripheral.address] = (peripheral, SimulatedAdvertisementData(peripheral.name))
+      if self.detection_callback:
+         self.broadcast_task = asyncio.ensure_future(self.run_broadcasts())
+
+   async def stop(self):
+      if self.broadcast_task:
+         self.broadcast_task.cancel()
+         self.broadcast_task = None
+
+   async def run_broadcasts(self):
+      # Deliver every scan response twice per round, as an active scanner would
+      while True:
+         for peripheral in self.peripherals:
+            advertisement_data = SimulatedAdvertisementData(peripheral.name, { BLUETOOTH_COMPANY_ID: peripheral.live_range_broadcast() })
+            self.detection_callback(peripheral, advertisement_data)
+            self.detection_callback(peripheral, advertisement_data)
+         await asyncio.sleep(SIMULATED_RANGING_PERIOD_S)
+
+class SimulatedTotTagClient:
+
+   def __init__(self, device, disconnected_callback=None, connection_interval=SIMULATED_CONNECTION_INTERVAL_S):
+      self.device = device
+      self.address = device.address
+      self.disconnected_callback = disconnected_callback
+      self.connection_interval = connection_interval
+      self.is_connected = False
+      self.notification_callbacks = {}
+      self.connection_task = None
+
+   async def connect(self, timeout=10.0):
+      await asyncio.sleep(self.connection_interval)
+      self.is_connected = True
+      self.device.clients.append(self)
+      self.connection_task = asyncio.ensure_future(self.run_connection_events())
+      return True
+
+   async def disconnect(self):
+      if self.is_connected:
+         self.is_connected = False
+         self.connection_task.cancel()
+         self.device.clients.remove(self)
+         self.device.stop_sending_log_data(self)
+         if not self.device.clients:
+            self.device.set_range_batch_size(1)
+         if self.disconnected_callback:
+            self.disconnected_callback(self)
+      return True
+
+   async def read_gatt_char(self, uuid):
+      self.verify_connection()
+      await asyncio.sleep(self.connection_interval)
+      return bytearray(self.device.read(uuid))
+
+   async def write_gatt_char(self, uuid, data, response=False):
+      self.verify_connection()
+      if response:
+         await asyncio.sleep(self.connection_interval)
+      self.device.write(uuid, bytes(data), SIMULATED_MTU, self)
+
+   async def start_notify(self, uuid, callback):
+      self.verify_connection()
+      self.notification_callbacks[uuid] = callback
+      if uuid == LOCATION_SERVICE_UUID:
+         asyncio.ensure_future(self.run_ranging())
+
+   async def stop_notify(self, uuid):
+      self.notification_callbacks.pop(uuid, None)
+
+   def verify_connection(self):
+      if not self.is_connected:
+         raise ConnectionError('Simulated TotTag {} is not connected'.format(self.address))
+
+   async def run_connection_events(self):
+      # Deliver each packet that survives the simulated channel to the subscribed notification callback
+      while self.is_connected:
+         await asyncio.sleep(self.connection_interval)
+         for packet in self.device.connection_event(self):
+            self.device.num_packets_sent += 1
+            if self.device.disconnect_after_packets and self.device.num_packets_sent >= self.device.disconnect_after_packets:
+               self.device.disconnect_after_packets = 0
+               asyncio.ensure_future(self.disconnect())
+               return
+            callback = self.notification_callbacks.get(MAINTENANCE_DATA_SERVICE_UUID)
+            if callback and self.device.random.random() >= self.device.packet_loss:
+               callback(MAINTENANCE_DATA_SERVICE_UUID, bytearray(packet))
+
+   async def run_ranging(self):
+      while self.is_connected and LOCATION_SERVICE_UUID in self.notification_callbacks:
+         for notification in self.device.range_notifications(SIMULATED_MTU):
+            self.notification_callbacks[LOCATION_SERVICE_UUID](LOCATION_SERVICE_UUID, bytearray(notification))
+         await asyncio.sleep(SIMULATED_RANGING_PERIOD_S)
+
+
+# SIMULATED DEPLOYMENTS -----------------------------------------------------------------------------------------------
+
+def create_simulated_tottags(num_tottags, ttg_file=None, duration_s=86400, packet_loss=0.0, seed=0):
+   # Back every simulated TotTag with either a recorded .ttg log or its own synthetic deployment
+   start_time = int(time.time() - duration_s) // 60 * 60
+   details = synthesize_experiment_details(start_time, duration_s, num_tottags)
+   recorded_data = open(ttg_file, 'rb').read() if ttg_file else None
+   tottags = []
+   for i in range(num_tottags):
+      data = recorded_data if recorded_data is not None else synthesize_log_data(duration_s, max(num_tottags - 1, 1), seed + i)
+      tottags.append(SimulatedTotTag(SIMULATED_ADDRESS_FORMAT.format(i + 1), split_into_pages(data), details, packet_loss, seed=seed + i))
+   return tottags
+
+def simulated_ble_backend(tottags, connection_interval=SIMULATED_CONNECTION_INTERVAL_S):
+   client_factory = lambda device, disconnected_callback=None: SimulatedTotTagClient(device, disconnected_callback, connection_interval)
+   scanner_factory = lambda cb=None, detection_callback=None: SimulatedTotTagScanner(tottags, cb, detection_callback)
+   return client_factory, scanner_factory
+
+
+# BENCHMARKING --------------------------------------------------------------------------------------------------------
+
+def report_throughput(name, num_bytes, elapsed):
+   print('   {:<40} {:>10.1f} ms {:>10.2f} MB/s'.format(name, elapsed * 1000.0, num_bytes / 1048576.0 / max(elapsed, 1e-9)))
+
+def benchmark_parsers(tottag, storage_directory):
+   # Time the chunk decoder and the log parser that run on every downloaded log
+   data = b''.join(tottag.pages)
+   encoded_pages = [tottag.encode_chunk(i) for i in range(len(tottag.pages))]
+   start = time.perf_counter()
+   decoded = b''.join(decode_log_chunk(page) for page in encoded_pages)
+   report_throughput('Chunk decoding ({:.2f}x compression)'.format(len(data) / max(sum(len(page) for page in encoded_pages), 1)), len(data), time.perf_counter() - start)
+   assert decoded == data
+   start = time.perf_counter()
+   process_tottag_data(int(tottag.address.split(':')[-1], 16), storage_directory, unpack_experiment_details(tottag.details), data, False)
+   report_throughput('Log parsing', len(data), time.perf_counter() - start)
+
+def benchmark_log_decoders(size_mb, num_neighbors=MAX_NUM_DEVICES-1):
+   # Time the native columnar decoder against the pure-Python parser on a synthetic log of the requested size
+   duration_s = int(size_mb * 1048576 / (2 * (6 + (3 * num_neighbors))))
+   details = unpack_experiment_details(synthesize_experiment_details(int(time.time()) - duration_s - 60, duration_s, num_neighbors + 1))
+   uid_to_labels = experiment_uid_labels(details)
+   data = synthesize_log_data(duration_s, num_neighbors)
+   print('Decoding a synthetic {:.1f} MB log with {} neighbors:'.format(len(data) / 1048576.0, num_neighbors))
+   if not native_decode_storage_records:
+      print('   Native decoder is not built; reinstall the package with a C compiler available')
+      return
+   start = time.perf_counter()
+   columns = decode_storage_records(data, details['start_time'], uid_to_labels.keys())
+   report_throughput('Native decoding into {:.1f} MB of columns'.format(sum(column.nbytes for column in columns.values()) / 1048576.0), len(data), time.perf_counter() - start)
+   start = time.perf_counter()
+   native_log_data = storage_columns_to_log_data(columns, uid_to_labels)
+   report_throughput('Conversion of columns into log entries', len(data), time.perf_counter() - start)
+   del columns
+   start = time.perf_counter()
+   python_log_data = parse_storage_records_python(data, details['start_time'], uid_to_labels)
+   report_throughput('Pure-Python parsing into log entries', len(data), time.perf_counter() - start)
+   assert native_log_data == python_log_data
+
+async def benchmark_single_download(tottag, storage_directory, streamed):
+   # Drive the dashboard's own download path and count the progress messages that the GUI must consume
+   client_factory, scanner_factory = simulated_ble_backend([tottag], 0)
+   result_queue = queue.Queue()
+   ble = TotTagBLE(asyncio.Queue(), result_queue, None, client_factory, scanner_factory)
+   ble.connected_device = client_factory(tottag, ble.disconnected_callback)
+   await ble.connected_device.connect()
+   start = time.perf_counter()
+   ble.command_queue.put_nowait({ 'dir': storage_directory, 'raw': False, 'streamed': streamed, 'start': 0, 'end': 0 })
+   await ble.download_logs()
+   while await ble.command_queue.get() != 'DOWNLOAD_DONE':
+      pass
+   elapsed = time.perf_counter() - start
+   await ble.download_logs_done()
+   await ble.connected_device.disconnect()
+   num_messages = result_queue.qsize()
+   report_throughput('{} download'.format('Streamed' if streamed else 'Legacy'), len(ble.data), elapsed)
+   print('   {:<40} {:>10d} msgs {:>8.0f} msgs/s'.format('GUI progress updates', num_messages, num_messages / max(elapsed, 1e-9)))
+
+async def benchmark_multiple_downloads(tottags, storage_directory, max_concurrent_connections):
+   client_factory, _ = simulated_ble_backend(tottags, 0)
+   result_queue = queue.Queue()
+   manager = TotTagSessionManager(result_queue, client_factory, max_concurrent_connections)
+   start = time.perf_counter()
+   results = await manager.download_logs({ tottag.address: tottag for tottag in tottags }, { 'dir': storage_directory, 'raw': False, 'start': 0, 'end': 0 })
+   elapsed = time.perf_counter() - start
+   report_throughput('{}-TotTag concurrent download ({} ok)'.format(len(tottags), sum(results.values())), sum(len(b''.join(tottag.pages)) for tottag in tottags), elapsed)
+   print('   {:<40} {:>10d} msgs {:>8.0f} msgs/s'.format('GUI progress updates', result_queue.qsize(), result_queue.qsize() / max(elapsed, 1e-9)))
+
+def benchmark_range_batching(tottag, num_minutes=60):
+   # Count the live-range notifications sent per minute and the host time spent unpacking them for several batch sizes
+   print('Live ranging notifications per minute with {} neighbors:'.format(len(tottag.distances)))
+   for num_rounds in (1, 2, 4, MAX_RANGE_BATCH_NUM_ROUNDS):
+      tottag.set_range_batch_size(num_rounds)
+      notifications = [notification for _ in range(int(num_minutes * 60 / SIMULATED_RANGING_PERIOD_S)) for notification in tottag.range_notifications(SIMULATED_MTU)]
+      start = time.process_time()
+      num_rounds_received = sum(len(unpack_range_batch(notification)[1]) for notification in notifications)
+      elapsed = time.process_time() - start
+      print('   {} round(s) per notification: {:>6.1f} notifications/min {:>8.1f} B/min {:>8.1f} us/min unpacking {} rounds'.format(
+            num_rounds, len(notifications) / num_minutes, sum(len(notification) + 3 for notification in notifications) / num_minutes, elapsed * 1e6 / num_minutes, num_rounds_received))
+   tottag.set_range_batch_size(1)
+
+def simulate_connection_contention(tottag, num_live_centrals, max_packets_in_flight, num_controller_buffers):
+   # Step the peripheral's radio one packet slot at a time while a single HCI queue feeds every connection's packets to the controller
+   download_interval = round(SIMULATED_CONNECTION_INTERVAL_S / SIMULATED_RADIO_SLOT_S)
+   live_interval = round(SIMULATED_LIVE_CONNECTION_INTERVAL_S / SIMULATED_RADIO_SLOT_S)
+   ranging_period = round(SIMULATED_RANGING_PERIOD_S / SIMULATED_RADIO_SLOT_S)
+   live_anchors = { 1 + (i * live_interval) // max(num_live_centrals, 1): i + 1 for i in range(num_live_centrals) }
+   host_queue, controller, latencies, acknowledgments = collections.deque(), [], [], collections.deque()
+   slot = 0
+   download_event_open = False
+   tottag.stream_first_chunk = tottag.stream_max_chunks = 0
+   tottag.stream_compressed = True
+   tottag.start_bulk_transfer()
+   tottag.start_streaming_log_data(SIMULATED_MTU)
+   while tottag.is_streaming:
+
+      # Queue the live ranging results of every other central once per ranging round
+      if slot % ranging_period == ranging_period // 2:
+         host_queue.extend((link, slot) for link in range(1, num_live_centrals + 1))
+
+      # Apply acknowledgments once they reach the peripheral, then queue new download packets while below the in-flight limit
+      while acknowledgments and acknowledgments[0][0] <= slot:
+         tottag.handle_stream_acknowledgment(acknowledgments.popleft()[1], 0)
+      packets = tottag.next_stream_packets(STREAM_WINDOW_NUM_PACKETS, max_packets_in_flight)
+      host_queue.extend((0, slot, packet) for packet in packets)
+      while host_queue and len(controller) < num_controller_buffers:
+         controller.append(host_queue.popleft())
+
+      # Give the slot to a live connection at its anchor point, otherwise to the ongoing download connection event
+      link = live_anchors.get(slot % live_interval, 0)
+      download_event_open = (not link) and (download_event_open or (slot % download_interval == 0))
+      packet = next((packet for packet in controller if packet[0] == link), None) if (link or download_event_open) else None
+      if packet:
+         controller.remove(packet)
+         if link:
+            latencies.append((slot - packet[1]) * SIMULATED_RADIO_SLOT_S)
+         elif packet[2][2] & (STREAM_FLAG_ACK_REQUESTED | STREAM_FLAG_FINAL):
+            acknowledgments.append((slot + download_interval, (struct.unpack('<H', packet[2][0:2])[0] + 1) & 0xFFFF))
+      else:
+         download_event_open = False
+      slot += 1
+   return tottag.download_num_bytes, slot * SIMULATED_RADIO_SLOT_S, latencies
+
+def benchmark_connection_contention(tottag):
+   # Measure download throughput and live-ranging latency when other centrals share the peripheral's radio
+   print('Streamed download with concurrent live-ranging centrals (simulated radio time):')
+   for num_controller_buffers in SIMULATED_CONTROLLER_ACL_BUFFERS:
+      for num_live_centrals in range(MAX_NUM_CONNECTIONS):
+         for max_packets_in_flight in ((STREAM_MAX_PACKETS_IN_FLIGHT, STREAM_SHARED_MAX_PACKETS_IN_FLIGHT) if num_live_centrals else (STREAM_MAX_PACKETS_IN_FLIGHT,)):
+            num_bytes, elapsed, latencies = simulate_connection_contention(tottag, num_live_centrals, max_packets_in_flight, num_controller_buffers)
+            latency = '{:>6.1f} ms mean {:>6.1f} ms max live latency'.format(1000.0 * sum(latencies) / len(latencies), 1000.0 * max(latencies)) if latencies else ''
+            print('   {} ACL buffers, {} live + 1 download, {} in flight: {:>8.1f} kB/s {}'.format(
+                  num_controller_buffers, num_live_centrals, max_packets_in_flight, num_bytes / 1024.0 / elapsed, latency))
+
+def run_benchmark(args):
+   storage_directory = tempfile.mkdtemp(prefix='tottag_benchmark_')
+   try:
+      if args.decoder_log_mb:
+         benchmark_log_decoders(args.decoder_log_mb)
+      tottags = create_simulated_tottags(args.tottags, args.ttg, args.duration, args.packet_loss)
+      print('Benchmarking {} simulated TotTags with {} pages ({:.1f} MB) of log data each:'.format(len(tottags), len(tottags[0].pages), len(b''.join(tottags[0].pages)) / 1048576.0))
+      benchmark_parsers(tottags[0], storage_directory)
+      benchmark_range_batching(tottags[0])
+      benchmark_connection_contention(tottags[0])
+      asyncio.run(benchmark_single_download(tottags[0], storage_directory, True))
+      if args.legacy:
+         asyncio.run(benchmark_single_download(tottags[0], storage_directory, False))
+      if len(tottags) > 1:
+         asyncio.run(benchmark_multiple_downloads(tottags, storage_directory, args.max_connections))
+   finally:
+      shutil.rmtree(storage_directory)
+
+
+# TOP-LEVEL FUNCTIONALITY ---------------------------------------------------------------------------------------------
+
+def main():
+   parser = argparse.ArgumentParser(description='Simulated TotTag peripherals for offline dashboard testing')
+   parser.add_argument('--tottags', type=int, default=1, help='Number of simulated TotTags')
+   parser.add_argument('--ttg', default=None, help='Recorded .ttg log to serve instead of synthetic data')
+   parser.add_argument('--duration', type=int, default=86400, help='Duration of synthetic deployments in seconds')
+   parser.add_argument('--packet-loss', type=float, default=0.0, help='Fraction of notifications dropped by the simulated link')
+   parser.add_argument('--max-connections', type=int, default=MAX_CONCURRENT_CONNECTIONS, help='Maximum number of concurrent connections')
+   parser.add_argument('--legacy', action='store_true', help='Also benchmark the legacy indication-based download')
+   parser.add_argument('--decoder-log-mb', type=float, default=0, help='Also compare the native and pure-Python log decoders on a synthetic log of this size')
+   parser.add_argument('--benchmark', action='store_true', help='Measure parser and download throughput instead of launching the dashboard')
+   args = parser.parse_args()
+   if args.benchmark:
+      run_benchmark(args)
+   else:
+      gui = TotTagGUI(*simulated_ble_backend(create_simulated_tottags(args.tottags, args.ttg, args.duration, args.packet_loss)))
+      gui.mainloop()
+
+if __name__ == "__main__":
+   main()
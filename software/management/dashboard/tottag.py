@@ -8,12 +8,28 @@ from bleak import BleakClient, BleakScanner
 from tkinter import ttk, filedialog
 from collections import defaultdict
 import struct, queue, datetime, tzlocal
-import os, pickle, pytz, time
-import traceback
+import numpy as np
+import os, pytz, time, zlib
+import concurrent.futures, traceback
 import tkinter as tk
 import tkcalendar
 import threading
 import asyncio
+try:
+   from ._ttg_decoder import decode_storage_records as native_decode_storage_records
+except ImportError:
+   try:
+      from _ttg_decoder import decode_storage_records as native_decode_storage_records
+   except ImportError:
+      native_decode_storage_records = None
+try:
+   from .contact_episodes import ContactTracker
+except ImportError:
+   from contact_episodes import ContactTracker
+try:
+   from .log_tables import build_log_tables, log_entries_to_columns, log_tables_path, write_log_tables
+except ImportError:
+   from log_tables import build_log_tables, log_entries_to_columns, log_tables_path, write_log_tables
 
 
 # CONSTANTS AND DEFINITIONS -------------------------------------------------------------------------------------------
@@ -23,25 +39,72 @@ LOCATION_SERVICE_UUID = 'd68c3156-a23f-ee90-0c45-5231395e5d2e'
 FIND_MY_TOTTAG_SERVICE_UUID = 'd68c3155-a23f-ee90-0c45-5231395e5d2e'
 TIMESTAMP_SERVICE_UUID = 'd68c3154-a23f-ee90-0c45-5231395e5d2e'
 VOLTAGE_SERVICE_UUID = 'd68c3153-a23f-ee90-0c45-5231395e5d2e'
+STORAGE_STATUS_SERVICE_UUID = 'd68c3158-a23f-ee90-0c45-5231395e5d2e'
 EXPERIMENT_SERVICE_UUID = 'd68c3161-a23f-ee90-0c45-5231395e5d2e'
 MAINTENANCE_COMMAND_SERVICE_UUID = 'd68c3162-a23f-ee90-0c45-5231395e5d2e'
 MAINTENANCE_DATA_SERVICE_UUID = 'd68c3163-a23f-ee90-0c45-5231395e5d2e'
+MAINTENANCE_LINK_STATUS_SERVICE_UUID = 'd68c3164-a23f-ee90-0c45-5231395e5d2e'
+MAINTENANCE_BUFFER_STATUS_SERVICE_UUID = 'd68c3165-a23f-ee90-0c45-5231395e5d2e'
 
 MAINTENANCE_NEW_EXPERIMENT = 0x01
 MAINTENANCE_DELETE_EXPERIMENT = 0x02
 MAINTENANCE_DOWNLOAD_LOG = 0x03
 MAINTENANCE_SET_LOG_DOWNLOAD_DATES = 0x04
+MAINTENANCE_DOWNLOAD_LOG_STREAMED = 0x05
+MAINTENANCE_DOWNLOAD_ACK = 0x06
+MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS = 0x07
+MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION = 0x08
+MAINTENANCE_SET_RANGE_BATCHING = 0x09
 MAINTENANCE_DOWNLOAD_COMPLETE = 0xFF
 
 FIND_MY_TOTTAG_ACTIVATION_SECONDS = 10
 MAX_RANGING_DISTANCE_MM = 16000
 MAX_LABEL_LENGTH = 16
 MAX_NUM_DEVICES = 10
+LIVE_RANGE_BATCH_NUM_ROUNDS = 2
+RANGE_BATCH_FLAG = 0x80
+RANGE_BATCH_HEADER_FORMAT = '<BHH'
+RANGE_BATCH_ROUND_HEADER_FORMAT = '<H'
+BLUETOOTH_COMPANY_ID = 0x02E0
+BROADCAST_RANGE_BITS_PER_RANGE = 12
+BROADCAST_RANGE_RESOLUTION_MM = 10
+EXPERIMENT_DETAILS_LENGTH = struct.calcsize('<IIIIBB' + ('6B'*MAX_NUM_DEVICES) + ((str(MAX_LABEL_LENGTH)+'s')*MAX_NUM_DEVICES))
+
+STREAM_WINDOW_NUM_PACKETS = 32
+STREAM_FLAG_FINAL = 0x01
+STREAM_FLAG_ACK_REQUESTED = 0x02
+STREAM_ACK_TIMEOUT_S = 0.5
+STREAM_RECORD_HEADER_FORMAT = '<IH'
+STREAM_RECORD_CRC_LENGTH = 4
+STREAM_MANIFEST_INDEX = 0xFFFFFFFF
+STREAM_MANIFEST_FORMAT = '<IIII'
+STREAM_MAX_UNPRODUCTIVE_REQUESTS = 3
+PARTIAL_DOWNLOAD_HEADER_INDEX = 0xFFFFFFFE
+
+MAX_CONCURRENT_CONNECTIONS = 4
+MAX_CONNECTION_ATTEMPTS = 3
+MULTI_PROGRESS_REPORT_INTERVAL_S = 0.25
+MEMORY_NUM_DATA_BYTES_PER_PAGE = 2044
+
+LOG_ENCODING_RAW = 0x00
+LOG_ENCODING_DELTA = 0x01
+LOG_COMPRESSION_SECOND_ORDER_FLAG = 0x80
+LOG_COMPRESSION_HEADER_FORMAT = '<BBH'
+BITMAP_POSITIONS = [[bit for bit in range(8) if bitmap & (1 << bit)] for bitmap in range(256)]
 
 STORAGE_TYPE_VOLTAGE = 1
 STORAGE_TYPE_CHARGING_EVENT = 2
 STORAGE_TYPE_MOTION = 3
 STORAGE_TYPE_RANGES = 4
+STORAGE_TYPE_RANGE_SUMMARY = 5
+
+STORAGE_COLUMN_TYPES = { 'type': '<u1', 't': '<f8', 'value': '<i4', 'uid': '<u1', 'distance': '<i2', 'min': '<i2', 'max': '<i2', 'n': '<u1' }
+
+STORAGE_TIERS = ['Full Resolution', 'Per-Minute Range Summaries', 'Motion and Voltage Only', 'Voltage Only']
+
+LINK_STATUS_FORMAT = '<HHHBBBHHII'
+BUFFER_POOL_STATUS_FORMAT = '<HBBBHH'
+BLE_PHY_NAMES = defaultdict(lambda: 'Unknown', { 1: '1M', 2: '2M', 4: 'Coded' })
 
 BATTERY_CODES = defaultdict(lambda: 'Unknown Battery Event')
 BATTERY_CODES[1] = 'Plugged'
@@ -69,6 +132,53 @@ def get_download_directory():
    else:
       return os.path.join(os.path.expanduser('~'), 'Downloads')
 
+def partial_download_path(storage_directory, address, start_timestamp, end_timestamp):
+   return os.path.join(storage_directory, '.{}_{}_{}.partial'.format(address.replace(':', '').replace('-', ''), start_timestamp, end_timestamp))
+
+def load_partial_download(path):
+   header, chunks = None, {}
+   try:
+      with open(path, 'rb') as file:
+         contents = file.read()
+   except OSError:
+      return header, chunks
+   header_length = struct.calcsize(STREAM_RECORD_HEADER_FORMAT)
+   index = 0
+   while index + header_length <= len(contents):
+      chunk_index, length = struct.unpack(STREAM_RECORD_HEADER_FORMAT, contents[index:index+header_length])
+      if index + header_length + length > len(contents):
+         break
+      data = contents[index+header_length:index+header_length+length]
+      if chunk_index == PARTIAL_DOWNLOAD_HEADER_INDEX:
+         header = data
+      else:
+         chunks[chunk_index] = data
+      index += header_length + length
+   return header, chunks
+
+def append_partial_download(path, chunk_index, data):
+   with open(path, 'ab') as file:
+      file.write(struct.pack(STREAM_RECORD_HEADER_FORMAT, chunk_index, len(data)) + data)
+
+def decode_log_chunk(encoded):
+   if encoded[0] == LOG_ENCODING_RAW:
+      return bytes(encoded[1:])
+   elif encoded[0] != LOG_ENCODING_DELTA:
+      raise ValueError('Unknown log chunk encoding {}'.format(encoded[0]))
+   _, predictor, length = struct.unpack(LOG_COMPRESSION_HEADER_FORMAT, encoded[0:4])
+   stride = predictor & ~LOG_COMPRESSION_SECOND_ORDER_FLAG
+   residuals = np.zeros(((length + stride - 1) // stride) * stride + 8, dtype=np.uint8)
+   index = struct.calcsize(LOG_COMPRESSION_HEADER_FORMAT)
+   for group in range(0, length, 8):
+      positions = BITMAP_POSITIONS[encoded[index]]
+      residuals[[group + bit for bit in positions]] = np.frombuffer(encoded[index+1:index+1+len(positions)], dtype=np.uint8)
+      index += 1 + len(positions)
+   residuals = residuals[:((length + stride - 1) // stride) * stride].reshape(-1, stride)
+   data = np.cumsum(residuals, axis=0, dtype=np.uint8)
+   if predictor & LOG_COMPRESSION_SECOND_ORDER_FLAG:
+      data = np.cumsum(data, axis=0, dtype=np.uint8)
+   return data.reshape(-1)[:length].tobytes()
+
 def validate_time(new_val):
    return (len(new_val) == 0) or \
           (len(new_val) == 1 and new_val.isnumeric()) or \
@@ -119,22 +229,39 @@ def unpack_experiment_details(data):
       'labels': experiment_struct[(6+6*MAX_NUM_DEVICES):],
    }
 
-def process_tottag_data(from_uid, storage_directory, details, data, save_raw_file):
-   experiment_start_time = details['start_time']
-   uid_to_labels = defaultdict(lambda: 'Unknown')
-   for i in range(details['num_devices']):
-      label = details['labels'][i].decode().rstrip('\x00')
-      uid_to_labels[int(details['uids'][i][0])] = label if label else str(details['uids'][i][0])
+def unpack_range_batch(data):
+   # Batched notifications hold the first round's sequence number and age when sent, followed by each round's offset from the first and its compressed ranging results
+   if len(data) == 0 or not (data[0] & RANGE_BATCH_FLAG):
+      return None, [(0.0, data)]
+   num_rounds, sequence, first_round_age_ms = struct.unpack_from(RANGE_BATCH_HEADER_FORMAT, data)
+   rounds, index = [], struct.calcsize(RANGE_BATCH_HEADER_FORMAT)
+   round_header_length = struct.calcsize(RANGE_BATCH_ROUND_HEADER_FORMAT)
+   for _ in range(num_rounds & ~RANGE_BATCH_FLAG):
+      round_length = 1 + (3 * data[index+round_header_length]) if index + round_header_length < len(data) else 0
+      if round_length == 0 or index + round_header_length + round_length > len(data):
+         break
+      round_offset_ms = struct.unpack_from(RANGE_BATCH_ROUND_HEADER_FORMAT, data, index)[0]
+      rounds.append((max(first_round_age_ms - round_offset_ms, 0) / 1000.0, data[index+round_header_length:index+round_header_length+round_length]))
+      index += round_header_length + round_length
+   return sequence, rounds
+
+def unpack_live_range_broadcast(data):
+   # Broadcasts hold a round sequence number, the neighbor EUIs, and their ranges packed as consecutive 12-bit centimeter values
+   if len(data) < 2 or len(data) < 2 + data[1] + (((BROADCAST_RANGE_BITS_PER_RANGE * data[1]) + 7) // 8):
+      return None
+   sequence, num_ranges = data[0], data[1]
+   packed_ranges = int.from_bytes(data[2+num_ranges:], 'little')
+   range_mask = (1 << BROADCAST_RANGE_BITS_PER_RANGE) - 1
+   return sequence, { eui: BROADCAST_RANGE_RESOLUTION_MM * ((packed_ranges >> (BROADCAST_RANGE_BITS_PER_RANGE * i)) & range_mask) for i, eui in enumerate(data[2:2+num_ranges]) }
+
+def parse_storage_records_python(data, experiment_start_time, uid_to_labels):
    i = 0
    log_data = defaultdict(dict)
-   if save_raw_file:
-      with open(os.path.join(storage_directory, uid_to_labels[from_uid] + '.ttg'), 'wb') as file:
-         file.write(data)
    try:
       while i < len(data):
          timestamp_raw = struct.unpack('<I', data[i+1:i+5])[0]
          timestamp = experiment_start_time + (timestamp_raw / 1000)
-         if timestamp > int(time.time()) or ((timestamp_raw % 500) != 0) or data[i] < 1 or data[i] > 4:
+         if timestamp > int(time.time()) or ((timestamp_raw % 500) != 0) or data[i] < 1 or data[i] > 5:
             i += 1
          elif data[i] == STORAGE_TYPE_VOLTAGE:
             datum = struct.unpack('<I', data[i+5:i+9])[0]
@@ -166,34 +293,420 @@ def process_tottag_data(from_uid, storage_directory, details, data, save_raw_fil
                i += 6 + data[i+5]*3
             else:
                i += 1
+         elif data[i] == STORAGE_TYPE_RANGE_SUMMARY:
+            log_data[timestamp]['r'] = {}
+            log_data[timestamp]['s'] = {}
+            if data[i+5] < MAX_NUM_DEVICES:
+               for j in range(data[i+5]):
+                  uid, mean, minimum, maximum, count = struct.unpack('<BhhhB', data[i+6+(j*8):i+14+(j*8)])
+                  if uid in uid_to_labels and 0 <= mean < MAX_RANGING_DISTANCE_MM:
+                     log_data[timestamp]['r'][uid_to_labels[uid]] = mean
+                     log_data[timestamp]['s'][uid_to_labels[uid]] = { 'min': minimum, 'max': maximum, 'n': count }
+               i += 6 + data[i+5]*8
+            else:
+               i += 1
    except Exception:
        traceback.print_exc()
-   log_data = [dict({'t': ts}, **datum) for ts, datum in log_data.items()]
-   with open(os.path.join(storage_directory, uid_to_labels[from_uid] + '.pkl'), 'wb') as file:
-      pickle.dump(log_data, file, protocol=pickle.HIGHEST_PROTOCOL)
+   return [dict({'t': ts}, **datum) for ts, datum in log_data.items()]
+
+def decode_storage_records(data, experiment_start_time, valid_uids):
+   # Decode the raw storage stream into numpy columns: one row per record, plus one row per valid range measurement
+   columns = native_decode_storage_records(data, float(experiment_start_time), float(int(time.time())), bytes(valid_uids), MAX_NUM_DEVICES, MAX_RANGING_DISTANCE_MM)
+   return { name: np.frombuffer(column, dtype=STORAGE_COLUMN_TYPES[name]) for name, column in columns.items() }
+
+def storage_columns_to_log_data(columns, uid_to_labels):
+   # Replay the decoded records in log order so that later records at the same timestamp replace earlier ones
+   log_data = defaultdict(dict)
+   uids, distances = columns['uid'].tolist(), columns['distance'].tolist()
+   minimums, maximums, counts = columns['min'].tolist(), columns['max'].tolist(), columns['n'].tolist()
+   measurement = 0
+   for record_type, timestamp, value in zip(columns['type'].tolist(), columns['t'].tolist(), columns['value'].tolist()):
+      if record_type == STORAGE_TYPE_VOLTAGE:
+         log_data[timestamp]['v'] = value
+      elif record_type == STORAGE_TYPE_CHARGING_EVENT:
+         log_data[timestamp]['c'] = BATTERY_CODES[value]
+      elif record_type == STORAGE_TYPE_MOTION:
+         log_data[timestamp]['m'] = value > 0
+      else:
+         measurements = range(measurement, measurement + value)
+         log_data[timestamp]['r'] = { uid_to_labels[uids[k]]: distances[k] for k in measurements }
+         if record_type == STORAGE_TYPE_RANGE_SUMMARY:
+            log_data[timestamp]['s'] = { uid_to_labels[uids[k]]: { 'min': minimums[k], 'max': maximums[k], 'n': counts[k] } for k in measurements }
+         measurement += value
+   return [dict({'t': ts}, **datum) for ts, datum in log_data.items()]
+
+def experiment_uid_labels(details):
+   uid_to_labels = defaultdict(lambda: 'Unknown')
+   for i in range(details['num_devices']):
+      label = details['labels'][i].decode().rstrip('\x00')
+      uid_to_labels[int(details['uids'][i][0])] = label if label else str(details['uids'][i][0])
+   return uid_to_labels
+
+def process_tottag_data(from_uid, storage_directory, details, data, save_raw_file):
+   experiment_start_time = details['start_time']
+   uid_to_labels = experiment_uid_labels(details)
+   if save_raw_file:
+      with open(os.path.join(storage_directory, uid_to_labels[from_uid] + '.ttg'), 'wb') as file:
+         file.write(data)
+   if native_decode_storage_records:
+      columns = decode_storage_records(data, experiment_start_time, uid_to_labels.keys())
+   else:
+      log_data = parse_storage_records_python(data, experiment_start_time, uid_to_labels)
+      columns = log_entries_to_columns(log_data, { label: uid for uid, label in uid_to_labels.items() })
+   write_log_tables(log_tables_path(storage_directory, uid_to_labels[from_uid]), build_log_tables(columns),
+                    uid_to_labels[from_uid], from_uid, experiment_start_time, dict(uid_to_labels))
 
 
 # BLUETOOTH LE COMMUNICATIONS -----------------------------------------------------------------------------------------
 
+def unpack_buffer_status(data):
+   pool_length = struct.calcsize(BUFFER_POOL_STATUS_FORMAT)
+   return [dict(zip(('buffer_length', 'num_buffers', 'num_allocated', 'max_allocated', 'max_request_length', 'num_failed_allocations'),
+                    struct.unpack_from(BUFFER_POOL_STATUS_FORMAT, data, 1 + (i * pool_length)))) for i in range(data[0])]
+
+async def read_link_status(client):
+   try:
+      link_status = struct.unpack(LINK_STATUS_FORMAT, await client.read_gatt_char(MAINTENANCE_LINK_STATUS_SERVICE_UUID))
+      print('Link parameters for {}: interval = {:.2f} ms, latency = {}, PHY = {}/{}, data length = {}/{} B, device throughput = {} B in {} ms'.format(
+            client.address, link_status[0] * 1.25, link_status[1], BLE_PHY_NAMES[link_status[3]], BLE_PHY_NAMES[link_status[4]], link_status[6], link_status[7], link_status[8], link_status[9]))
+      return link_status
+   except Exception:
+      return None
+
+class TotTagStreamedDownload:
+
+   def __init__(self, client, storage_directory, start_timestamp, end_timestamp, progress_callback):
+      self.client = client
+      self.start_timestamp = start_timestamp
+      self.end_timestamp = end_timestamp
+      self.progress_callback = progress_callback
+      self.partial_path = partial_download_path(storage_directory, client.address, start_timestamp, end_timestamp)
+      self.finished = asyncio.Event()
+      self.active = False
+      self.details = None
+      self.stored_header = None
+      self.total_length = 0
+      self.next_sequence = 0
+      self.highest_sequence = -1
+      self.pending = {}
+      self.stream_bytes = bytearray()
+      self.num_since_ack = 0
+      self.last_activity = 0
+      self.header_parsed = False
+      self.chunks = {}
+      self.num_chunk_bytes = 0
+      self.num_encoded_bytes = 0
+      self.manifest = None
+      self.num_unproductive_requests = 0
+      self.num_chunks_at_request = 0
+      self.first_requested_chunk = 0
+
+   async def run(self):
+      self.stored_header, self.chunks = load_partial_download(self.partial_path)
+      if self.stored_header is None:
+         self.chunks = {}
+         if os.path.exists(self.partial_path):
+            os.remove(self.partial_path)
+      self.num_chunk_bytes = sum(len(chunk) for chunk in self.chunks.values())
+      first_chunk = 0
+      while first_chunk in self.chunks:
+         first_chunk += 1
+      if first_chunk:
+         print('Resuming log download from {} at chunk {}'.format(self.client.address, first_chunk))
+      self.active = True
+      watchdog = asyncio.ensure_future(self.watchdog())
+      try:
+         await self.client.start_notify(MAINTENANCE_DATA_SERVICE_UUID, self.stream_callback)
+         await self.request_log_chunks(first_chunk, 0)
+         await self.finished.wait()
+      finally:
+         self.active = False
+         watchdog.cancel()
+         try:
+            await self.client.stop_notify(MAINTENANCE_DATA_SERVICE_UUID)
+         except Exception:
+            pass
+      return self.is_complete()
+
+   def cancel(self):
+      self.active = False
+      self.finished.set()
+
+   def is_complete(self):
+      missing_chunks = self.missing_chunks()
+      return missing_chunks is not None and not missing_chunks
+
+   def assemble(self):
+      data = b''.join(self.chunks[index] for index in sorted(self.chunks))
+      if self.is_complete():
+         os.remove(self.partial_path)
+         if self.num_encoded_bytes:
+            print('Received {} encoded bytes for {} log bytes (compression ratio {:.2f})'.format(self.num_encoded_bytes, self.num_chunk_bytes, self.num_chunk_bytes / self.num_encoded_bytes))
+      return data
+
+   def stream_callback(self, _sender_uuid, data):
+      if len(data) < 3 or not self.active:
+         return
+      sequence, flags = struct.unpack('<HB', data[0:3])
+      offset = (sequence - self.next_sequence) & 0xFFFF
+      ack_requested = flags & STREAM_FLAG_ACK_REQUESTED
+      self.last_activity = time.time()
+      if offset >= STREAM_WINDOW_NUM_PACKETS or (self.next_sequence + offset) in self.pending:
+         if ack_requested:
+            asyncio.ensure_future(self.send_ack(False))
+         return
+      absolute_sequence = self.next_sequence + offset
+      self.pending[absolute_sequence] = (flags, bytes(data[3:]))
+      self.highest_sequence = max(self.highest_sequence, absolute_sequence)
+      gap_detected = offset > 0 and len(self.pending) == 1
+      finished = False
+      while self.next_sequence in self.pending:
+         flags, payload = self.pending.pop(self.next_sequence)
+         self.next_sequence += 1
+         self.num_since_ack += 1
+         self.stream_bytes += payload
+         finished = finished or (flags & STREAM_FLAG_FINAL)
+      self.parse_stream_records()
+      if finished:
+         asyncio.ensure_future(self.send_ack(True))
+      elif gap_detected or ack_requested or self.num_since_ack >= (STREAM_WINDOW_NUM_PACKETS // 2):
+         asyncio.ensure_future(self.send_ack(False))
+
+   def parse_stream_records(self):
+      if not self.header_parsed:
+         if len(self.stream_bytes) < 4 + EXPERIMENT_DETAILS_LENGTH:
+            return
+         header = bytes(self.stream_bytes[0:4+EXPERIMENT_DETAILS_LENGTH])
+         del self.stream_bytes[0:4+EXPERIMENT_DETAILS_LENGTH]
+         self.header_parsed = True
+         if self.details is None:
+            # Chunks saved for a different experiment, such as after re-provisioning the same TotTag, must not be spliced into this log
+            if self.stored_header is not None and self.stored_header[4:] != header[4:]:
+               print('Discarding the partial log download from {} as its experiment details have changed'.format(self.client.address))
+               self.stored_header, self.chunks, self.num_chunk_bytes = None, {}, 0
+               os.remove(self.partial_path)
+            earlier_bytes = self.num_chunk_bytes if self.chunks or not self.first_requested_chunk else (self.first_requested_chunk * MEMORY_NUM_DATA_BYTES_PER_PAGE)
+            self.total_length = max(struct.unpack('<I', header[0:4])[0] + earlier_bytes, 1)
+            self.details = unpack_experiment_details(header[4:])
+            if self.stored_header is None:
+               self.stored_header = header
+               append_partial_download(self.partial_path, PARTIAL_DOWNLOAD_HEADER_INDEX, header)
+      header_length = struct.calcsize(STREAM_RECORD_HEADER_FORMAT)
+      index = 0
+      while index + header_length <= len(self.stream_bytes):
+         chunk_index, length = struct.unpack(STREAM_RECORD_HEADER_FORMAT, self.stream_bytes[index:index+header_length])
+         record_end = index + header_length + length + STREAM_RECORD_CRC_LENGTH
+         if record_end > len(self.stream_bytes):
+            break
+         data = bytes(self.stream_bytes[index+header_length:record_end-STREAM_RECORD_CRC_LENGTH])
+         crc = struct.unpack('<I', self.stream_bytes[record_end-STREAM_RECORD_CRC_LENGTH:record_end])[0]
+         index = record_end
+         if chunk_index != STREAM_MANIFEST_INDEX:
+            self.num_encoded_bytes += len(data)
+            try:
+               data = decode_log_chunk(data)
+            except Exception:
+               data = b''
+         if zlib.crc32(data) != crc:
+            print('Discarding log chunk {} from {} due to a CRC mismatch'.format(chunk_index, self.client.address))
+         elif chunk_index == STREAM_MANIFEST_INDEX:
+            self.manifest = struct.unpack(STREAM_MANIFEST_FORMAT, data)
+         elif chunk_index not in self.chunks:
+            self.chunks[chunk_index] = data
+            self.num_chunk_bytes += len(data)
+            append_partial_download(self.partial_path, chunk_index, data)
+      del self.stream_bytes[0:index]
+      self.progress_callback(self.num_chunk_bytes, self.total_length)
+
+   def missing_chunks(self):
+      if self.manifest is None:
+         return None
+      return sorted(set(range(self.manifest[2])) - self.chunks.keys())
+
+   async def request_log_chunks(self, first_chunk, max_chunks):
+      self.next_sequence = self.num_since_ack = 0
+      self.highest_sequence = -1
+      self.pending = {}
+      self.stream_bytes = bytearray()
+      self.header_parsed = False
+      self.manifest = None
+      self.num_chunks_at_request = len(self.chunks)
+      self.first_requested_chunk = first_chunk
+      self.last_activity = time.time()
+      await self.client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BII', MAINTENANCE_SET_LOG_DOWNLOAD_DATES, self.start_timestamp, self.end_timestamp), True)
+      await self.client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BII', MAINTENANCE_SET_LOG_DOWNLOAD_CHUNKS, first_chunk, max_chunks), True)
+      await self.client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BB', MAINTENANCE_SET_LOG_DOWNLOAD_COMPRESSION, 1), True)
+      await self.client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('B', MAINTENANCE_DOWNLOAD_LOG_STREAMED), True)
+
+   async def finish_log_request(self):
+      missing_chunks = self.missing_chunks()
+      if self.active and (missing_chunks is None or missing_chunks):
+         if len(self.chunks) > self.num_chunks_at_request:
+            self.num_unproductive_requests = 0
+         else:
+            self.num_unproductive_requests += 1
+         if self.num_unproductive_requests < STREAM_MAX_UNPRODUCTIVE_REQUESTS:
+            first_chunk = missing_chunks[0] if missing_chunks else 0
+            num_chunks = 0
+            if missing_chunks:
+               num_chunks = 1
+               while num_chunks < len(missing_chunks) and missing_chunks[num_chunks] == first_chunk + num_chunks:
+                  num_chunks += 1
+            print('Re-requesting {} log chunks from {} starting at chunk {}'.format(num_chunks if num_chunks else 'all', self.client.address, first_chunk))
+            try:
+               await self.request_log_chunks(first_chunk, num_chunks)
+               return
+            except Exception:
+               pass
+      self.finished.set()
+
+   async def send_ack(self, finished, timed_out=False):
+      self.num_since_ack = 0
+      missing_bitmap = 0
+      for i in range(STREAM_WINDOW_NUM_PACKETS):
+         if (timed_out or (self.next_sequence + i) <= self.highest_sequence) and (self.next_sequence + i) not in self.pending:
+            missing_bitmap |= (1 << i)
+      try:
+         await self.client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BHI', MAINTENANCE_DOWNLOAD_ACK, self.next_sequence & 0xFFFF, missing_bitmap), True)
+      except Exception:
+         pass
+      if finished:
+         await self.finish_log_request()
+
+   async def watchdog(self):
+      while self.active:
+         await asyncio.sleep(STREAM_ACK_TIMEOUT_S)
+         if self.active and (time.time() - self.last_activity) >= STREAM_ACK_TIMEOUT_S:
+            self.last_activity = time.time()
+            await self.send_ack(False, True)
+
+class TotTagSessionManager:
+
+   def __init__(self, result_queue, client_factory=BleakClient, max_concurrent_connections=MAX_CONCURRENT_CONNECTIONS):
+      self.result_queue = result_queue
+      self.client_factory = client_factory
+      self.connection_slots = asyncio.Semaphore(max_concurrent_connections)
+      self.progress = {}
+      self.progress_changed = False
+
+   def update_progress(self, address, state, received, total):
+      self.progress[address] = (state, received, total)
+      self.progress_changed = True
+
+   async def report_progress(self):
+      while True:
+         if self.progress_changed:
+            self.progress_changed = False
+            self.result_queue.put_nowait(('MULTI_PROGRESS', dict(self.progress)))
+         await asyncio.sleep(MULTI_PROGRESS_REPORT_INTERVAL_S)
+
+   async def connect(self, device, disconnected_callback=None):
+      client = self.client_factory(device, disconnected_callback)
+      try:
+         await client.connect(timeout=3.0)
+         if client.is_connected:
+            return client
+      except Exception:
+         pass
+      return None
+
+   async def download_logs(self, devices, params):
+      self.progress.clear()
+      for address in devices:
+         self.update_progress(address, 'Waiting', 0, 1)
+      reporter = asyncio.ensure_future(self.report_progress())
+      with concurrent.futures.ProcessPoolExecutor() as executor:
+         results = await asyncio.gather(*[self.download_from_tottag(address, device, params, executor) for address, device in devices.items()])
+      reporter.cancel()
+      self.result_queue.put_nowait(('MULTI_PROGRESS', dict(self.progress)))
+      return dict(zip(devices.keys(), results))
+
+   async def download_from_tottag(self, address, device, params, executor):
+      download = None
+      num_verified_chunks = num_unproductive_attempts = 0
+      async with self.connection_slots:
+         while num_unproductive_attempts < MAX_CONNECTION_ATTEMPTS:
+            self.update_progress(address, 'Connecting', *self.progress[address][1:])
+            client = await self.connect(device, lambda _client: download.cancel() if download else None)
+            if client is None:
+               num_unproductive_attempts += 1
+               continue
+            try:
+               download = TotTagStreamedDownload(client, params['dir'], params['start'], params['end'], partial(self.update_progress, address, 'Downloading'))
+               await download.run()
+               await read_link_status(client)
+            except Exception:
+               traceback.print_exc()
+            finally:
+               try:
+                  await client.disconnect()
+               except Exception:
+                  pass
+            if download.is_complete():
+               break
+            num_unproductive_attempts = 0 if len(download.chunks) > num_verified_chunks else (num_unproductive_attempts + 1)
+            num_verified_chunks = len(download.chunks)
+      if download is None or not download.is_complete():
+         self.update_progress(address, 'Failed', *self.progress[address][1:])
+         return False
+      self.update_progress(address, 'Processing', download.total_length, download.total_length)
+      try:
+         await asyncio.get_running_loop().run_in_executor(executor, process_tottag_data, int(address.split(':')[-1], 16), params['dir'], download.details, download.assemble(), params['raw'])
+      except Exception:
+         traceback.print_exc()
+         self.update_progress(address, 'Failed', download.total_length, download.total_length)
+         return False
+      self.update_progress(address, 'Complete', download.total_length, download.total_length)
+      return True
+
+   async def provision(self, devices, details):
+      packed_details = pack_experiment_details(details)
+      results = await asyncio.gather(*[self.provision_tottag(device, packed_details) for device in devices.values()])
+      return [address for address, success in zip(devices.keys(), results) if not success]
+
+   async def provision_tottag(self, device, packed_details):
+      async with self.connection_slots:
+         for _ in range(MAX_CONNECTION_ATTEMPTS):
+            client = await self.connect(device)
+            if client is None:
+               continue
+            try:
+               await client.write_gatt_char(TIMESTAMP_SERVICE_UUID, struct.pack('<I', round(datetime.datetime.now(datetime.timezone.utc).timestamp())), True)
+               await client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, packed_details, True)
+               return True
+            except Exception:
+               pass
+            finally:
+               try:
+                  await client.disconnect()
+               except Exception:
+                  pass
+      return False
+
 class TotTagBLE(threading.Thread):
 
-   def __init__(self, command_queue, result_queue, event_loop):
+   def __init__(self, command_queue, result_queue, event_loop, client_factory=BleakClient, scanner_factory=BleakScanner):
       super().__init__()
       self.operations = { 'SCAN': self.scan_for_tottags,
                           'CONNECT': self.connect_to_tottag,
                           'DISCONNECT': self.disconnect_from_tottag,
                           'SUBSCRIBE_RANGES': self.subscribe_to_ranges,
+                          'OBSERVE_RANGES': self.observe_broadcast_ranges,
                           'FIND_TOTTAG': self.find_my_tottag,
                           'TIMESTAMP': self.retrieve_timestamp,
                           'VOLTAGE': self.retrieve_voltage,
+                          'STORAGE': self.retrieve_storage_status,
                           'NEW_EXPERIMENT_FULL': self.create_new_experiment,
                           'NEW_EXPERIMENT_SINGLE': self.update_new_experiment,
                           'GET_EXPERIMENT': self.retrieve_experiment,
                           'DELETE_EXPERIMENT': self.delete_experiment,
                           'DOWNLOAD': self.download_logs,
+                          'DOWNLOAD_MULTIPLE': self.download_multiple_logs,
                           'DOWNLOAD_DONE': self.download_logs_done }
       self.storage_directory = get_download_directory()
       self.subscribed_to_notifications = False
+      self.broadcast_scanner = None
+      self.broadcast_sequences = {}
       self.downloading_log_file = False
       self.download_raw_logs = False
       self.command_queue = command_queue
@@ -201,10 +714,15 @@ class TotTagBLE(threading.Thread):
       self.discovered_devices = {}
       self.connected_device = None
       self.event_loop = event_loop
+      self.client_factory = client_factory
+      self.scanner_factory = scanner_factory
+      self.session_manager = TotTagSessionManager(result_queue, client_factory)
+      self.streamed_download = None
       self.data_details = None
       self.data_length = 0
       self.data_index = 0
       self.data = None
+      self.download_start_time = 0
 
    def run(self):
       self.event_loop.run_until_complete(self.await_command())
@@ -216,6 +734,8 @@ class TotTagBLE(threading.Thread):
          await self.download_logs_done()
          if self.subscribed_to_notifications:
             await self.unsubscribe_from_ranges()
+         if self.broadcast_scanner is not None:
+            await self.stop_observing_broadcast_ranges()
          if command in self.operations:
             await self.operations[command]()
          else:
@@ -223,11 +743,26 @@ class TotTagBLE(threading.Thread):
          self.command_queue.task_done()
 
    def disconnected_callback(self, _device):
+      if self.downloading_log_file and self.streamed_download is not None:
+         self.downloading_log_file = False
+         self.streamed_download.cancel()
+         self.result_queue.put_nowait(('ERROR', ('TotTag Error', 'Log download interrupted after {} verified chunks. Downloading the same date range again will resume where it left off.'.format(len(self.streamed_download.chunks)))))
       self.result_queue.put_nowait(('DISCONNECTED', True))
       self.connected_device = None
 
    def ranges_callback(self, _sender_uuid, data):
-      self.result_queue.put_nowait(('RANGES', data))
+      # Batched rounds arrive together, so date each one by how long before the notification it was ranged
+      rounds, now = unpack_range_batch(data)[1], time.time()
+      for age, ranges in rounds:
+         self.result_queue.put_nowait(('RANGES', (now - age, ranges)))
+
+   def broadcast_callback(self, device, advertisement_data):
+      # Only report each ranging round once, since active scans deliver the same scan response repeatedly
+      broadcast = advertisement_data.manufacturer_data.get(BLUETOOTH_COMPANY_ID)
+      ranges = unpack_live_range_broadcast(broadcast) if broadcast else None
+      if ranges is not None and self.broadcast_sequences.get(device.address) != ranges[0]:
+         self.broadcast_sequences[device.address] = ranges[0]
+         self.result_queue.put_nowait(('BROADCAST_RANGES', (device.address, ranges[0], ranges[1], time.time())))
 
    def data_callback(self, _sender_uuid, data):
       if self.data_length == 0:
@@ -246,10 +781,24 @@ class TotTagBLE(threading.Thread):
          self.data_index += len(data)
          self.result_queue.put_nowait(('LOGDATA', self.data_index))
 
+   def streamed_download_progress(self, received, total):
+      if self.data_length == 0:
+         self.data_length = total
+         self.result_queue.put_nowait(('LOGDATA', total))
+      else:
+         self.result_queue.put_nowait(('LOGDATA', received))
+
+   async def await_streamed_download(self):
+      try:
+         await self.streamed_download.run()
+      except Exception:
+         traceback.print_exc()
+      self.command_queue.put_nowait('DOWNLOAD_DONE')
+
    async def scan_for_tottags(self):
       self.result_queue.put_nowait(('SCANNING', True))
       self.discovered_devices.clear()
-      scanner = BleakScanner(cb={ 'use_bdaddr': True })
+      scanner = self.scanner_factory(cb={ 'use_bdaddr': True })
       await scanner.start()
       await asyncio.sleep(5)
       await scanner.stop()
@@ -262,7 +811,7 @@ class TotTagBLE(threading.Thread):
    async def connect_to_tottag(self):
       self.result_queue.put_nowait(('CONNECTING', True))
       device_address = await self.command_queue.get()
-      device = BleakClient(self.discovered_devices[device_address], partial(self.disconnected_callback))
+      device = self.client_factory(self.discovered_devices[device_address], partial(self.disconnected_callback))
       try:
          await device.connect(timeout=3.0)
          if device.is_connected:
@@ -280,6 +829,7 @@ class TotTagBLE(threading.Thread):
 
    async def subscribe_to_ranges(self):
       try:
+         await self.connected_device.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BB', MAINTENANCE_SET_RANGE_BATCHING, LIVE_RANGE_BATCH_NUM_ROUNDS), True)
          await self.connected_device.start_notify(LOCATION_SERVICE_UUID, partial(self.ranges_callback))
          self.subscribed_to_notifications = True
       except Exception:
@@ -292,6 +842,22 @@ class TotTagBLE(threading.Thread):
       except Exception:
          pass
 
+   async def observe_broadcast_ranges(self):
+      self.broadcast_sequences.clear()
+      try:
+         self.broadcast_scanner = self.scanner_factory(detection_callback=self.broadcast_callback, cb={ 'use_bdaddr': True })
+         await self.broadcast_scanner.start()
+      except Exception:
+         self.broadcast_scanner = None
+         self.result_queue.put_nowait(('ERROR', ('TotTag Error', 'Unable to scan for broadcast ranging data')))
+
+   async def stop_observing_broadcast_ranges(self):
+      scanner, self.broadcast_scanner = self.broadcast_scanner, None
+      try:
+         await scanner.stop()
+      except Exception:
+         pass
+
    async def find_my_tottag(self):
       self.result_queue.put_nowait(('RETRIEVING', True))
       try:
@@ -316,22 +882,20 @@ class TotTagBLE(threading.Thread):
       except Exception:
          self.result_queue.put_nowait(('ERROR', ('TotTag Error', 'Unable to retrieve current battery level from TotTag')))
 
+   async def retrieve_storage_status(self):
+      self.result_queue.put_nowait(('RETRIEVING', True))
+      try:
+         status = struct.unpack('<BBI', bytes(await self.connected_device.read_gatt_char(STORAGE_STATUS_SERVICE_UUID)))
+         self.result_queue.put_nowait(('STORAGE', status))
+      except Exception:
+         self.result_queue.put_nowait(('ERROR', ('TotTag Error', 'Unable to retrieve storage status from TotTag')))
+
    async def create_new_experiment(self):
       self.result_queue.put_nowait(('SCHEDULING', True))
       details = await self.command_queue.get()
-      packed_details = pack_experiment_details(details)
-      for device_id in details['devices']:
-         retry_count = 0
-         while retry_count < 3:
-            try:
-               async with BleakClient(self.discovered_devices[device_id]) as client:
-                  await client.write_gatt_char(TIMESTAMP_SERVICE_UUID, struct.pack('<I', round(datetime.datetime.now(datetime.timezone.utc).timestamp())), True)
-                  await client.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, packed_details, True)
-                  retry_count = 3
-            except Exception:
-               retry_count += 1
-               if retry_count == 3:
-                  self.result_queue.put_nowait(('SCHEDULING_FAILURE', device_id))
+      devices = { device_id: self.discovered_devices[device_id] for device_id in details['devices'] }
+      for device_id in await self.session_manager.provision(devices, details):
+         self.result_queue.put_nowait(('SCHEDULING_FAILURE', device_id))
       self.result_queue.put_nowait(('SCHEDULED', details))
       self.command_queue.task_done()
 
@@ -374,22 +938,57 @@ class TotTagBLE(threading.Thread):
       self.storage_directory = params['dir']
       self.download_raw_logs = params['raw']
       try:
-         self.data_length = 0
-         await self.connected_device.start_notify(MAINTENANCE_DATA_SERVICE_UUID, partial(self.data_callback))
-         await self.connected_device.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BII', MAINTENANCE_SET_LOG_DOWNLOAD_DATES, params['start'], params['end']), True)
-         await self.connected_device.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('B', MAINTENANCE_DOWNLOAD_LOG), True)
-         self.downloading_log_file = True
+         self.data_length = self.data_index = 0
+         self.data_details = None
+         self.download_start_time = time.time()
+         self.streamed_download = None
+         if params['streamed']:
+            self.streamed_download = TotTagStreamedDownload(self.connected_device, self.storage_directory, params['start'], params['end'], self.streamed_download_progress)
+            self.downloading_log_file = True
+            asyncio.ensure_future(self.await_streamed_download())
+         else:
+            await self.connected_device.start_notify(MAINTENANCE_DATA_SERVICE_UUID, partial(self.data_callback))
+            await self.connected_device.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('<BII', MAINTENANCE_SET_LOG_DOWNLOAD_DATES, params['start'], params['end']), True)
+            await self.connected_device.write_gatt_char(MAINTENANCE_COMMAND_SERVICE_UUID, struct.pack('B', MAINTENANCE_DOWNLOAD_LOG), True)
+            self.downloading_log_file = True
       except Exception:
+         self.downloading_log_file = False
          await self.connected_device.stop_notify(MAINTENANCE_DATA_SERVICE_UUID)
          self.result_queue.put_nowait(('ERROR', ('TotTag Error', 'Unable to retrieve log files from the TotTag')))
       self.command_queue.task_done()
 
+   async def download_multiple_logs(self):
+      params = await self.command_queue.get()
+      self.storage_directory = params['dir']
+      await self.disconnect_from_tottag()
+      devices = { address: self.discovered_devices[address] for address in params['devices'] }
+      start_time = time.time()
+      results = await self.session_manager.download_logs(devices, params)
+      print('Downloaded logs from {} of {} TotTags in {:.1f} s'.format(sum(results.values()), len(results), time.time() - start_time))
+      self.result_queue.put_nowait(('MULTI_DOWNLOADED', results))
+      self.command_queue.task_done()
+
    async def download_logs_done(self):
       if self.downloading_log_file:
          try:
             self.downloading_log_file = False
-            self.result_queue.put_nowait(('DOWNLOADED', self.data_length > 1))
-            await self.connected_device.stop_notify(MAINTENANCE_DATA_SERVICE_UUID)
+            if self.streamed_download is not None:
+               self.streamed_download.cancel()
+               complete = self.streamed_download.is_complete()
+               missing_chunks = self.streamed_download.missing_chunks()
+               self.data_details = self.streamed_download.details
+               self.data = self.streamed_download.assemble()
+               self.data_index = len(self.data)
+               if not complete:
+                  self.result_queue.put_nowait(('ERROR', ('TotTag Error', 'Log download is missing {} chunks. Downloading the same date range again will resume where it left off.'.format(len(missing_chunks) if missing_chunks else 'some'))))
+                  return
+            elapsed = max(time.time() - self.download_start_time, 0.001)
+            throughput = self.data_index / 1024.0 / elapsed
+            print('Downloaded {} bytes in {:.1f} s ({:.2f} KB/s)'.format(self.data_index, elapsed, throughput))
+            link_status = await read_link_status(self.connected_device)
+            self.result_queue.put_nowait(('DOWNLOADED', (self.data_length > 1, throughput, link_status)))
+            if self.streamed_download is None:
+               await self.connected_device.stop_notify(MAINTENANCE_DATA_SERVICE_UUID)
             process_tottag_data(int(self.connected_device.address.split(':')[-1], 16), self.storage_directory, self.data_details, self.data[:self.data_index], self.download_raw_logs)
          except Exception as e:
             print('Log file processing error:', e);
@@ -400,7 +999,7 @@ class TotTagBLE(threading.Thread):
 
 class TotTagGUI(tk.Frame):
 
-   def __init__(self):
+   def __init__(self, client_factory=BleakClient, scanner_factory=BleakScanner):
 
       # Set up the root application window
       super().__init__(None)
@@ -422,6 +1021,7 @@ class TotTagGUI(tk.Frame):
       self.failed_devices = []
       self.use_daily_times = tk.IntVar()
       self.download_raw_data = tk.IntVar()
+      self.download_legacy_mode = tk.IntVar()
       self.ble_command_queue = asyncio.Queue()
       self.ble_result_queue = queue.Queue()
       self.tottag_selection = tk.StringVar(self.master, 'Press "Scan for TotTags" to begin...')
@@ -434,6 +1034,7 @@ class TotTagGUI(tk.Frame):
       self.start_date = tk.StringVar()
       self.end_date = tk.StringVar()
       self.data_length = 0
+      self.multi_progress_area = None
 
       # Create the control bar
       control_bar = tk.Frame(self)
@@ -455,11 +1056,16 @@ class TotTagGUI(tk.Frame):
       ttk.Button(self.operations_bar, text="Activate Find my TotTag", command=partial(ble_issue_command, self.event_loop, self.ble_command_queue, 'FIND_TOTTAG'), state=['disabled']).grid(row=2, sticky=tk.W+tk.E)
       ttk.Button(self.operations_bar, text="Retrieve Current Timestamp", command=partial(ble_issue_command, self.event_loop, self.ble_command_queue, 'TIMESTAMP'), state=['disabled']).grid(row=3, sticky=tk.W+tk.E)
       ttk.Button(self.operations_bar, text="Retrieve Battery Voltage", command=partial(ble_issue_command, self.event_loop, self.ble_command_queue, 'VOLTAGE'), state=['disabled']).grid(row=4, sticky=tk.W+tk.E)
+      ttk.Button(self.operations_bar, text="Retrieve Storage Status", command=partial(ble_issue_command, self.event_loop, self.ble_command_queue, 'STORAGE'), state=['disabled']).grid(row=5, sticky=tk.W+tk.E)
       self.schedule_button = ttk.Button(self.operations_bar, text="Schedule New Pilot Deployment", command=self._create_new_experiment, state=['disabled'])
-      self.schedule_button.grid(row=5, sticky=tk.W+tk.E)
-      ttk.Button(self.operations_bar, text="Get Scheduled Deployment Details", command=partial(ble_issue_command, self.event_loop, self.ble_command_queue, 'GET_EXPERIMENT'), state=['disabled']).grid(row=6, sticky=tk.W+tk.E)
-      ttk.Button(self.operations_bar, text="Cancel Scheduled Pilot Deployment", command=self._delete_experiment, state=['disabled']).grid(row=7, sticky=tk.W+tk.E)
-      ttk.Button(self.operations_bar, text="Download Deployment Logs", command=self._download_logs, state=['disabled']).grid(row=8, sticky=tk.W+tk.E)
+      self.schedule_button.grid(row=6, sticky=tk.W+tk.E)
+      ttk.Button(self.operations_bar, text="Get Scheduled Deployment Details", command=partial(ble_issue_command, self.event_loop, self.ble_command_queue, 'GET_EXPERIMENT'), state=['disabled']).grid(row=7, sticky=tk.W+tk.E)
+      ttk.Button(self.operations_bar, text="Cancel Scheduled Pilot Deployment", command=self._delete_experiment, state=['disabled']).grid(row=8, sticky=tk.W+tk.E)
+      ttk.Button(self.operations_bar, text="Download Deployment Logs", command=self._download_logs, state=['disabled']).grid(row=9, sticky=tk.W+tk.E)
+      self.multi_download_button = ttk.Button(self.operations_bar, text="Download Logs from Multiple TotTags", command=self._download_multiple_logs, state=['disabled'])
+      self.multi_download_button.grid(row=10, sticky=tk.W+tk.E)
+      self.observe_button = ttk.Button(self.operations_bar, text="Observe Broadcast Ranging Data", command=self._observe_broadcast_ranges)
+      self.observe_button.grid(row=11, sticky=tk.W+tk.E)
 
       # Create the workspace canvas
       self.canvas = tk.Frame(self)
@@ -467,7 +1073,7 @@ class TotTagGUI(tk.Frame):
       tk.Label(self.canvas, text="Scan for TotTag devices to continue...").pack(fill=tk.BOTH, expand=True)
 
       # Start the BLE communications thread
-      self.ble_comms = TotTagBLE(self.ble_command_queue, self.ble_result_queue, self.event_loop)
+      self.ble_comms = TotTagBLE(self.ble_command_queue, self.ble_result_queue, self.event_loop, client_factory, scanner_factory)
       self.ble_comms.daemon = True
       self.ble_comms.start()
 
@@ -496,6 +1102,7 @@ class TotTagGUI(tk.Frame):
    def _download_logs(self):
       self._clear_canvas()
       self.download_raw_data.set(0)
+      self.download_legacy_mode.set(0)
       prompt_area = tk.Frame(self.canvas)
       prompt_area.place(relx=0.5, rely=0.5, anchor=tk.CENTER)
       tk.Label(prompt_area, text="Download Deployment Log Files").grid(column=0, row=0, columnspan=4, sticky=tk.W+tk.E+tk.N+tk.S)
@@ -519,19 +1126,100 @@ class TotTagGUI(tk.Frame):
       tkcalendar.DateEntry(start_time_controls, textvariable=self.start_date, selectmode='day', firstweekday='sunday', showweeknumbers=False, date_pattern='mm/dd/yyyy').pack(side=tk.LEFT)
       tkcalendar.DateEntry(end_time_controls, textvariable=self.end_date, selectmode='day', firstweekday='sunday', showweeknumbers=False, date_pattern='mm/dd/yyyy').pack(side=tk.RIGHT)
       ttk.Label(end_time_controls, text="End Date: ").pack(side=tk.RIGHT)
-      ttk.Checkbutton(prompt_area, text="Download Raw Unprocessed Data", variable=self.download_raw_data).grid(column=0, columnspan=4, row=8, pady=5, sticky=tk.W+tk.N)
+      ttk.Checkbutton(prompt_area, text="Download Raw Unprocessed Data", variable=self.download_raw_data).grid(column=0, columnspan=2, row=8, pady=5, sticky=tk.W+tk.N)
+      ttk.Checkbutton(prompt_area, text="Use Legacy Download Protocol", variable=self.download_legacy_mode).grid(column=2, columnspan=2, row=8, pady=5, sticky=tk.E+tk.N)
       def begin_download(self):
          self.data_length = 0
          ble_issue_command(self.event_loop, self.ble_command_queue, 'DOWNLOAD')
          ble_issue_command(self.event_loop, self.ble_command_queue, {
             'dir': self.save_directory.get(),
             'raw': self.download_raw_data.get(),
+            'streamed': not self.download_legacy_mode.get(),
             'start': pack_datetime(str(tzlocal.get_localzone()), self.start_date.get(), "00:00", False),
             'end': pack_datetime(str(tzlocal.get_localzone()), self.end_date.get(), "00:00", False)
          })
       ttk.Button(prompt_area, text="Begin", command=partial(begin_download, self)).grid(column=1, row=9)
       ttk.Button(prompt_area, text="Cancel", command=partial(self._clear_canvas_with_prompt)).grid(column=2, row=9)
 
+   def _download_multiple_logs(self):
+      self._clear_canvas()
+      self.download_raw_data.set(0)
+      prompt_area = tk.Frame(self.canvas)
+      prompt_area.place(relx=0.5, rely=0.5, anchor=tk.CENTER)
+      tk.Label(prompt_area, text="Download Deployment Logs from Multiple TotTags").grid(column=0, row=0, columnspan=4, sticky=tk.W+tk.E+tk.N+tk.S)
+      ttk.Label(prompt_area, text=" ").grid(column=0, row=1)
+      selections = {}
+      for i, device_id in enumerate(self.device_list):
+         selections[device_id] = tk.IntVar(prompt_area, 1)
+         ttk.Checkbutton(prompt_area, text=device_id, variable=selections[device_id]).grid(column=(i%2)*2, columnspan=2, row=2+(i//2), sticky=tk.W)
+      row = 3 + (len(self.device_list) // 2)
+      ttk.Label(prompt_area, text=" ", font=('Helvetica', '4')).grid(column=0, row=row)
+      save_controls = tk.Frame(prompt_area)
+      save_controls.grid(column=0, row=row+1, columnspan=4, sticky=tk.W+tk.E+tk.N+tk.S)
+      ttk.Label(save_controls, text="Saving to: ").pack(side=tk.LEFT)
+      ttk.Button(save_controls, text="Change", command=self._change_save_directory).pack(side=tk.RIGHT)
+      ttk.Entry(save_controls, textvariable=self.save_directory).pack(fill=tk.X)
+      ttk.Label(prompt_area, text=" ", font=('Helvetica', '4')).grid(column=0, row=row+2)
+      start_time_controls = tk.Frame(prompt_area)
+      start_time_controls.grid(column=0, row=row+3, columnspan=2, sticky=tk.W+tk.E+tk.N+tk.S)
+      end_time_controls = tk.Frame(prompt_area)
+      end_time_controls.grid(column=2, row=row+3, columnspan=2, sticky=tk.W+tk.E+tk.N+tk.S)
+      ttk.Label(start_time_controls, text="Start Date: ").pack(side=tk.LEFT)
+      tkcalendar.DateEntry(start_time_controls, textvariable=self.start_date, selectmode='day', firstweekday='sunday', showweeknumbers=False, date_pattern='mm/dd/yyyy').pack(side=tk.LEFT)
+      tkcalendar.DateEntry(end_time_controls, textvariable=self.end_date, selectmode='day', firstweekday='sunday', showweeknumbers=False, date_pattern='mm/dd/yyyy').pack(side=tk.RIGHT)
+      ttk.Label(end_time_controls, text="End Date: ").pack(side=tk.RIGHT)
+      ttk.Checkbutton(prompt_area, text="Download Raw Unprocessed Data", variable=self.download_raw_data).grid(column=0, columnspan=2, row=row+4, pady=5, sticky=tk.W+tk.N)
+      def begin_download(self):
+         devices = [device_id for device_id, selected in selections.items() if selected.get()]
+         if devices:
+            self.scan_button['state'] = ['disabled']
+            self.connect_button['state'] = ['disabled']
+            self.multi_download_button['state'] = ['disabled']
+            self.observe_button['state'] = ['disabled']
+            self._multi_progress_received({ device_id: ('Waiting', 0, 1) for device_id in devices })
+            ble_issue_command(self.event_loop, self.ble_command_queue, 'DOWNLOAD_MULTIPLE')
+            ble_issue_command(self.event_loop, self.ble_command_queue, {
+               'devices': devices,
+               'dir': self.save_directory.get(),
+               'raw': self.download_raw_data.get(),
+               'start': pack_datetime(str(tzlocal.get_localzone()), self.start_date.get(), "00:00", False),
+               'end': pack_datetime(str(tzlocal.get_localzone()), self.end_date.get(), "00:00", False)
+            })
+      ttk.Button(prompt_area, text="Begin", command=partial(begin_download, self)).grid(column=1, row=row+5)
+      ttk.Button(prompt_area, text="Cancel", command=partial(self._clear_canvas_with_prompt)).grid(column=2, row=row+5)
+
+   def _multi_progress_received(self, progress):
+      if self.multi_progress_area is None or not self.multi_progress_area.winfo_exists():
+         self._clear_canvas()
+         self.multi_progress_area = tk.Frame(self.canvas)
+         self.multi_progress_area.place(relx=0.5, rely=0.5, anchor=tk.CENTER)
+         self.multi_progress_rows = {}
+         tk.Label(self.multi_progress_area, text="Downloading Deployment Logs").grid(column=0, row=0, columnspan=3, sticky=tk.W+tk.E+tk.N+tk.S)
+         ttk.Label(self.multi_progress_area, text=" ").grid(column=0, row=1)
+         for i, device_id in enumerate(progress):
+            ttk.Label(self.multi_progress_area, text=device_id).grid(column=0, row=2+i, sticky=tk.W)
+            state_label = ttk.Label(self.multi_progress_area, width=12)
+            state_label.grid(column=1, row=2+i, padx=10, sticky=tk.W)
+            progress_bar = ttk.Progressbar(self.multi_progress_area, mode='determinate', orient=tk.HORIZONTAL, length=250)
+            progress_bar.grid(column=2, row=2+i)
+            self.multi_progress_rows[device_id] = (state_label, progress_bar)
+         ttk.Label(self.multi_progress_area, text=" ").grid(column=0, row=2+len(progress))
+         self.progress_label = ttk.Label(self.multi_progress_area, text="Overall Progress: 0%")
+         self.progress_label.grid(column=0, row=3+len(progress), columnspan=3, sticky=tk.W)
+         self.progress_bar = ttk.Progressbar(self.multi_progress_area, mode='determinate', orient=tk.HORIZONTAL, length=400)
+         self.progress_bar.grid(column=0, row=4+len(progress), columnspan=3)
+      total_fraction = 0.0
+      for device_id, (state, received, total) in progress.items():
+         if device_id in self.multi_progress_rows:
+            state_label, progress_bar = self.multi_progress_rows[device_id]
+            state_label['text'] = state
+            progress_bar['maximum'] = max(total, 1)
+            progress_bar['value'] = min(received, total)
+         total_fraction += 1.0 if state in ('Complete', 'Failed') else min(received / max(total, 1), 1.0)
+      self.progress_bar['maximum'] = 100
+      self.progress_bar['value'] = 100.0 * total_fraction / max(len(progress), 1)
+      self.progress_label['text'] = 'Overall Progress: %d%%'%(int(self.progress_bar['value']))
+
    def _create_new_experiment(self):
       self._clear_canvas()
       self.tottag_rows = []
@@ -705,7 +1393,7 @@ class TotTagGUI(tk.Frame):
       for i in range(len(uids)):
          ttk.Label(area, text='        ' + uids[i] + ': ' + (labels[i] if labels[i] else '<unlabeled>')).grid(row=21+i, column=0, columnspan=5, sticky=tk.W+tk.E)
 
-   def _subscribe_to_live_ranges(self):
+   def _create_range_text_area(self):
       self._clear_canvas()
       scroll_area = tk.Frame(self.canvas)
       scroll_area.pack(fill=tk.BOTH, expand=True)
@@ -716,13 +1404,44 @@ class TotTagGUI(tk.Frame):
       scrollbar = ttk.Scrollbar(scroll_area, command=self.txt_area.yview)
       scrollbar.grid(row=0, column=1, sticky=tk.N+tk.S+tk.E+tk.W)
       self.txt_area['yscrollcommand'] = scrollbar.set
+      self.live_contacts = ContactTracker()
+
+   def _ended_contacts_text(self, pair, episodes):
+      return ''.join('   Contact with 0x%02X ended after %.0f s (mean %d mm, min %d mm)\n'%(pair[-1], episode['duration_s'], episode['mean_mm'], episode['min_mm']) for episode in episodes)
+
+   def _contact_text(self, pair, timestamp, range_mm):
+      # Track contact episodes for every pair, noting the length of any ongoing episode and the summary of any that just ended
+      episodes = self.live_contacts.update(pair, timestamp, range_mm)
+      duration = self.live_contacts.current_duration(pair)
+      return (' (in contact for %.0f s)\n'%duration if duration > 0 else '\n') + self._ended_contacts_text(pair, episodes)
+
+   def _subscribe_to_live_ranges(self):
+      self._create_range_text_area()
       ble_issue_command(self.event_loop, self.ble_command_queue, 'SUBSCRIBE_RANGES')
 
+   def _observe_broadcast_ranges(self):
+      self._create_range_text_area()
+      ble_issue_command(self.event_loop, self.ble_command_queue, 'OBSERVE_RANGES')
+
    def _range_received(self, data):
+      timestamp, data = data
       self.txt_area['state'] = tk.NORMAL
       txt_string = 'Ranges to %d devices:\n'%data[0]
+      txt_string += ''.join(self._ended_contacts_text(pair, episodes) for pair, episodes in self.live_contacts.advance(timestamp).items())
       for i in range(data[0]):
-         txt_string += '   0x%02X: %d mm\n'%(data[(3*i)+1], struct.unpack('<H', data[(3*i)+2:(3*i)+4])[0])
+         range_mm = struct.unpack('<H', data[(3*i)+2:(3*i)+4])[0]
+         txt_string += '   0x%02X: %d mm'%(data[(3*i)+1], range_mm) + self._contact_text((data[(3*i)+1],), timestamp, range_mm)
+      self.txt_area.insert(tk.INSERT, txt_string)
+      self.txt_area.see(tk.END)
+      self.txt_area['state'] = tk.DISABLED
+
+   def _broadcast_range_received(self, data):
+      address, sequence, ranges, timestamp = data
+      self.txt_area['state'] = tk.NORMAL
+      txt_string = 'Broadcast from %s (round %d) with ranges to %d devices:\n'%(address, sequence, len(ranges))
+      txt_string += ''.join(self._ended_contacts_text(pair, episodes) for pair, episodes in self.live_contacts.advance(timestamp).items())
+      for eui, range_mm in ranges.items():
+         txt_string += '   0x%02X: %d mm'%(eui, range_mm) + self._contact_text((address, eui), timestamp, range_mm)
       self.txt_area.insert(tk.INSERT, txt_string)
       self.txt_area.see(tk.END)
       self.txt_area['state'] = tk.DISABLED
@@ -747,16 +1466,20 @@ class TotTagGUI(tk.Frame):
                self.scan_button['state'] = ['disabled']
                self.connect_button['state'] = ['disabled']
                self.schedule_button['state'] = ['disabled']
+               self.multi_download_button['state'] = ['disabled']
+               self.observe_button['state'] = ['disabled']
                self.tottag_selection.set('Scanning for TotTags...')
                tk.Label(self.canvas, text="Scanning for TotTag devices. Please wait...").pack(fill=tk.BOTH, expand=True)
             else:
                self.scan_button['state'] = ['enabled']
+               self.observe_button['state'] = ['enabled']
                if len(self.device_list) == 0:
                   self.tottag_selection.set('No TotTags found!')
                   tk.Label(self.canvas, text="No TotTag devices found!").pack(fill=tk.BOTH, expand=True)
                else:
                   self.connect_button['state'] = ['enabled']
                   self.schedule_button['state'] = ['enabled']
+                  self.multi_download_button['state'] = ['enabled']
                   self.tottag_selector['values'] = self.device_list
                   self.tottag_selection.set(self.device_list[0])
                   tk.Label(self.canvas, text="Connect to a TotTag from the list above to continue...").pack(fill=tk.BOTH, expand=True)
@@ -780,7 +1503,9 @@ class TotTagGUI(tk.Frame):
                   item.configure(state=['enabled'])
             self._clear_canvas_with_prompt()
          elif key == 'DISCONNECTED':
-            self._clear_canvas()
+            multi_download_active = self.multi_progress_area is not None
+            if not multi_download_active:
+               self._clear_canvas()
             self.scan_button['state'] = ['enabled']
             self.tottag_selector['values'] = self.device_list
             self.connect_button['command'] = self._connect
@@ -791,7 +1516,15 @@ class TotTagGUI(tk.Frame):
                if isinstance(item, ttk.Button):
                   item.configure(state=['disabled'])
             self.schedule_button['state'] = ['enabled']
-            tk.Label(self.canvas, text="Connect to a TotTag from the list above to continue...").pack(fill=tk.BOTH, expand=True)
+            self.multi_download_button['state'] = ['enabled']
+            self.observe_button['state'] = ['enabled']
+            if multi_download_active:
+               self.scan_button['state'] = ['disabled']
+               self.connect_button['state'] = ['disabled']
+               self.multi_download_button['state'] = ['disabled']
+               self.observe_button['state'] = ['disabled']
+            else:
+               tk.Label(self.canvas, text="Connect to a TotTag from the list above to continue...").pack(fill=tk.BOTH, expand=True)
          elif key == 'RETRIEVING':
             self._clear_canvas()
             if data:
@@ -806,6 +1539,11 @@ class TotTagGUI(tk.Frame):
          elif key == 'VOLTAGE':
             self._clear_canvas()
             tk.Label(self.canvas, text="Current Device Voltage: {} mV".format(data)).pack(fill=tk.BOTH, expand=True)
+         elif key == 'STORAGE':
+            self._clear_canvas()
+            tier = STORAGE_TIERS[data[0]] if data[0] < len(STORAGE_TIERS) else 'Unknown'
+            time_until_full = 'Unknown' if data[2] == 0xFFFFFFFF else '{:.1f} days'.format(data[2] / 86400.0)
+            tk.Label(self.canvas, text="Storage Tier: {}\nStorage Used: {}%\nProjected Time Until Full: {}".format(tier, data[1], time_until_full)).pack(fill=tk.BOTH, expand=True)
          elif key == 'SCHEDULING':
             self._clear_canvas()
             self.failed_devices.clear()
@@ -834,21 +1572,41 @@ class TotTagGUI(tk.Frame):
             tk.Label(self.canvas, text="Deployment was successfully canceled!").pack(fill=tk.BOTH, expand=True)
          elif key == 'RANGES':
             self._range_received(data)
+         elif key == 'BROADCAST_RANGES':
+            self._broadcast_range_received(data)
          elif key == 'LOGDATA':
             self._log_data_received(data)
          elif key == 'DOWNLOADED':
             self._clear_canvas()
-            if data:
-               text = "Download complete! Your files were saved to:\n\n"+self.save_directory.get()
+            if data[0]:
+               text = "Download complete at {:.2f} KB/s! Your files were saved to:\n\n".format(data[1])+self.save_directory.get()
+               if data[2] is not None:
+                  text += "\n\nLink: {:.2f} ms interval, {} PHY, {}-byte packets, {:.2f} KB/s measured on the TotTag".format(
+                        data[2][0] * 1.25, BLE_PHY_NAMES[data[2][3]], data[2][6], data[2][8] / 1.024 / max(data[2][9], 1))
             else:
                text = "No data downloaded!\n\nPlease ensure that your TotTag is charging and in maintenance mode."
             tk.Label(self.canvas, text=text).pack(fill=tk.BOTH, expand=True)
+         elif key == 'MULTI_PROGRESS':
+            self._multi_progress_received(data)
+         elif key == 'MULTI_DOWNLOADED':
+            self._clear_canvas()
+            self.scan_button['state'] = ['enabled']
+            self.connect_button['state'] = ['enabled']
+            self.multi_download_button['state'] = ['enabled']
+            self.observe_button['state'] = ['enabled']
+            text = "Downloaded logs from {} of {} TotTags! Your files were saved to:\n\n".format(sum(data.values()), len(data))+self.save_directory.get()
+            failed_devices = [device_id for device_id, success in data.items() if not success]
+            if failed_devices:
+               text += "\n\nCould not download logs from:\n" + "\n".join(failed_devices)
+               text += "\n\nDownloading the same date range again will resume any partial downloads."
+            tk.Label(self.canvas, text=text).pack(fill=tk.BOTH, expand=True)
          else:
             print('Unrecognized BLE Data:', key, '=', data)
       if self.ble_comms.is_alive():
          self.master.after(100, self._refresh_data)
 
    def _clear_canvas(self):
+      self.multi_progress_area = None
       for item in self.canvas.winfo_children():
          item.destroy()
 
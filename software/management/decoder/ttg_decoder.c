@@ -0,0 +1,177 @@
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "ttg_decoder.h"
+
+
+// Private Helper Functions --------------------------------------------------------------------------------------------
+
+static uint32_t read_uint32(const uint8_t *data)
+{
+   return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static int16_t read_int16(const uint8_t *data)
+{
+   return (int16_t)((uint16_t)data[0] | ((uint16_t)data[1] << 8));
+}
+
+static bool grow(void **array, size_t element_size, size_t capacity)
+{
+   void *resized = realloc(*array, element_size * capacity);
+   if (resized)
+      *array = resized;
+   return resized != NULL;
+}
+
+static bool append_record(ttg_columns_t *columns, uint8_t type, double timestamp, int32_t value)
+{
+   // Double the record capacity whenever it runs out
+   if (columns->num_records == columns->records_capacity)
+   {
+      const size_t capacity = columns->records_capacity ? (2 * columns->records_capacity) : 4096;
+      if (!grow((void**)&columns->type, sizeof(*columns->type), capacity) || !grow((void**)&columns->timestamp, sizeof(*columns->timestamp), capacity) ||
+          !grow((void**)&columns->value, sizeof(*columns->value), capacity))
+         return false;
+      columns->records_capacity = capacity;
+   }
+   columns->type[columns->num_records] = type;
+   columns->timestamp[columns->num_records] = timestamp;
+   columns->value[columns->num_records++] = value;
+   return true;
+}
+
+static bool append_measurement(ttg_columns_t *columns, uint8_t uid, int16_t distance_mm, int16_t min_mm, int16_t max_mm, uint8_t count)
+{
+   // Double the measurement capacity whenever it runs out
+   if (columns->num_measurements == columns->measurements_capacity)
+   {
+      const size_t capacity = columns->measurements_capacity ? (2 * columns->measurements_capacity) : 16384;
+      if (!grow((void**)&columns->uid, sizeof(*columns->uid), capacity) || !grow((void**)&columns->count, sizeof(*columns->count), capacity) ||
+          !grow((void**)&columns->distance_mm, sizeof(*columns->distance_mm), capacity) || !grow((void**)&columns->min_mm, sizeof(*columns->min_mm), capacity) ||
+          !grow((void**)&columns->max_mm, sizeof(*columns->max_mm), capacity))
+         return false;
+      columns->measurements_capacity = capacity;
+   }
+   const size_t index = columns->num_measurements++;
+   columns->uid[index] = uid;
+   columns->distance_mm[index] = distance_mm;
+   columns->min_mm[index] = min_mm;
+   columns->max_mm[index] = max_mm;
+   columns->count[index] = count;
+   return true;
+}
+
+
+// Public API Functions ------------------------------------------------------------------------------------------------
+
+void ttg_columns_init(ttg_columns_t *columns)
+{
+   memset(columns, 0, sizeof(*columns));
+}
+
+void ttg_columns_free(ttg_columns_t *columns)
+{
+   free(columns->type);
+   free(columns->timestamp);
+   free(columns->value);
+   free(columns->uid);
+   free(columns->count);
+   free(columns->distance_mm);
+   free(columns->min_mm);
+   free(columns->max_mm);
+   ttg_columns_init(columns);
+}
+
+bool ttg_decode(const uint8_t *data, size_t data_length, const ttg_decoder_config_t *config, ttg_columns_t *columns)
+{
+   // Walk the storage stream one byte at a time until a plausible record header is found, exactly like the Python parser
+   size_t i = 0;
+   while ((i + TTG_RECORD_HEADER_LENGTH) <= data_length)
+   {
+      const uint8_t type = data[i];
+      const uint32_t timestamp_raw = read_uint32(data + i + 1);
+      const double timestamp = config->start_time + (timestamp_raw / 1000.0);
+      if ((timestamp > config->now) || (timestamp_raw % TTG_TIMESTAMP_RESOLUTION_MS) || (type < TTG_TYPE_VOLTAGE) || (type > TTG_TYPE_RANGE_SUMMARY))
+      {
+         ++i;
+         continue;
+      }
+
+      // Records that are cut off by the end of the stream end decoding, although range records still replace earlier ranges
+      const uint8_t *payload = data + i + TTG_RECORD_HEADER_LENGTH;
+      const size_t remaining = data_length - i - TTG_RECORD_HEADER_LENGTH;
+      if ((type == TTG_TYPE_VOLTAGE) ? (remaining < sizeof(uint32_t)) : (remaining < 1))
+         return ((type != TTG_TYPE_RANGES) && (type != TTG_TYPE_RANGE_SUMMARY)) || append_record(columns, type, timestamp, 0);
+      switch (type)
+      {
+         case TTG_TYPE_VOLTAGE:
+         {
+            const uint32_t voltage = read_uint32(payload);
+            if ((voltage > 0) && (voltage < TTG_MAX_VOLTAGE_MV))
+            {
+               if (!append_record(columns, type, timestamp, (int32_t)voltage))
+                  return false;
+               i += TTG_RECORD_HEADER_LENGTH + sizeof(uint32_t);
+            }
+            else
+               ++i;
+            break;
+         }
+         case TTG_TYPE_CHARGING_EVENT:
+         case TTG_TYPE_MOTION:
+         {
+            const bool is_valid = (type == TTG_TYPE_MOTION) ? (payload[0] <= 1) : ((payload[0] > 0) && (payload[0] < TTG_NUM_CHARGING_EVENTS));
+            if (is_valid)
+            {
+               if (!append_record(columns, type, timestamp, payload[0]))
+                  return false;
+               i += TTG_RECORD_HEADER_LENGTH + 1;
+            }
+            else
+               ++i;
+            break;
+         }
+         default:
+         {
+            // Range records always replace the ranges at their timestamp, even when their measurement count is implausible
+            const uint8_t num_ranges = payload[0];
+            const size_t measurement_length = (type == TTG_TYPE_RANGES) ? TTG_RANGE_LENGTH : TTG_RANGE_SUMMARY_LENGTH;
+            const size_t record_index = columns->num_records;
+            if (!append_record(columns, type, timestamp, 0))
+               return false;
+            if (num_ranges >= config->max_num_devices)
+            {
+               ++i;
+               break;
+            }
+
+            // Keep only measurements from known devices with plausible distances
+            for (uint8_t j = 0; j < num_ranges; ++j)
+            {
+               if (((j + 1) * measurement_length) >= remaining)
+                  return true;
+               const uint8_t *measurement = payload + 1 + (j * measurement_length);
+               const uint8_t uid = measurement[0];
+               const int16_t distance = read_int16(measurement + 1);
+               bool is_valid = config->valid_uids[uid];
+               if (type == TTG_TYPE_RANGES)
+                  is_valid = is_valid && ((uint16_t)distance < config->max_distance_mm);
+               else
+                  is_valid = is_valid && (distance >= 0) && ((uint32_t)distance < config->max_distance_mm);
+               if (is_valid)
+               {
+                  const bool is_summary = (type == TTG_TYPE_RANGE_SUMMARY);
+                  if (!append_measurement(columns, uid, distance, is_summary ? read_int16(measurement + 3) : 0, is_summary ? read_int16(measurement + 5) : 0, is_summary ? measurement[7] : 0))
+                     return false;
+                  ++columns->value[record_index];
+               }
+            }
+            i += TTG_RECORD_HEADER_LENGTH + 1 + (num_ranges * measurement_length);
+            break;
+         }
+      }
+   }
+   return true;
+}
@@ -0,0 +1,60 @@
+#ifndef __TTG_DECODER_HEADER_H__
+#define __TTG_DECODER_HEADER_H__
+
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Storage Record Definitions (must match storage_data_type_t and the storage task) ------------------------------------
+
+typedef enum {
+   TTG_TYPE_SHUTDOWN = 0,
+   TTG_TYPE_VOLTAGE,
+   TTG_TYPE_CHARGING_EVENT,
+   TTG_TYPE_MOTION,
+   TTG_TYPE_RANGES,
+   TTG_TYPE_RANGE_SUMMARY
+} ttg_record_type_t;
+
+#define TTG_RECORD_HEADER_LENGTH                    5           // Type + Timestamp
+#define TTG_TIMESTAMP_RESOLUTION_MS                 500
+#define TTG_RANGE_LENGTH                            3           // UID + Distance
+#define TTG_RANGE_SUMMARY_LENGTH                    8           // UID + Mean + Min + Max + Count
+#define TTG_MAX_VOLTAGE_MV                          4500
+#define TTG_NUM_CHARGING_EVENTS                     5
+
+
+// Decoder Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+   double start_time, now;
+   uint32_t max_num_devices, max_distance_mm;
+   bool valid_uids[256];
+} ttg_decoder_config_t;
+
+typedef struct
+{
+   // One entry per record in log order, where the value is the voltage, charging event, motion state, or number of measurements
+   uint8_t *type;
+   double *timestamp;
+   int32_t *value;
+   size_t num_records, records_capacity;
+
+   // One entry per valid measurement of a range or range summary record, in log order
+   uint8_t *uid, *count;
+   int16_t *distance_mm, *min_mm, *max_mm;
+   size_t num_measurements, measurements_capacity;
+} ttg_columns_t;
+
+
+// Public API Functions ------------------------------------------------------------------------------------------------
+
+void ttg_columns_init(ttg_columns_t *columns);
+void ttg_columns_free(ttg_columns_t *columns);
+bool ttg_decode(const uint8_t *data, size_t data_length, const ttg_decoder_config_t *config, ttg_columns_t *columns);
+
+#endif  // #ifndef __TTG_DECODER_HEADER_H__
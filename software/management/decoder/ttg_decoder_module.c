@@ -0,0 +1,80 @@
+// Header Inclusions ---------------------------------------------------------------------------------------------------
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "ttg_decoder.h"
+
+
+// Private Helper Functions --------------------------------------------------------------------------------------------
+
+static int add_column(PyObject *result, const char *name, const void *column, size_t length)
+{
+   // Copy each column into an immutable bytes object that numpy can wrap without another copy
+   PyObject *bytes = PyBytes_FromStringAndSize(length ? (const char*)column : "", (Py_ssize_t)length);
+   if (!bytes)
+      return -1;
+   const int status = PyDict_SetItemString(result, name, bytes);
+   Py_DECREF(bytes);
+   return status;
+}
+
+
+// Python Module Functions ---------------------------------------------------------------------------------------------
+
+static PyObject* decode_storage_records(PyObject *self, PyObject *args)
+{
+   // Parse the raw log, experiment start time, current time, known device UIDs, and validity limits
+   Py_buffer data, uids;
+   ttg_decoder_config_t config = { 0 };
+   if (!PyArg_ParseTuple(args, "y*ddy*II", &data, &config.start_time, &config.now, &uids, &config.max_num_devices, &config.max_distance_mm))
+      return NULL;
+   for (Py_ssize_t i = 0; i < uids.len; ++i)
+      config.valid_uids[((const uint8_t*)uids.buf)[i]] = true;
+   PyBuffer_Release(&uids);
+
+   // Decode without holding the GIL so that several logs can be processed in parallel
+   bool success;
+   ttg_columns_t columns;
+   ttg_columns_init(&columns);
+   Py_BEGIN_ALLOW_THREADS
+   success = ttg_decode((const uint8_t*)data.buf, (size_t)data.len, &config, &columns);
+   Py_END_ALLOW_THREADS
+   PyBuffer_Release(&data);
+   if (!success)
+   {
+      ttg_columns_free(&columns);
+      return PyErr_NoMemory();
+   }
+
+   // Return every column as little-endian bytes keyed by its name
+   PyObject *result = PyDict_New();
+   if (!result || add_column(result, "type", columns.type, columns.num_records * sizeof(*columns.type)) ||
+       add_column(result, "t", columns.timestamp, columns.num_records * sizeof(*columns.timestamp)) ||
+       add_column(result, "value", columns.value, columns.num_records * sizeof(*columns.value)) ||
+       add_column(result, "uid", columns.uid, columns.num_measurements * sizeof(*columns.uid)) ||
+       add_column(result, "distance", columns.distance_mm, columns.num_measurements * sizeof(*columns.distance_mm)) ||
+       add_column(result, "min", columns.min_mm, columns.num_measurements * sizeof(*columns.min_mm)) ||
+       add_column(result, "max", columns.max_mm, columns.num_measurements * sizeof(*columns.max_mm)) ||
+       add_column(result, "n", columns.count, columns.num_measurements * sizeof(*columns.count)))
+      Py_CLEAR(result);
+   ttg_columns_free(&columns);
+   return result;
+}
+
+
+// Python Module Definition --------------------------------------------------------------------------------------------
+
+static PyMethodDef decoder_methods[] = {
+   { "decode_storage_records", decode_storage_records, METH_VARARGS,
+     "decode_storage_records(data, start_time, now, uids, max_num_devices, max_distance_mm) -> dict of column bytes" },
+   { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef decoder_module = {
+   PyModuleDef_HEAD_INIT, "_ttg_decoder", "Native decoder for raw TotTag storage logs", -1, decoder_methods
+};
+
+PyMODINIT_FUNC PyInit__ttg_decoder(void)
+{
+   return PyModule_Create(&decoder_module);
+}
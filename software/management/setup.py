@@ -17,6 +17,7 @@ setuptools.setup(
    url='https://github.com/lab11/socitrack',
    package_dir={'tottag': 'dashboard'},
    packages=['tottag'],
+   ext_modules=[setuptools.Extension('tottag._ttg_decoder', sources=['decoder/ttg_decoder.c', 'decoder/ttg_decoder_module.c'], optional=True)],
    include_package_data=True,
    install_requires=install_deps,
    classifiers=[
@@ -25,6 +26,8 @@ setuptools.setup(
    ],
    python_requires='>=3.8',
    entry_points={
-      'console_scripts': ['tottag = tottag.tottag:main'],
+      'console_scripts': ['tottag = tottag.tottag:main', 'tottag-simulator = tottag.simulator:main', 'tottag-buffer-sizing = tottag.buffer_sizing:main',
+                          'tottag-cohort-stats = tottag.cohort_statistics:main', 'tottag-reconcile = tottag.range_reconciliation:main',
+                          'tottag-synthesize = tottag.deployment_synthesis:main'],
    }
 )